@@ -0,0 +1,75 @@
+// Time-domain trace decimation: DecimateLinearTrace (Min/Max and LTTB) reducing 1M to 16M points
+// of a noisy sine with a one-sample glitch to a 1600 px plot, and a TraceDecimator frame where
+// nothing changed. Reports whether the glitch is still in the decimated trace.
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "Decimation.hpp"
+
+namespace
+{
+	template <typename F>
+	double BestMilliseconds(int repeats, F f)
+	{
+		double best = 1e300;
+		for (int r = 0; r < repeats; ++r)
+		{
+			const auto t0 = std::chrono::steady_clock::now();
+			f();
+			best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+		}
+		return best;
+	}
+
+	bool HasGlitch(const PlotTrace& trace, double level)
+	{
+		for (double v : trace.y)
+			if (v >= level) return true;
+		return false;
+	}
+}
+
+int main()
+{
+	const int columns = 1600;
+	const double glitch = 5.0;
+	std::mt19937 rng(1);
+	std::normal_distribution<double> noise(0.0, 0.05);
+
+	std::printf("%10s %12s %12s %10s %14s %8s\n", "points", "MinMax (ms)", "LTTB (ms)", "kept", "cached (ns)", "glitch");
+	for (size_t n : { (size_t)1 << 20, (size_t)1 << 22, (size_t)1 << 24 })
+	{
+		std::vector<double> x(n), y(n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			x[i] = (double)i * 1e-6;
+			y[i] = std::sin(2.0 * M_PI * 50.0 * x[i]) + noise(rng);
+		}
+		y[n / 3 + 7] = glitch;
+		const double x_min = x.front(), x_max = x.back();
+
+		PlotTrace minmax, lttb;
+		const int repeats = n > ((size_t)1 << 22) ? 3 : 10;
+		const double minmax_ms = BestMilliseconds(repeats, [&]() {
+			DecimateLinearTrace(x.data(), y.data(), n, x_min, x_max, columns, DecimationMethod::MinMax, minmax);
+		});
+		const double lttb_ms = BestMilliseconds(repeats, [&]() {
+			DecimateLinearTrace(x.data(), y.data(), n, x_min, x_max, columns, DecimationMethod::LTTB, lttb);
+		});
+
+		// a frame with the same generation, limits and width returns the cached trace
+		TraceDecimator decimator;
+		decimator.Update(x, y, 1, x_min, x_max, columns, DecimationMethod::MinMax);
+		const int frames = 1000000;
+		size_t sink = 0;
+		const auto t0 = std::chrono::steady_clock::now();
+		for (int f = 0; f < frames; ++f)
+			sink += decimator.Update(x, y, 1, x_min, x_max, columns, DecimationMethod::MinMax).y.size();
+		const double cached_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / frames;
+
+		std::printf("%10zu %12.2f %12.2f %10zu %14.1f %8s\n", n, minmax_ms, lttb_ms, minmax.y.size(), cached_ns,
+			HasGlitch(minmax, glitch) && HasGlitch(lttb, glitch) && sink > 0 ? "kept" : "LOST");
+	}
+	return 0;
+}
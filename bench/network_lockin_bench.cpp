@@ -0,0 +1,140 @@
+// Network analyser lock-in: NetworkAnalyser::lockin_pair_ (one blocked pass over both channels,
+// prefilter applied on the fly) against the Savitzky-Golay prefilter and per-channel lock-in it
+// replaced, on noisy 10k to 1M sample captures of a 1 kHz tone at 375 kS/s, prefilter off and at
+// 7 and 21 taps. Reports the largest relative difference of the two channels' I/Q.
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <vector>
+#include "NetworkAnalyser.hpp"
+
+struct NetworkAnalyserBench
+{
+	using IQ = NetworkAnalyser::IQ;
+
+	static void Weights(int window, double* w) { NetworkAnalyser::gen_savgol_q2_weights_(window, w); }
+
+	static void LockinPair(const double* x, const double* y, int N, double omega, const double* w, int half, IQ& X, IQ& Y)
+	{
+		NetworkAnalyser::lockin_pair_(x, y, N, omega, w, half, X, Y);
+	}
+};
+
+namespace
+{
+	using IQ = NetworkAnalyserBench::IQ;
+
+	// The replaced NetworkAnalyser::savgol_q2_filter_inplace_, writing into y instead of swapping.
+	void ReferenceSmooth(const std::vector<double>& x, int window, std::vector<double>& y)
+	{
+		const int N = (int)x.size();
+		std::vector<double> w(window);
+		NetworkAnalyserBench::Weights(window, w.data());
+		y.assign(N, 0.0);
+		const int half = window / 2;
+		for (int i = half; i < N - half; ++i)
+		{
+			double s = 0.0;
+			for (int k = -half; k <= half; ++k) s += w[k + half] * x[i + k];
+			y[i] = s;
+		}
+		for (int i = 0; i < half; ++i) y[i] = x[i];
+		for (int i = N - half; i < N; ++i) y[i] = x[i];
+	}
+
+	// The replaced NetworkAnalyser::lockin_accumulate_demean_ (phi0 = 0).
+	void ReferenceLockin(const std::vector<double>& sig, double omega, IQ& out)
+	{
+		double mean = 0.0;
+		for (double v : sig) mean += v;
+		mean /= sig.size();
+
+		double c = 1.0, s = 0.0;
+		const double dc = std::cos(omega), ds = std::sin(omega);
+		double Scc = 0.0, Sss = 0.0;
+		for (double v : sig)
+		{
+			const double x = v - mean;
+			out.I += x * c;
+			out.Q += x * s;
+			Scc += c * c;
+			Sss += s * s;
+			const double c_next = c * dc - s * ds;
+			const double s_next = c * ds + s * dc;
+			c = c_next; s = s_next;
+		}
+		out.I /= (Scc + 1e-30);
+		out.Q /= (Sss + 1e-30);
+	}
+
+	template <typename F>
+	double BestMilliseconds(int repeats, F f)
+	{
+		double best = 1e300;
+		for (int r = 0; r < repeats; ++r)
+		{
+			const auto t0 = std::chrono::steady_clock::now();
+			f();
+			best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+		}
+		return best;
+	}
+
+	double RelativeDifference(const IQ& a, const IQ& b)
+	{
+		return std::hypot(a.I - b.I, a.Q - b.Q) / std::hypot(b.I, b.Q);
+	}
+}
+
+int main()
+{
+	const double fs = 375000.0, f = 1000.0, omega = 2.0 * M_PI * f / fs;
+	std::mt19937 rng(1);
+	std::normal_distribution<double> noise(0.0, 0.02);
+
+	std::printf("%8s %7s %10s %10s %8s %12s\n", "samples", "window", "old (ms)", "new (ms)", "speedup", "max rel diff");
+	for (int N : { 10000, 100000, 1000000 })
+	{
+		std::vector<double> x(N), y(N);
+		for (int n = 0; n < N; ++n)
+		{
+			x[n] = 1.0 + std::sin(omega * n + 0.3) + noise(rng);
+			y[n] = 0.5 + 0.3 * std::sin(omega * n - 0.9) + noise(rng);
+		}
+		const int repeats = N > 200000 ? 5 : 20;
+
+		for (int window : { 0, 7, 21 })
+		{
+			const int half = window / 2;
+			std::vector<double> w(std::max(window, 1)), xs, ys;
+			if (window > 0) NetworkAnalyserBench::Weights(window, w.data());
+
+			IQ old_x, old_y;
+			const double old_ms = BestMilliseconds(repeats, [&]() {
+				old_x = IQ{}; old_y = IQ{};
+				if (window > 0)
+				{
+					ReferenceSmooth(x, window, xs);
+					ReferenceSmooth(y, window, ys);
+					ReferenceLockin(xs, omega, old_x);
+					ReferenceLockin(ys, omega, old_y);
+				}
+				else
+				{
+					ReferenceLockin(x, omega, old_x);
+					ReferenceLockin(y, omega, old_y);
+				}
+			});
+
+			IQ new_x, new_y;
+			const double new_ms = BestMilliseconds(repeats, [&]() {
+				new_x = IQ{}; new_y = IQ{};
+				NetworkAnalyserBench::LockinPair(x.data(), y.data(), N, omega, w.data() + half, half, new_x, new_y);
+			});
+
+			const double diff = std::max(RelativeDifference(new_x, old_x), RelativeDifference(new_y, old_y));
+			std::printf("%8d %7d %10.2f %10.2f %7.1fx %12.1e\n", N, window, old_ms, new_ms, old_ms / new_ms, diff);
+		}
+	}
+	return 0;
+}
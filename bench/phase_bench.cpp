@@ -0,0 +1,117 @@
+// Phase measurement: PhaseEstimator (recurrence phasors, both channels in one pass) against the
+// direct projection it replaced (four trig calls per sample, one channel at a time), on a noisy
+// 1234.5 Hz sine at 375 kS/s with the second channel 30 degrees behind.
+#include <cstdio>
+#include <chrono>
+#include <random>
+#include <vector>
+#include <utility>
+#include "Measurements.hpp"
+
+namespace
+{
+	struct Phase
+	{
+		double deg;
+		double freq;
+	};
+
+	// The replaced MeasurementEngine::MeasurePhase projection, per channel.
+	Phase ReferencePhase(const std::vector<double>& time, const std::vector<double>& data, double mean, double f0)
+	{
+		const size_t N = time.size();
+		const double t0 = 0.5 * (time.front() + time[N - 1]);
+		auto hann_w = [N](size_t n)->double {
+			return 0.5 * (1.0 - std::cos(2.0 * M_PI * (double)n / (double)(N - 1)));
+		};
+		const double span = std::max(1e-12, time[N - 1] - time.front());
+		const double df = 1.0 / span;
+		auto proj = [&](double f)->std::pair<double, double> {
+			long double Re = 0.0L, Im = 0.0L;
+			for (size_t n = 0; n < N; ++n) {
+				const double x = data[n] - mean;
+				const double w = hann_w(n);
+				const double ang = 2.0 * M_PI * f * (time[n] - t0);
+				Re += (long double)(w * x) * (long double)std::cos(ang);
+				Im -= (long double)(w * x) * (long double)std::sin(ang);
+			}
+			return { (double)Re, (double)Im };
+		};
+		auto mag2 = [](double Re, double Im) { return Re * Re + Im * Im; };
+
+		const auto [Rem, Imm] = proj(f0 - df);
+		const auto [Re0, Im0] = proj(f0);
+		const auto [Rep, Imp] = proj(f0 + df);
+		const double Am = mag2(Rem, Imm), A0 = mag2(Re0, Im0), Ap = mag2(Rep, Imp);
+		double delta = 0.0;
+		const double denom = (Am - 2.0 * A0 + Ap);
+		if (std::fabs(denom) > 0.0)
+			delta = std::clamp(0.5 * (Am - Ap) / denom, -1.0, 1.0);
+		const double f1 = std::max(0.0, f0 + delta * df);
+		const auto [Re, Im] = proj(f1);
+		return { std::atan2(Im, Re) * (180.0 / M_PI), f1 };
+	}
+
+	double Wrap(double deg)
+	{
+		deg = std::fmod(deg + 180.0, 360.0);
+		return (deg < 0.0 ? deg + 360.0 : deg) - 180.0;
+	}
+
+	template <typename F>
+	double BestMicroseconds(int repeats, F f)
+	{
+		double best = 1e300;
+		for (int r = 0; r < repeats; ++r)
+		{
+			const auto t0 = std::chrono::steady_clock::now();
+			f();
+			best = std::min(best, std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - t0).count());
+		}
+		return best;
+	}
+}
+
+int main()
+{
+	const double fs = 375000.0, f = 1234.5, lag_deg = 30.0;
+	std::mt19937 rng(1);
+	std::normal_distribution<double> noise(0.0, 0.02);
+
+	std::printf("%8s %12s %12s %8s %14s %14s\n", "N", "old (us)", "new (us)", "speedup", "|d phase| deg", "|d rel| deg");
+	for (size_t N : { (size_t)2048, (size_t)16384, (size_t)65536 })
+	{
+		std::vector<double> time(N), a(N), b(N);
+		for (size_t n = 0; n < N; ++n)
+		{
+			time[n] = (double)n / fs;
+			a[n] = 1.0 + std::sin(2.0 * M_PI * f * time[n]) + noise(rng);
+			b[n] = 1.0 + 0.5 * std::sin(2.0 * M_PI * f * time[n] - lag_deg * M_PI / 180.0) + noise(rng);
+		}
+		double mean_a = 0.0, mean_b = 0.0;
+		for (size_t n = 0; n < N; ++n) { mean_a += a[n]; mean_b += b[n]; }
+		mean_a /= (double)N;
+		mean_b /= (double)N;
+		const double f0 = f * 1.002; // a zero-crossing period estimate is a little off
+
+		const int repeats = N > 20000 ? 5 : 20;
+		Phase old_a{}, old_b{};
+		const double old_us = BestMicroseconds(repeats, [&]() {
+			old_a = ReferencePhase(time, a, mean_a, f0);
+			old_b = ReferencePhase(time, b, mean_b, f0);
+		});
+
+		PhaseEstimator estimator;
+		const std::vector<double>* channels[2] = { &a, &b };
+		const double means[2] = { mean_a, mean_b };
+		double phase[2] = {}, f1 = 0.0;
+		const double new_us = BestMicroseconds(repeats, [&]() {
+			estimator.Estimate(time, channels, means, 2, f0, phase, f1);
+		});
+
+		const double d_abs = std::fabs(Wrap(phase[0] - old_a.deg));
+		const double d_rel = std::fabs(Wrap((phase[1] - phase[0]) - (old_b.deg - old_a.deg)));
+		std::printf("%8zu %12.1f %12.1f %7.1fx %14.2e %14.2e\n", N, old_us, new_us, old_us / new_us, d_abs, d_rel);
+	}
+	return 0;
+}
@@ -0,0 +1,120 @@
+// Zoom FFT against the full-band spectrum: 1, 5 and 10 s records at 375 kS/s (or the lengths in
+// seconds given as arguments) holding two tones 4/T apart either side of 1 kHz, 1 V and 0.5 V peak.
+// Each cell is the time to a per-bin Vrms spectrum, its bin count, and the worse of the two
+// tones' amplitude errors; "-" where the band is too narrow for the record.
+#include <cstdio>
+#include <cstdlib>
+#include <chrono>
+#include <vector>
+#include "ZoomFFT.hpp"
+
+namespace
+{
+	const double Rate = 375000.0;
+	const double Centre = 1000.0;
+
+	template <typename F>
+	double BestMilliseconds(int repeats, F f)
+	{
+		double best = 1e300;
+		for (int r = 0; r < repeats; ++r)
+		{
+			const auto t0 = std::chrono::steady_clock::now();
+			f();
+			best = std::min(best, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count());
+		}
+		return best;
+	}
+
+	// The spectrum analyser's single-FFT path (OscData::ComputeSpectrum): Hann window, mean removed,
+	// per-bin Vrms.
+	void FullBand(SpectrumWorkspace& fft, const std::vector<double>& x, std::vector<double>& freq, std::vector<double>& vrms)
+	{
+		const size_t L = x.size();
+		fft.Prepare(L, SpectrumWorkspace::Hann);
+		const std::vector<double>& w = fft.GetWindow();
+		double mean = 0.0;
+		for (double v : x) mean += v;
+		mean /= (double)L;
+		double* in = fft.In();
+		for (size_t n = 0; n < L; ++n) in[n] = (x[n] - mean) * w[n];
+		const size_t Nb = L / 2 + 1;
+		freq.resize(Nb);
+		vrms.resize(Nb);
+		if (!fft.Execute(true)) return;
+		const fftw_complex* out = fft.Out();
+		const double scale = 1.0 / (fft.WindowSum() * std::sqrt(2.0));
+		for (size_t k = 0; k < Nb; ++k)
+		{
+			const bool edge = k == 0 || (L % 2 == 0 && k == Nb - 1);
+			freq[k] = k * Rate / (double)L;
+			vrms[k] = std::hypot(out[k][0], out[k][1]) * scale * (edge ? 1.0 : 2.0);
+		}
+	}
+
+	// Largest relative error of the two tones' Vrms, each read as the largest bin within a bin of it.
+	double ToneError(const std::vector<double>& freq, const std::vector<double>& vrms, const double* f, const double* a)
+	{
+		if (freq.size() < 2) return NAN;
+		const double df = freq[1] - freq[0];
+		double worst = 0.0;
+		for (int t = 0; t < 2; ++t)
+		{
+			double peak = 0.0;
+			for (size_t k = 0; k < freq.size(); ++k)
+				if (std::fabs(freq[k] - f[t]) <= df) peak = std::max(peak, vrms[k]);
+			worst = std::max(worst, std::fabs(peak / (a[t] / std::sqrt(2.0)) - 1.0));
+		}
+		return worst;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	std::vector<double> seconds;
+	for (int i = 1; i < argc; ++i) seconds.push_back(std::atof(argv[i]));
+	if (seconds.empty()) seconds = { 1.0, 5.0, 10.0 };
+	const double spans[3] = { 20.0, 200.0, 2000.0 };
+
+	std::printf("%7s %33s", "record", "full band");
+	for (double span : spans) std::printf(" %25s%5.0f Hz", "zoom", span);
+	std::printf("\n");
+
+	SpectrumWorkspace fft;
+	ZoomSpectrum zoom;
+	std::vector<double> freq, vrms;
+	for (double T : seconds)
+	{
+		const size_t n = (size_t)std::llround(T * Rate);
+		const double f[2] = { Centre - 2.0 / T, Centre + 2.0 / T }, a[2] = { 1.0, 0.5 };
+		std::vector<double> x(n);
+		for (size_t i = 0; i < n; ++i)
+		{
+			const double t = (double)i / Rate;
+			x[i] = 1.5 + a[0] * std::sin(2.0 * M_PI * f[0] * t) + a[1] * std::sin(2.0 * M_PI * f[1] * t);
+		}
+		const int repeats = T > 2.0 ? 2 : 5;
+
+		FullBand(fft, x, freq, vrms); // plans the length
+		const double full_ms = BestMilliseconds(repeats, [&]() { FullBand(fft, x, freq, vrms); });
+		std::printf("%6.2fs %9.1f ms %8zu bins %5.2f%%", T, full_ms, vrms.size(), 100.0 * ToneError(freq, vrms, f, a));
+
+		for (double span : spans)
+		{
+			ZoomSpectrum::Config cfg;
+			cfg.centre_hz = Centre;
+			cfg.span_hz = span;
+			zoom.Compute(x.data(), n, Rate, cfg, freq, vrms);
+			if (vrms.empty())
+			{
+				std::printf(" %33s", "-");
+				continue;
+			}
+			const double zoom_ms = BestMilliseconds(repeats, [&]() { zoom.Compute(x.data(), n, Rate, cfg, freq, vrms); });
+			std::printf(" %9.1f ms %8zu bins %5.2f%%", zoom_ms, vrms.size(), 100.0 * ToneError(freq, vrms, f, a));
+		}
+		std::printf("\n");
+	}
+	FFTPlanCache::Instance().Shutdown();
+	return 0;
+}
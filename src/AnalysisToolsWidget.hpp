@@ -4,6 +4,7 @@
 #include <array>
 #include "UIComponents.hpp"
 #include "AcquireState.hpp"
+#include "SpectralMetrics.hpp"
 
 
 using Clock = std::chrono::steady_clock;
@@ -40,8 +41,63 @@ public:
 		double OSC2_last_captured = -1;
 		bool DisplayOSC1 = true;
 		bool DisplayOSC2 = true;
+		bool OptimiseFFTPlans = false;
+		const char* MethodComboList[3] = { "Single FFT", "Welch (Averaged)", "Zoom FFT" };
+		int MethodComboCurrentItem = 0;
+		const char* SegmentLengthComboList[7] = { "512", "1024", "2048", "4096", "8192", "16384", "32768" };
+		int SegmentLengthComboCurrentItem = 3;
+		const char* OverlapComboList[4] = { "0 %", "25 %", "50 %", "75 %" };
+		int OverlapComboCurrentItem = 2;
+		const char* AveragingComboList[3] = { "Linear", "RMS", "Max Hold" };
+		int AveragingComboCurrentItem = 1;
+		size_t WelchSegments = 0; // segments in the displayed Welch average
+		double ZoomCentre = 1000.0; // Hz
+		const char* ZoomSpanComboList[5] = { "10 Hz", "100 Hz", "1 kHz", "10 kHz", "100 kHz" };
+		int ZoomSpanComboCurrentItem = 2;
+		bool SpectrumBusy = false;     // an acquisition still computing or waiting for a worker
+		double OSC1ElapsedMs = 0.0;    // capture to result, per channel, for the last acquisition
+		double OSC2ElapsedMs = 0.0;
+		bool SpectrogramOn = false;
+		const char* FFTLengthComboList[5] = { "256", "512", "1024", "2048", "4096" };
+		int FFTLengthComboCurrentItem = 2;
+		const char* HopComboList[7] = { "64", "128", "256", "512", "1024", "2048", "4096" };
+		int HopComboCurrentItem = 2;
+		float SpectrogramMinDb = -120.0f;
+		float SpectrogramMaxDb = 10.0f;
+		bool MetricsOn = false;
+		SpectralMetrics OSC1Metrics;
+		SpectralMetrics OSC2Metrics;
 	} SA;
 
+	Spectrogram::Config GetSpectrogramConfig() const
+	{
+		Spectrogram::Config cfg;
+		cfg.fft_length = 256 << SA.FFTLengthComboCurrentItem;
+		cfg.hop = 64 << SA.HopComboCurrentItem;
+		cfg.window = SA.WindowComboCurrentItem;
+		return cfg;
+	}
+
+	bool IsWelch() const { return SA.MethodComboCurrentItem == 1; }
+	bool IsZoom() const { return SA.MethodComboCurrentItem == 2; }
+	ZoomSpectrum::Config GetZoomConfig() const
+	{
+		ZoomSpectrum::Config cfg;
+		cfg.centre_hz = SA.ZoomCentre;
+		cfg.span_hz = 10.0 * std::pow(10.0, SA.ZoomSpanComboCurrentItem);
+		cfg.window = SA.WindowComboCurrentItem;
+		return cfg;
+	}
+	WelchSpectrum::Config GetWelchConfig() const
+	{
+		WelchSpectrum::Config cfg;
+		cfg.segment_length = 512 << SA.SegmentLengthComboCurrentItem;
+		cfg.overlap = 0.25 * SA.OverlapComboCurrentItem;
+		cfg.window = SA.WindowComboCurrentItem;
+		cfg.averaging = (WelchSpectrum::Averaging)SA.AveragingComboCurrentItem;
+		return cfg;
+	}
+
 	
 
 	struct {
@@ -62,6 +118,8 @@ public:
 		bool AcquisitionExists = false;
 		int  PointSpacingComboCurrentItem = 0;
 		const char* PointSpacingComboList[2] = { "Logarithmic", "Linear" };
+		int  MethodComboCurrentItem = 0;
+		const char* MethodComboList[2] = { "Stepped Sine", "Multisine" };
 	} NA;
 
 	bool ToolsOn = false;
@@ -74,10 +132,13 @@ public:
 	ExportRowState SpecOSC1ExportState;
 	ExportRowState SpecOSC2ExportState;
 	ExportRowState NAMagExportState;
+	ExportRowState MetricsExportState;
 	ExportRowState NAPhaseExportState;
 	float ExportPathComboWidth = 100.f;
 	float SAExportButtonWidth = 180.0f;
 	float NAExportButtonWidth = 180.0f;
+	float NACalButtonWidth = 86.0f;
+	const char* NACalFileExtension = "lcal";
 	const char* ExportFileExtension = "csv"; // or use your existing FileExtension
 
 	AnalysisToolsWidget(std::string label, ImVec2 size, const float* borderColor)
@@ -129,6 +190,9 @@ public:
 					if (SA.AcquisitionExists) {
 						ImGui::TextDisabled("OSC1 Last captured: %.2f s", SA.OSC1_last_captured);
 						ImGui::TextDisabled("OSC2 Last captured: %.2f s", SA.OSC2_last_captured);
+						if (IsWelch()) ImGui::TextDisabled("Averages: %zu", SA.WelchSegments);
+						if (SA.SpectrumBusy) ImGui::TextDisabled("Computing...");
+						else ImGui::TextDisabled("Computed in %.1f / %.1f ms", SA.OSC1ElapsedMs, SA.OSC2ElapsedMs);
 					}
 					ImGui::EndTable();
 				}
@@ -152,10 +216,25 @@ public:
 					ImGui::TableNextColumn(); ImGui::Text("Channel 2 (OSC2)");
 					ImGui::TableNextColumn(); ToggleSwitch((label + "Display2_toggle").c_str(), &SA.DisplayOSC2, ImU32(OSC2Colour));
 
+					ImGui::TableNextColumn(); ImGui::Text("Spectrogram");
+					ImGui::TableNextColumn(); ToggleSwitch((label + "Spectrogram_toggle").c_str(), &SA.SpectrogramOn, ImU32(colourConvert(GenColour)));
+
+					if (SA.SpectrogramOn) {
+						ImGui::TableNextColumn(); ImGui::Text("Source");
+						ImGui::TableNextColumn(); ImGui::SetNextItemWidth(controlWidth);
+						ImGui::Combo("##SpectrogramSource", &SA.SignalComboCurrentItem, SA.SignalComboList, IM_ARRAYSIZE(SA.SignalComboList));
+					}
+
+					ImGui::TableNextColumn(); ImGui::Text("Distortion Metrics");
+					ImGui::TableNextColumn(); ToggleSwitch((label + "Metrics_toggle").c_str(), &SA.MetricsOn, ImU32(colourConvert(GenColour)));
+
 					
 
 					ImGui::EndTable();
 				}
+				if (SA.MetricsOn && SA.AcquisitionExists) {
+					drawMetricsTable();
+				}
 				ImGui::SeparatorText("General");
 				// Export
 				std::string magLabel =
@@ -185,6 +264,17 @@ public:
 					ExportFileExtension,
 					ExportPathComboWidth,
 					SAExportButtonWidth);
+
+				if (SA.MetricsOn) {
+					std::vector<std::vector<std::string>> rows = metricsTableRows();
+					DrawExportRow("Metrics",
+						MetricsExportState,
+						[&]() { return ExportTableToClipboard(rows); },
+						[&](const char* path) { return ExportTableToCsvFile(path, ExportFileExtension, rows); },
+						ExportFileExtension,
+						ExportPathComboWidth,
+						SAExportButtonWidth);
+				}
 				// Advanced Options
 				ImGui::SetNextItemOpen(false, ImGuiCond_Once);
 				if (ImGui::CollapsingHeader("Advanced Options##SpectrumOptions", ImGuiTreeNodeFlags_SpanAvailWidth)) {
@@ -218,10 +308,52 @@ public:
 							});
 						}
 
+						row("Method", [&] {
+							ImGui::Combo("##SpectrumMethod", &SA.MethodComboCurrentItem, SA.MethodComboList, IM_ARRAYSIZE(SA.MethodComboList));
+						});
+
+						if (IsWelch()) {
+							row("Segment Length", [&] {
+								ImGui::Combo("##WelchSegment", &SA.SegmentLengthComboCurrentItem,
+									SA.SegmentLengthComboList, IM_ARRAYSIZE(SA.SegmentLengthComboList));
+							});
+							row("Overlap", [&] {
+								ImGui::Combo("##WelchOverlap", &SA.OverlapComboCurrentItem, SA.OverlapComboList, IM_ARRAYSIZE(SA.OverlapComboList));
+							});
+							row("Averaging", [&] {
+								ImGui::Combo("##WelchAveraging", &SA.AveragingComboCurrentItem,
+									SA.AveragingComboList, IM_ARRAYSIZE(SA.AveragingComboList));
+							});
+						}
+
+						if (IsZoom()) {
+							row("Zoom Centre", [&] {
+								ImGui::InputDouble("##ZoomCentre", &SA.ZoomCentre, 10.0, 1000.0, "%.1f Hz");
+								SA.ZoomCentre = std::clamp(SA.ZoomCentre, 0.0,
+									0.5 * SA.SampleRatesValues[SA.SampleRatesComboCurrentItem]);
+							});
+							row("Zoom Span", [&] {
+								ImGui::Combo("##ZoomSpan", &SA.ZoomSpanComboCurrentItem, SA.ZoomSpanComboList, IM_ARRAYSIZE(SA.ZoomSpanComboList));
+							});
+						}
+
 						row("Windowing Function", [&] {
 							ImGui::Combo("##Windowing", &SA.WindowComboCurrentItem, SA.WindowComboList, IM_ARRAYSIZE(SA.WindowComboList));
 						});
 
+						if (SA.SpectrogramOn) {
+							row("Spectrogram FFT", [&] {
+								ImGui::Combo("##SpectrogramFFT", &SA.FFTLengthComboCurrentItem, SA.FFTLengthComboList, IM_ARRAYSIZE(SA.FFTLengthComboList));
+							});
+							row("Spectrogram Hop", [&] {
+								ImGui::Combo("##SpectrogramHop", &SA.HopComboCurrentItem, SA.HopComboList, IM_ARRAYSIZE(SA.HopComboList));
+							});
+							row("Spectrogram Range", [&] {
+								ImGui::DragFloatRange2("##SpectrogramRange", &SA.SpectrogramMinDb, &SA.SpectrogramMaxDb,
+									1.0f, -200.0f, 40.0f, "%.0f dBV", "%.0f dBV", ImGuiSliderFlags_AlwaysClamp);
+							});
+						}
+
 						row("Vertical Units", [&] {
 							ImGui::Combo("##Vertical Units", &SA.UnitsComboCurrentItem, SA.UnitsComboList, IM_ARRAYSIZE(SA.UnitsComboList));
 						});
@@ -231,6 +363,14 @@ public:
 								SA.AcquisitionModeComboList, IM_ARRAYSIZE(SA.AcquisitionModeComboList));
 						});
 
+						row("Optimise FFT Plans", [&] {
+							ImGui::Checkbox("##OptimiseFFTPlans", &SA.OptimiseFFTPlans);
+							if (FFTPlanCache::Instance().IsMeasuring()) {
+								ImGui::SameLine();
+								ImGui::TextDisabled("(measuring)");
+							}
+						});
+
 						ImGui::EndTable();
 					}
 				}
@@ -261,6 +401,8 @@ public:
 
 				ImGui::SeparatorText("Options");
 				
+				// a running sweep keeps the settings it started with
+				ImGui::BeginDisabled(na_ && na_->running());
 				ImGui::Text("Stimulus Generator"); ImGui::SameLine();
 				ImGui::SetNextItemWidth(NA.ComboBoxWidth);
 				ImGui::Combo("##NetworkAnalyserGenCombo", &NA.StimulusComboCurrentItem,
@@ -290,7 +432,11 @@ public:
 				RangeSliderDoubleLog("Frequency Range", &NA.f_start, &NA.f_stop,
 					1, 5000, 0.1, true, true, 0.0f, 5.0f, 8.0f);
 				if (cfg_) { cfg_->f_start = NA.f_start; cfg_->f_stop = NA.f_stop; cfg_->use_ifbw_limits = false; }
+				ImGui::EndDisabled();
 
+				if (SA.MetricsOn && SA.AcquisitionExists) {
+					drawMetricsTable();
+				}
 				ImGui::SeparatorText("General");
 				// Export
 				std::string magLabel =
@@ -298,8 +444,8 @@ public:
 					NA.UnitsComboList[NA.UnitsComboCurrentItem] +
 					")";
 				// Get magnitude data
-				std::vector<double> f = network_plots->freq;
-				std::vector<double> m = network_plots->mag;
+				const std::vector<double>& f = network_plots->freq;
+				const std::vector<double>& m = network_plots->mag;
 
 				DrawExportRow2Col("Magnitude##FR",
 					NAMagExportState,
@@ -310,7 +456,7 @@ public:
 					NAExportButtonWidth);
 
 				// Get phase data
-				std::vector<double> p = network_plots->phase;
+				const std::vector<double>& p = network_plots->phase;
 
 				DrawExportRow2Col("Phase##FR",
 					NAPhaseExportState,
@@ -320,6 +466,8 @@ public:
 					ExportPathComboWidth,
 					NAExportButtonWidth);
 
+				if (na_ && cfg_) drawNetworkCalibration();
+
 				ImGui::SetNextItemOpen(false, ImGuiCond_Once);
 				if (ImGui::CollapsingHeader("Advanced Options##NetworkOptions", ImGuiTreeNodeFlags_SpanAvailWidth)) {
 					if (ImGui::BeginTable("NetworkAdvTbl", 2, ImGuiTableFlags_SizingStretchProp)) {
@@ -349,6 +497,31 @@ public:
 						});
 						if (cfg_) cfg_->log_spacing = (NA.PointSpacingComboCurrentItem == 0);
 
+						row("Method", [&] {
+							ImGui::Combo("##NetworkMethod", &NA.MethodComboCurrentItem, NA.MethodComboList, IM_ARRAYSIZE(NA.MethodComboList));
+						});
+						if (cfg_) cfg_->broadband = (NA.MethodComboCurrentItem == 1);
+
+						row("Adaptive Refinement", [&] {
+							if (cfg_) ImGui::Checkbox("##AdaptiveRefinement", &cfg_->adaptive);
+						});
+						if (cfg_ && cfg_->adaptive) {
+							cfg_->adaptive_max_points = std::max(cfg_->adaptive_max_points, cfg_->points);
+							row("Max Data Points", [&] {
+								ImGui::SliderInt("##AdaptiveMaxPoints", &cfg_->adaptive_max_points, cfg_->points, 1001, "%d",
+									ImGuiSliderFlags_AlwaysClamp | ImGuiSliderFlags_NoRoundToFormat);
+							});
+						}
+
+						row("Max Captures per Point", [&] {
+							if (cfg_) ImGui::SliderInt("##MaxCaptures", &cfg_->avg_captures_max, std::max(1, cfg_->avg_captures_min), 64, "%d",
+								ImGuiSliderFlags_AlwaysClamp | ImGuiSliderFlags_NoRoundToFormat);
+						});
+						row("Re-measure Budget", [&] {
+							if (cfg_) ImGui::SliderInt("##RemeasureBudget", &cfg_->remeasure_budget, 0, 100, "%d",
+								ImGuiSliderFlags_AlwaysClamp | ImGuiSliderFlags_NoRoundToFormat);
+						});
+
 						ImGui::EndTable();
 					}
 				}
@@ -382,4 +555,93 @@ private:
 			SA.SampleRatesValues[i] = constants::DIVISORS_375000[55 - i];
 		}
 	}
+	/// <summary>
+	/// Through calibration: store the last sweep as the through, clear, save/load a .lcal file,
+	/// and whether sweeps apply it. Sweeps pick up changes when they start.
+	/// </summary>
+	void drawNetworkCalibration()
+	{
+		ImGui::SeparatorText("Calibration");
+		const NetworkAnalyser::Calibration& cal = na_->CurrentCalibration();
+
+		ImGui::BeginDisabled(na_->running());
+		if (WhiteOutlineButton("Store Through##NACal", ImVec2(2 * NACalButtonWidth + ImGui::GetStyle().ItemSpacing.x, 30)))
+			na_->StoreCalibration();
+		ImGui::EndDisabled();
+		ImGui::SameLine();
+		ImGui::BeginDisabled(cal.empty());
+		if (WhiteOutlineButton("Clear##NACal", ImVec2(NACalButtonWidth, 30)))
+			na_->ClearCalibration();
+		ImGui::EndDisabled();
+
+		ImGui::BeginDisabled(cal.empty());
+		if (WhiteOutlineButton("Save##NACal", ImVec2(NACalButtonWidth, 30))) {
+			nfdchar_t* path = nullptr;
+			if (NFD_SaveDialog(NACalFileExtension, nullptr, &path) == NFD_OKAY && path) {
+				std::string file(path);
+				const std::string ext = std::string(".") + NACalFileExtension;
+				if (file.size() < ext.size() || file.compare(file.size() - ext.size(), ext.size(), ext) != 0)
+					file += ext;
+				na_->SaveCalibration(file);
+				free(path);
+			}
+		}
+		ImGui::EndDisabled();
+		ImGui::SameLine();
+		if (WhiteOutlineButton("Load##NACal", ImVec2(NACalButtonWidth, 30))) {
+			nfdchar_t* path = nullptr;
+			if (NFD_OpenDialog(NACalFileExtension, nullptr, &path) == NFD_OKAY && path) {
+				na_->LoadCalibration(path);
+				free(path);
+			}
+		}
+		ImGui::SameLine();
+		ToggleSwitch("##NACalApply", &cfg_->apply_calibration, ImU32(colourConvert(GenColour)));
+		ImGui::SameLine();
+		ImGui::Text("Apply");
+
+		if (cal.empty()) ImGui::TextDisabled("No calibration");
+		else ImGui::TextDisabled("Through: %zu points, %.4g Hz to %.4g Hz", cal.f.size(), cal.f.front(), cal.f.back());
+	}
+
+	void drawMetricsTable()
+	{
+		static const char* formats[SpectralMetrics::Count] = {
+			"%.3f", "%.4f", "%.2f", "%.3f", "%.2f", "%.2f", "%.2f", "%.2f", "%.2f", "%.6f" };
+		ImGui::SeparatorText("Distortion Metrics");
+		if (ImGui::BeginTable("SpectrumMetricsTable", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_SizingStretchProp))
+		{
+			ImGui::TableSetupColumn("Metric", ImGuiTableColumnFlags_WidthFixed, 170.0f);
+			ImGui::TableSetupColumn("OSC1");
+			ImGui::TableSetupColumn("OSC2");
+			ImGui::TableHeadersRow();
+			for (int i = 0; i < SpectralMetrics::Count; ++i)
+			{
+				ImGui::TableNextRow();
+				ImGui::TableSetColumnIndex(0); ImGui::TextUnformatted(SpectralMetrics::Name(i));
+				const SpectralMetrics* m[2] = { &SA.OSC1Metrics, &SA.OSC2Metrics };
+				for (int c = 0; c < 2; ++c)
+				{
+					ImGui::TableSetColumnIndex(1 + c);
+					const double v = m[c]->Value(i);
+					if (std::isfinite(v)) ImGui::Text(formats[i], v);
+					else ImGui::TextDisabled("-");
+				}
+			}
+			ImGui::EndTable();
+		}
+	}
+	std::vector<std::vector<std::string>> metricsTableRows() const
+	{
+		auto cell = [](double v) -> std::string {
+			if (!std::isfinite(v)) return "";
+			char buf[32]; std::snprintf(buf, sizeof(buf), "%.10g", v); return std::string(buf);
+		};
+		std::vector<std::vector<std::string>> rows;
+		rows.push_back({ "Metric", "OSC1", "OSC2" });
+		for (int i = 0; i < SpectralMetrics::Count; ++i)
+			rows.push_back({ SpectralMetrics::Name(i), cell(SA.OSC1Metrics.Value(i)), cell(SA.OSC2Metrics.Value(i)) });
+		rows.push_back({ "Harmonics", std::to_string(SA.OSC1Metrics.harmonics), std::to_string(SA.OSC2Metrics.harmonics) });
+		return rows;
+	}
 };
@@ -143,8 +143,8 @@ class App : public AppBase<App>
 		analysisToolsWidget.SetNetworkAnalyser(&na, &na_cfg);
 		PlotWidgetObj.SetControllers(&OSCWidget, &analysisToolsWidget);
 
-		PlotWidgetObj.SetOscs(&OSC1Data, &OSC2Data, &MathData);
-		OSCWidget.SetOscs(&OSC1Data, &OSC2Data, &MathData);
+		PlotWidgetObj.SetOscs(&OSC1Data, &OSC2Data, MathData);
+		OSCWidget.SetOscs(&OSC1Data, &OSC2Data, MathData);
 
 		PlotWidgetObj.SetPlots(&spectrum_plots, &network_plots);
 		analysisToolsWidget.SetPlots(&spectrum_plots, &network_plots);
@@ -158,6 +158,9 @@ class App : public AppBase<App>
 
 		// Loads README.md contents for in-app documentation
 		loadREADME();
+
+		// FFT plans measured in earlier sessions (saved next to imgui.ini)
+		FFTPlanCache::Instance().LoadWisdom(fftw_wisdom_file);
 		
 		SetGlobalStyle();
     }
@@ -490,7 +493,11 @@ class App : public AppBase<App>
 				// Check connection status
 				const uint8_t firmware_variant = librador_get_device_firmware_variant();
 				connected = !(firmware_variant == 179 || firmware_variant == 176); // disconnected status
-				if (!connected) librador_reset_usb(); // not sure if this is neccessary
+				if (!connected)
+				{
+					na.Stop(); // the sweep thread talks to the device too
+					librador_reset_usb(); // not sure if this is neccessary
+				}
 				if (connected)
 				{
 					// Call controlLab functions for each widget
@@ -499,7 +506,12 @@ class App : public AppBase<App>
 						PSUWidget.controlLab();
 					}
 
-					// Signal generators update on change
+					// Signal generators update on change, except the one a sweep is driving
+					// (keyed on the running sweep's channel, not the editable settings)
+					const bool sweeping = na.running();
+					const int swept = na.CurrentConfig().gen_channel;
+					SG1Widget.setHeld(sweeping && swept == 1);
+					SG2Widget.setHeld(sweeping && swept == 2);
 					SG1Widget.controlLab();
 					SG2Widget.controlLab();
 				}
@@ -507,10 +519,6 @@ class App : public AppBase<App>
 				{
 					na.StartSweep(na_cfg);
 				}
-				if (na.running())
-				{
-					na.Tick();
-				}
 				
 			}
 			
@@ -594,9 +602,13 @@ class App : public AppBase<App>
 #ifndef NDEBUG
 		printf("Shutting Down\n");
 #endif
+		// Stop the sweep first so its thread cannot drive a generator after it is turned off
+		na.Stop();
 		// Turn off Signal Generators
 		SG1Widget.reset();
 		SG2Widget.reset();
+		FFTPlanCache::Instance().SaveWisdom(fftw_wisdom_file);
+		FFTPlanCache::Instance().Shutdown();
 	}
 
 	void loadREADME()
@@ -777,6 +789,7 @@ class App : public AppBase<App>
 	const int UNINIT_ENTER_THRESHOLD = 10;   // frames to enter
 	const int UNINIT_EXIT_THRESHOLD = 60;   // frames to exit
 	const float min_widget_width = 420.0f;
+	const char* fftw_wisdom_file = "fftw_wisdom.dat";
 	
 	// Define default configurations for widgets here
 	PSUControl PSUWidget = PSUControl("Power Supply Unit (PSU)", ImVec2(0,0), constants::PSU_ACCENT);
@@ -798,7 +811,7 @@ class App : public AppBase<App>
 	// Define Data shared across widgets
 	OscData OSC1Data = OscData(1);
 	OscData OSC2Data = OscData(2);
-	OscData MathData = OscData(0);
+	OscData MathData[constants::MATH_CHANNELS] = { OscData(0), OscData(0), OscData(0), OscData(0) };
 	SpectrumPlots spectrum_plots;
 	NetworkPlots network_plots;
 };
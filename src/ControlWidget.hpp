@@ -288,7 +288,7 @@ protected:
 	const float* accentColour;
 	OscData* OSC1Data = nullptr;
 	OscData* OSC2Data = nullptr;
-	OscData* MathData = nullptr;
+	OscData* MathData = nullptr; // constants::MATH_CHANNELS of them
 	SpectrumPlots* spectrum_plots = nullptr;
 	NetworkPlots* network_plots = nullptr;
 private:
@@ -0,0 +1,147 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include "util.h"
+
+enum class DecimationMethod
+{
+	MinMax = 0,
+	LTTB
+};
+
+/// <summary>
+/// Reduces a trace with ascending x to at most two points per pixel column over [x_min, x_max]; the
+/// linear-axis counterpart of PlotWidget::DecimateLogPlotTrace. MinMax keeps each column's extremes
+/// in time order, so peaks and glitches survive at any zoom. LTTB (largest triangle three buckets)
+/// picks the same number of points by visual area, which looks smoother on noisy signals but may
+/// drop single-sample spikes. One sample either side of the view is kept so the line reaches the
+/// plot edges, and traces already within the budget are copied unchanged.
+/// </summary>
+inline void DecimateLinearTrace(const double* x, const double* y, size_t n, double x_min, double x_max,
+	int columns, DecimationMethod method, PlotTrace& out)
+{
+	out.x.clear();
+	out.y.clear();
+	if (n == 0 || columns < 1 || !(x_max > x_min)) return;
+
+	// visible index range plus a guard sample either side
+	size_t lo = (size_t)(std::lower_bound(x, x + n, x_min) - x);
+	size_t hi = (size_t)(std::upper_bound(x, x + n, x_max) - x);
+	if (lo > 0) lo--;
+	if (hi < n) hi++;
+	const size_t m = hi - lo;
+	const size_t budget = 2 * (size_t)columns;
+	if (m <= budget + 2)
+	{
+		out.x.assign(x + lo, x + hi);
+		out.y.assign(y + lo, y + hi);
+		return;
+	}
+	out.x.reserve(budget + 2);
+	out.y.reserve(budget + 2);
+	auto push = [&](size_t i)
+	{
+		out.x.push_back(x[i]);
+		out.y.push_back(y[i]);
+	};
+
+	if (method == DecimationMethod::LTTB)
+	{
+		// bucket by index: for the uniformly sampled traces plotted here that is bucketing by time
+		const size_t buckets = budget - 2;
+		const double every = (double)(m - 2) / (double)buckets;
+		size_t a = lo;
+		push(a);
+		for (size_t b = 0; b < buckets; ++b)
+		{
+			const size_t r0 = lo + 1 + (size_t)(b * every);
+			const size_t r1 = std::min(lo + 1 + (size_t)((b + 1) * every), hi - 1);
+			// the third vertex is the average of the next bucket (the last point for the final one)
+			const size_t n0 = r1;
+			const size_t n1 = std::max(n0 + 1, std::min(lo + 1 + (size_t)((b + 2) * every), hi));
+			double cx = 0.0, cy = 0.0;
+			for (size_t k = n0; k < n1; ++k)
+			{
+				cx += x[k];
+				cy += y[k];
+			}
+			cx /= (double)(n1 - n0);
+			cy /= (double)(n1 - n0);
+
+			const double ax = x[a], ay = y[a];
+			size_t best = r0;
+			double best_area = -1.0;
+			for (size_t k = r0; k < r1; ++k)
+			{
+				const double area = std::abs((ax - cx) * (y[k] - ay) - (ax - x[k]) * (cy - ay));
+				if (area > best_area)
+				{
+					best_area = area;
+					best = k;
+				}
+			}
+			if (r0 < r1)
+			{
+				push(best);
+				a = best;
+			}
+		}
+		push(hi - 1);
+		return;
+	}
+
+	// MinMax: a single pass, comparing against the right edge of the current column
+	const double col_w = (x_max - x_min) / columns;
+	size_t i = lo;
+	while (i < hi)
+	{
+		const double edge = x_min + (std::floor((x[i] - x_min) / col_w) + 1.0) * col_w;
+		size_t i_min = i, i_max = i;
+		double y_min = y[i], y_max = y[i];
+		size_t j = i + 1;
+		for (; j < hi && x[j] < edge; ++j)
+		{
+			const double v = y[j];
+			if (v < y_min) { y_min = v; i_min = j; }
+			if (v > y_max) { y_max = v; i_max = j; }
+		}
+		push(std::min(i_min, i_max));
+		if (i_min != i_max) push(std::max(i_min, i_max));
+		i = j;
+	}
+}
+
+/// <summary>
+/// Holds the decimated copy of one trace and only recomputes it when the data generation, the
+/// visible x range, the plot width or the method changes, so a paused or static trace costs nothing.
+/// </summary>
+class TraceDecimator
+{
+public:
+	const PlotTrace& Update(const std::vector<double>& x, const std::vector<double>& y, uint64_t generation,
+		double x_min, double x_max, int columns, DecimationMethod method)
+	{
+		if (valid && generation == last_generation && x_min == last_x_min && x_max == last_x_max
+			&& columns == last_columns && method == last_method)
+			return trace;
+		DecimateLinearTrace(x.data(), y.data(), std::min(x.size(), y.size()), x_min, x_max, columns, method, trace);
+		valid = true;
+		last_generation = generation;
+		last_x_min = x_min;
+		last_x_max = x_max;
+		last_columns = columns;
+		last_method = method;
+		return trace;
+	}
+	void Invalidate() { valid = false; }
+
+private:
+	PlotTrace trace;
+	bool valid = false;
+	uint64_t last_generation = 0;
+	double last_x_min = 0.0, last_x_max = 0.0;
+	int last_columns = 0;
+	DecimationMethod last_method = DecimationMethod::MinMax;
+};
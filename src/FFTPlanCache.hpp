@@ -0,0 +1,431 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <map>
+#include <deque>
+#include <string>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
+#include <cmath>
+#define _USE_MATH_DEFINES
+#include "math.h"
+#include "fftw3.h"
+
+/// <summary>
+/// Process-wide cache of real-to-complex FFTW plans, one per transform length, and of the few
+/// complex-to-real plans the math channels use.
+/// FFTW's planner is not thread-safe (only the execute functions are), so every planner call goes
+/// through PlannerMutex(). A length is first planned from wisdom if possible, otherwise with
+/// FFTW_ESTIMATE so the first acquisition is not delayed. If background measuring is enabled, the
+/// same length is then re-planned with FFTW_MEASURE on a worker thread and the better plan is swapped
+/// in when it is ready. That can take tens of seconds for the large, non-power-of-two lengths the
+/// spectrum analyser uses, so it is opt-in; the result is kept as wisdom so each length is only
+/// measured once. The planner is held for the whole measurement, so a length first requested
+/// meanwhile cannot be planned: GetR2C returns null rather than block unless the caller is a worker
+/// that may wait, and the power-of-two lengths the streaming spectra use are planned before each
+/// measurement starts so they never have to.
+/// Plans are run through the new-array execute interface, so each caller keeps its own
+/// fftw_malloc'd buffers (see SpectrumWorkspace).
+/// Lengths of ThreadedMinLength and up are planned for FFTW's thread pool where the library has one
+/// (not the bundled macOS build); they get half the cores, as both channels transform at once.
+/// </summary>
+class FFTPlanCache
+{
+public:
+	static FFTPlanCache& Instance()
+	{
+		// never destroyed: a measurement still running at exit is left to finish on its own thread,
+		// and static OscData objects may execute plans until the very end
+		static FFTPlanCache* cache = new FFTPlanCache();
+		return *cache;
+	}
+
+	static constexpr int ThreadedMinLength = 1 << 18;
+	// Welch segments and spectrogram rows (512..32768 and 256..4096 points)
+	static constexpr int StreamMinLength = 1 << 8;
+	static constexpr int StreamMaxLength = 1 << 15;
+
+	std::mutex& PlannerMutex() { return planner_mutex; }
+
+	/// <summary>
+	/// Returns the best plan available for an n-point r2c transform, creating it on first use.
+	/// If n is new while a length is being measured, returns null, or with `wait` (worker threads
+	/// only; never the UI thread) waits for the measurement to end. Null after Shutdown().
+	/// </summary>
+	fftw_plan GetR2C(int n, bool wait = false)
+	{
+		{
+			std::lock_guard<std::mutex> lock(map_mutex);
+			auto it = plans.find(n);
+			if (it != plans.end()) return it->second.plan;
+		}
+		fftw_plan plan = nullptr;
+		bool measured = false;
+		{
+			std::unique_lock<std::mutex> lock = LockPlanner(wait);
+			if (!lock.owns_lock()) return nullptr;
+			{
+				// planned by another thread while this one waited
+				std::lock_guard<std::mutex> map_lock(map_mutex);
+				auto it = plans.find(n);
+				if (it != plans.end()) return it->second.plan;
+			}
+			double* in = fftw_alloc_real((size_t)n);
+			fftw_complex* out = fftw_alloc_complex((size_t)n / 2 + 1);
+			SetPlannerThreads(n);
+			plan = fftw_plan_dft_r2c_1d(n, in, out, FFTW_MEASURE | FFTW_WISDOM_ONLY);
+			measured = (plan != nullptr);
+			if (!plan) plan = fftw_plan_dft_r2c_1d(n, in, out, FFTW_ESTIMATE);
+			SetPlannerThreads(1);
+			fftw_free(in);
+			fftw_free(out);
+		}
+		{
+			std::lock_guard<std::mutex> lock(map_mutex);
+			auto it = plans.find(n);
+			if (it != plans.end())
+			{
+				// another thread planned the same length meanwhile
+				retired.push_back(plan);
+				return it->second.plan;
+			}
+			plans[n] = Entry{ plan, measured };
+			if (!measured && background_measure.load())
+			{
+				queue.push_back(n);
+				StartWorker();
+			}
+		}
+		queue_cv.notify_one();
+		return plan;
+	}
+
+	/// <summary>
+	/// Plan for an n-point complex-to-real (inverse) transform, made on first use from wisdom or
+	/// with FFTW_ESTIMATE and never measured in the background. Null, like GetR2C without `wait`,
+	/// while a measurement holds the planner.
+	/// </summary>
+	fftw_plan GetC2R(int n)
+	{
+		{
+			std::lock_guard<std::mutex> lock(map_mutex);
+			auto it = c2r_plans.find(n);
+			if (it != c2r_plans.end()) return it->second;
+		}
+		std::unique_lock<std::mutex> planner = LockPlanner(false);
+		if (!planner.owns_lock()) return nullptr;
+		{
+			std::lock_guard<std::mutex> lock(map_mutex);
+			auto it = c2r_plans.find(n);
+			if (it != c2r_plans.end()) return it->second;
+		}
+		fftw_complex* in = fftw_alloc_complex((size_t)n / 2 + 1);
+		double* out = fftw_alloc_real((size_t)n);
+		fftw_plan plan = fftw_plan_dft_c2r_1d(n, in, out, FFTW_MEASURE | FFTW_WISDOM_ONLY);
+		if (!plan) plan = fftw_plan_dft_c2r_1d(n, in, out, FFTW_ESTIMATE);
+		fftw_free(in);
+		fftw_free(out);
+		std::lock_guard<std::mutex> lock(map_mutex);
+		c2r_plans[n] = plan;
+		return plan;
+	}
+
+	/// <summary>
+	/// Enables or disables FFTW_MEASURE re-planning on the background thread. Lengths seen while
+	/// disabled are measured when it is enabled again.
+	/// </summary>
+	void SetBackgroundMeasure(bool on)
+	{
+		if (background_measure.exchange(on) == on || !on) return;
+		{
+			std::lock_guard<std::mutex> lock(map_mutex);
+			for (const auto& p : plans)
+				if (!p.second.measured && std::find(queue.begin(), queue.end(), p.first) == queue.end())
+					queue.push_back(p.first);
+			if (!queue.empty()) StartWorker();
+		}
+		queue_cv.notify_one();
+	}
+
+	/// <summary>
+	/// Takes the planner for a short planning call. While a measurement holds it, gives up with an
+	/// unowned lock, or with `wait` waits until the measurement ends; also unowned after Shutdown().
+	/// Other holders only plan with FFTW_ESTIMATE, so they are waited for.
+	/// </summary>
+	std::unique_lock<std::mutex> LockPlanner(bool wait)
+	{
+		std::unique_lock<std::mutex> planner(planner_mutex, std::defer_lock);
+		while (!planner.try_lock())
+		{
+			std::unique_lock<std::mutex> lock(map_mutex);
+			if (stop) break;
+			if (!measuring)
+			{
+				lock.unlock();
+				std::this_thread::yield();
+				continue;
+			}
+			if (!wait) break;
+			idle_cv.wait(lock, [this]() { return stop || !measuring; });
+		}
+		return planner;
+	}
+
+	/// <summary>
+	/// True while a length is queued for, or undergoing, background measurement.
+	/// </summary>
+	bool IsMeasuring()
+	{
+		std::lock_guard<std::mutex> lock(map_mutex);
+		return !queue.empty() || measuring;
+	}
+
+	bool LoadWisdom(const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(planner_mutex);
+		return fftw_import_wisdom_from_filename(path.c_str()) != 0;
+	}
+
+	/// <summary>
+	/// Writes the accumulated wisdom if anything new has been measured since it was loaded. Skipped
+	/// (returning false) while a measurement holds the planner; what it finds is saved next time.
+	/// </summary>
+	bool SaveWisdom(const std::string& path)
+	{
+		if (!wisdom_dirty.load()) return true;
+		std::unique_lock<std::mutex> lock = LockPlanner(false);
+		if (!lock.owns_lock()) return false;
+		const bool ok = fftw_export_wisdom_to_filename(path.c_str()) != 0;
+		if (ok) wisdom_dirty = false;
+		return ok;
+	}
+
+	/// <summary>
+	/// Drops the queued lengths and stops the worker, without waiting for a measurement in
+	/// progress: FFTW cannot cancel one, so it is left to finish on its detached thread. Threads
+	/// waiting on it give up. Call once, at exit.
+	/// </summary>
+	void Shutdown()
+	{
+		bool busy = false;
+		{
+			std::lock_guard<std::mutex> lock(map_mutex);
+			stop = true;
+			queue.clear();
+			busy = measuring;
+		}
+		queue_cv.notify_all();
+		idle_cv.notify_all();
+		if (!worker.joinable()) return;
+		if (busy) worker.detach();
+		else worker.join();
+	}
+
+private:
+	struct Entry
+	{
+		fftw_plan plan;
+		bool measured;
+	};
+
+	FFTPlanCache()
+	{
+#if !defined(__APPLE__)
+		threads_available = fftw_init_threads() != 0;
+		planner_threads = std::max(1, (int)std::thread::hardware_concurrency() / 2);
+#endif
+	}
+	FFTPlanCache(const FFTPlanCache&) = delete;
+	FFTPlanCache& operator=(const FFTPlanCache&) = delete;
+
+	std::mutex planner_mutex;
+	std::mutex map_mutex; // guards plans, c2r_plans, retired, queue, measuring and stop
+	std::map<int, Entry> plans;
+	std::map<int, fftw_plan> c2r_plans; // inverse transforms (math channel envelope)
+	std::vector<fftw_plan> retired; // superseded plans; another thread may still be executing them
+	std::deque<int> queue;
+	std::condition_variable queue_cv;
+	std::condition_variable idle_cv; // measuring cleared or stop set
+	std::thread worker;
+	bool measuring = false;
+	bool stop = false;
+	std::atomic<bool> background_measure{ false };
+	std::atomic<bool> wisdom_dirty{ false };
+	bool threads_available = false;
+	int planner_threads = 1;
+
+	// called with planner_mutex held; plans made after this use the chosen thread count
+	void SetPlannerThreads(int n)
+	{
+#if !defined(__APPLE__)
+		if (threads_available)
+			fftw_plan_with_nthreads(n >= ThreadedMinLength ? planner_threads : 1);
+#else
+		(void)n;
+#endif
+	}
+
+	// called with map_mutex held
+	void StartWorker()
+	{
+		if (!worker.joinable())
+			worker = std::thread([this]() { WorkerLoop(); });
+	}
+
+	void WorkerLoop()
+	{
+		for (;;)
+		{
+			int n = 0;
+			{
+				std::unique_lock<std::mutex> lock(map_mutex);
+				queue_cv.wait(lock, [this]() { return stop || (!queue.empty() && background_measure.load()); });
+				if (stop) return;
+				n = queue.front();
+				queue.pop_front();
+				measuring = true;
+			}
+			fftw_plan plan = nullptr;
+			{
+				std::lock_guard<std::mutex> lock(planner_mutex);
+				PlanStreamLengths();
+				// FFTW_MEASURE overwrites its arrays, so plan on scratch buffers
+				double* in = fftw_alloc_real((size_t)n);
+				fftw_complex* out = fftw_alloc_complex((size_t)n / 2 + 1);
+				// no fftw_set_timelimit: plans cut short by it are stored as wisdom that
+				// FFTW_WISDOM_ONLY lookups never match, so they could not be reused next session
+				SetPlannerThreads(n);
+				plan = fftw_plan_dft_r2c_1d(n, in, out, FFTW_MEASURE);
+				SetPlannerThreads(1);
+				fftw_free(in);
+				fftw_free(out);
+			}
+			{
+				std::lock_guard<std::mutex> lock(map_mutex);
+				measuring = false;
+				if (plan)
+				{
+					Entry& e = plans[n];
+					retired.push_back(e.plan);
+					e.plan = plan;
+					e.measured = true;
+					wisdom_dirty = true;
+				}
+			}
+			idle_cv.notify_all();
+		}
+	}
+
+	// called with planner_mutex held, before a measurement: the UI thread's streaming spectra
+	// then find their plan cached whatever length is picked during it
+	void PlanStreamLengths()
+	{
+		for (int n = StreamMinLength; n <= StreamMaxLength; n *= 2)
+		{
+			{
+				std::lock_guard<std::mutex> lock(map_mutex);
+				if (plans.count(n)) continue;
+			}
+			double* in = fftw_alloc_real((size_t)n);
+			fftw_complex* out = fftw_alloc_complex((size_t)n / 2 + 1);
+			fftw_plan plan = fftw_plan_dft_r2c_1d(n, in, out, FFTW_MEASURE | FFTW_WISDOM_ONLY);
+			const bool measured = (plan != nullptr);
+			if (!plan) plan = fftw_plan_dft_r2c_1d(n, in, out, FFTW_ESTIMATE);
+			fftw_free(in);
+			fftw_free(out);
+			std::lock_guard<std::mutex> lock(map_mutex);
+			plans[n] = Entry{ plan, measured };
+		}
+	}
+};
+
+/// <summary>
+/// Per-caller scratch for one windowed real FFT: SIMD-aligned input/output buffers and the window
+/// table with its coherent gain. Everything is rebuilt only when the length or window type
+/// changes, so a repeat acquisition only fills In() and calls Execute().
+/// </summary>
+class SpectrumWorkspace
+{
+public:
+	enum Window
+	{
+		Hann = 0,
+		Rectangular = 1
+	};
+
+	SpectrumWorkspace() = default;
+	SpectrumWorkspace(const SpectrumWorkspace&) = delete;
+	SpectrumWorkspace& operator=(const SpectrumWorkspace&) = delete;
+	~SpectrumWorkspace()
+	{
+		Release();
+	}
+
+	void Prepare(size_t n, int window_type)
+	{
+		if (n != length)
+		{
+			Release();
+			length = n;
+			if (n > 0)
+			{
+				in = fftw_alloc_real(n);
+				out = fftw_alloc_complex(n / 2 + 1);
+			}
+			window_length = 0;
+		}
+		if (n != window_length || window_type != window_kind)
+		{
+			window.assign(n, 1.0);
+			if (window_type == Hann && n > 1)
+			{
+				const double inv = 1.0 / double(n - 1);
+				for (size_t k = 0; k < n; ++k)
+					window[k] = 0.5 * (1.0 - std::cos(2.0 * M_PI * k * inv));
+			}
+			window_sum = 0.0;
+			for (double a : window) window_sum += a;
+			window_length = n;
+			window_kind = window_type;
+		}
+	}
+
+	double* In() { return in; }
+	const fftw_complex* Out() const { return out; }
+	const std::vector<double>& GetWindow() const { return window; }
+	double WindowSum() const { return window_sum; }
+	size_t Length() const { return length; }
+
+	/// <summary>
+	/// Transforms In() into Out(). False, with Out() untouched, if no plan could be had without
+	/// blocking (see FFTPlanCache::GetR2C; `wait` only off the UI thread).
+	/// </summary>
+	bool Execute(bool wait = false)
+	{
+		if (length == 0) return false;
+		const fftw_plan plan = FFTPlanCache::Instance().GetR2C((int)length, wait);
+		if (!plan) return false;
+		fftw_execute_dft_r2c(plan, in, out);
+		return true;
+	}
+
+private:
+	size_t length = 0;
+	double* in = nullptr;
+	fftw_complex* out = nullptr;
+	std::vector<double> window;
+	size_t window_length = 0;
+	int window_kind = -1;
+	double window_sum = 0.0;
+
+	void Release()
+	{
+		if (in) fftw_free(in);
+		if (out) fftw_free(out);
+		in = nullptr;
+		out = nullptr;
+		length = 0;
+	}
+};
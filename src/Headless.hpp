@@ -0,0 +1,782 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <map>
+#include <functional>
+#include <fstream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <csignal>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <cmath>
+#include <algorithm>
+#include "librador.h"
+#include "util.h"
+#include "OscData.hpp"
+#include "LibradorRead.hpp"
+#include "NetworkAnalyser.hpp"
+#include "FFTPlanCache.hpp"
+
+/// <summary>
+/// `LabraScope --headless`: acquisition and measurement without a window. The engines the GUI
+/// drives once per frame (OscData's trigger, measurements, stream pump and spectrum, and the
+/// network analyser) are run from a plain loop paced by the acquisition itself, and the results
+/// are written as CSV to stdout or a file. Settings are `key=value` arguments, or config files of
+/// `key = value` lines, applied in the order given; README.md lists the keys.
+/// </summary>
+class Headless
+{
+public:
+	enum class Mode { Measure, Stream, Spectrum, Network };
+
+	struct Config
+	{
+		Mode mode = Mode::Measure;
+		bool channels[2] = { true, true };
+		int gain = 1; // fixed oscilloscope gain; 1 takes the largest signals
+
+		// Time base, relative to the trigger (the GUI's initial view)
+		double time_min = -0.015;
+		double time_max = 0.015;
+
+		bool trigger = true;
+		constants::Channel trigger_channel = constants::Channel::OSC1;
+		constants::TriggerType trigger_type = constants::TriggerType::RISING_EDGE;
+		bool auto_trigger_level = true; // follows the trigger channel's average, as in the GUI
+		double trigger_level = 3.3 / 2;
+		double trigger_hysteresis = 0.25;
+
+		std::vector<std::string> measurements = { "vpp", "vavg", "vrms", "frequency" };
+
+		double spectrum_rate = 375000;
+		double spectrum_window = 1;
+		int spectrum_window_function = 0; // 0=Hann, 1=Rectangular
+		int spectrum_units = 0;           // 0=dBV, 1=dBm, 2=Vrms
+
+		NetworkAnalyser::Config network;
+		int sweeps = 1;
+		std::string calibration;       // through calibration to load before sweeping
+		std::string store_calibration; // saves the first sweep here as a through calibration
+
+		double interval = 0; // minimum seconds between rows; 0 = every new acquisition
+		double duration = 0; // seconds; 0 = until interrupted
+		std::string output = "-";
+	};
+
+	/// <summary>
+	/// True if the command line asks for headless mode (`--headless` as the first argument).
+	/// </summary>
+	static bool Requested(int argc, char** argv)
+	{
+		return argc > 1 && argv && std::string(argv[1]) == "--headless";
+	}
+
+	/// <summary>
+	/// Applies the arguments after `--headless`. Returns false, having printed why to stderr (or
+	/// the usage for --help), if the run should not go ahead.
+	/// </summary>
+	bool Configure(int argc, char** argv)
+	{
+		cfg.network.f_start = 10;
+		cfg.network.f_stop = 1000;
+		for (int i = 2; i < argc; ++i)
+		{
+			const std::string arg = argv[i];
+			if (arg == "--help" || arg == "-h")
+			{
+				PrintUsage();
+				showed_usage = true;
+				return false;
+			}
+			const size_t eq = arg.find('=');
+			const bool ok = eq == std::string::npos ? ApplyFile(arg)
+				: Apply(Trim(arg.substr(0, eq)), Trim(arg.substr(eq + 1)), "command line");
+			if (!ok) return false;
+		}
+		return Validate();
+	}
+
+	bool ShowedUsage() const
+	{
+		return showed_usage;
+	}
+
+	/// <summary>
+	/// Connects to the board and runs the configured mode until the duration has passed, the
+	/// sweeps are done, or SIGINT/SIGTERM. Returns the process exit code.
+	/// </summary>
+	int Run()
+	{
+		out = cfg.output == "-" ? stdout : std::fopen(cfg.output.c_str(), "w");
+		if (!out)
+		{
+			std::fprintf(stderr, "headless: cannot open %s for writing\n", cfg.output.c_str());
+			return 1;
+		}
+		std::setvbuf(out, nullptr, _IOFBF, 1 << 16);
+		if (!Connect())
+		{
+			CloseOutput();
+			return 1;
+		}
+		FFTPlanCache::Instance().LoadWisdom(fftw_wisdom_file);
+
+		StopRequested().store(false);
+		std::signal(SIGINT, OnSignal);
+		std::signal(SIGTERM, OnSignal);
+
+		int code = 0;
+		switch (cfg.mode)
+		{
+		case Mode::Measure: RunMeasure(); break;
+		case Mode::Stream: RunStream(); break;
+		case Mode::Spectrum: RunSpectrum(); break;
+		case Mode::Network: code = RunNetwork(); break;
+		}
+		Disconnect();
+		CloseOutput();
+		return code;
+	}
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct MeasurementField
+	{
+		const char* name;
+		double SignalMeasurements::*value;
+	};
+
+	Config cfg;
+	FILE* out = nullptr;
+	OscData OSC1Data = OscData(1);
+	OscData OSC2Data = OscData(2);
+	std::vector<const MeasurementField*> fields;
+	bool relative_phase = false;
+	bool showed_usage = false;
+	double auto_level = 3.3 / 2;
+	Clock::time_point start;
+
+	const char* fftw_wisdom_file = "fftw_wisdom.dat";
+	static constexpr double StreamPollSeconds = 0.01; // well inside librador's 5 s since-last window
+	static constexpr double WarmUpSeconds = 0.25;     // lets the buffer fill past the trigger timeout
+
+	static const std::vector<MeasurementField>& MeasurementFields()
+	{
+		static const std::vector<MeasurementField> table = {
+			{ "vmax", &SignalMeasurements::vmax },
+			{ "vmin", &SignalMeasurements::vmin },
+			{ "vpp", &SignalMeasurements::vpp },
+			{ "vavg", &SignalMeasurements::vavg },
+			{ "vrms", &SignalMeasurements::vrms },
+			{ "period", &SignalMeasurements::period },
+			{ "frequency", &SignalMeasurements::frequency },
+			{ "duty", &SignalMeasurements::duty },
+			{ "rise_time", &SignalMeasurements::rise_time },
+			{ "fall_time", &SignalMeasurements::fall_time },
+		};
+		return table;
+	}
+
+	static std::atomic<bool>& StopRequested()
+	{
+		static std::atomic<bool> stop{ false };
+		return stop;
+	}
+
+	static void OnSignal(int)
+	{
+		StopRequested().store(true);
+	}
+
+	// --------------------- Configuration ---------------------
+
+	static std::string Trim(const std::string& s)
+	{
+		const size_t a = s.find_first_not_of(" \t\r\n");
+		if (a == std::string::npos) return "";
+		const size_t b = s.find_last_not_of(" \t\r\n");
+		return s.substr(a, b - a + 1);
+	}
+
+	static bool ParseNumber(const std::string& s, double& value)
+	{
+		char* end = nullptr;
+		const double v = std::strtod(s.c_str(), &end);
+		if (s.empty() || *end != '\0' || !std::isfinite(v)) return false;
+		value = v;
+		return true;
+	}
+
+	static bool ParseInt(const std::string& s, int& value)
+	{
+		double v;
+		if (!ParseNumber(s, v) || v != std::floor(v) || std::fabs(v) > 1e9) return false;
+		value = (int)v;
+		return true;
+	}
+
+	static bool ParseBool(const std::string& s, bool& value)
+	{
+		if (s == "1" || s == "true" || s == "on" || s == "yes") value = true;
+		else if (s == "0" || s == "false" || s == "off" || s == "no") value = false;
+		else return false;
+		return true;
+	}
+
+	static std::vector<std::string> SplitList(const std::string& s)
+	{
+		std::vector<std::string> items;
+		size_t begin = 0;
+		while (begin <= s.size())
+		{
+			const size_t comma = std::min(s.find(',', begin), s.size());
+			const std::string item = Trim(s.substr(begin, comma - begin));
+			if (!item.empty()) items.push_back(item);
+			begin = comma + 1;
+		}
+		return items;
+	}
+
+	/// <summary>
+	/// Parser for each key; each returns false if it cannot use the value.
+	/// </summary>
+	std::map<std::string, std::function<bool(const std::string&)>> Setters()
+	{
+		auto number = [](double& field) {
+			return [&field](const std::string& v) { return ParseNumber(v, field); };
+		};
+		auto integer = [](int& field) {
+			return [&field](const std::string& v) { return ParseInt(v, field); };
+		};
+		auto boolean = [](bool& field) {
+			return [&field](const std::string& v) { return ParseBool(v, field); };
+		};
+		auto text = [](std::string& field) {
+			return [&field](const std::string& v) { field = v; return !v.empty(); };
+		};
+		auto choice = [](int& field, std::vector<std::string> names) {
+			return [&field, names](const std::string& v) {
+				const auto it = std::find(names.begin(), names.end(), v);
+				if (it == names.end()) return false;
+				field = (int)(it - names.begin());
+				return true;
+			};
+		};
+		auto osc_channel = [](int& field) {
+			return [&field](const std::string& v) { return ParseInt(v, field) && (field == 1 || field == 2); };
+		};
+		NetworkAnalyser::Config& na = cfg.network;
+		return {
+			{ "mode", [this](const std::string& v) {
+				static const std::map<std::string, Mode> modes = { { "measure", Mode::Measure },
+					{ "stream", Mode::Stream }, { "spectrum", Mode::Spectrum }, { "network", Mode::Network } };
+				const auto it = modes.find(v);
+				if (it == modes.end()) return false;
+				cfg.mode = it->second;
+				return true;
+			} },
+			{ "channels", [this](const std::string& v) {
+				cfg.channels[0] = cfg.channels[1] = false;
+				for (const std::string& c : SplitList(v))
+				{
+					int ch;
+					if (!ParseInt(c, ch) || (ch != 1 && ch != 2)) return false;
+					cfg.channels[ch - 1] = true;
+				}
+				return cfg.channels[0] || cfg.channels[1];
+			} },
+			{ "gain", integer(cfg.gain) },
+			{ "time_min", number(cfg.time_min) },
+			{ "time_max", number(cfg.time_max) },
+			{ "trigger", [this](const std::string& v) {
+				if (v == "off")
+				{
+					cfg.trigger = false;
+					return true;
+				}
+				const auto it = std::find(TriggerNames().begin(), TriggerNames().end(), v);
+				if (it == TriggerNames().end()) return false;
+				const maps::ChannelTriggerPair& pair
+					= maps::ComboItemToChannelTriggerPair.at((int)(it - TriggerNames().begin()));
+				cfg.trigger = true;
+				cfg.trigger_channel = pair.channel;
+				cfg.trigger_type = pair.trigger_type;
+				return true;
+			} },
+			{ "trigger_level", [this](const std::string& v) {
+				cfg.auto_trigger_level = v == "auto";
+				return cfg.auto_trigger_level || ParseNumber(v, cfg.trigger_level);
+			} },
+			{ "trigger_hysteresis", number(cfg.trigger_hysteresis) },
+			{ "measurements", [this](const std::string& v) {
+				cfg.measurements = SplitList(v);
+				return !cfg.measurements.empty();
+			} },
+			{ "spectrum_rate", number(cfg.spectrum_rate) },
+			{ "spectrum_window", number(cfg.spectrum_window) },
+			{ "spectrum_window_function", choice(cfg.spectrum_window_function, { "hann", "rectangular" }) },
+			{ "spectrum_units", choice(cfg.spectrum_units, { "dBV", "dBm", "Vrms" }) },
+			{ "f_start", number(na.f_start) },
+			{ "f_stop", number(na.f_stop) },
+			{ "points", integer(na.points) },
+			{ "spacing", [&na](const std::string& v) {
+				if (v != "log" && v != "linear") return false;
+				na.log_spacing = v == "log";
+				return true;
+			} },
+			{ "method", [&na](const std::string& v) {
+				if (v != "stepped" && v != "multisine") return false;
+				na.broadband = v == "multisine";
+				return true;
+			} },
+			{ "adaptive", boolean(na.adaptive) },
+			{ "max_points", integer(na.adaptive_max_points) },
+			{ "max_captures", integer(na.avg_captures_max) },
+			{ "remeasure_budget", integer(na.remeasure_budget) },
+			{ "amplitude", number(na.gen_amplitude_v) },
+			{ "stimulus", osc_channel(na.gen_channel) },
+			{ "input_channel", osc_channel(na.ch_input) },
+			{ "output_channel", osc_channel(na.ch_output) },
+			{ "apply_calibration", boolean(na.apply_calibration) },
+			{ "calibration", text(cfg.calibration) },
+			{ "store_calibration", text(cfg.store_calibration) },
+			{ "sweeps", integer(cfg.sweeps) },
+			{ "interval", number(cfg.interval) },
+			{ "duration", number(cfg.duration) },
+			{ "output", text(cfg.output) },
+		};
+	}
+
+	/// <summary>
+	/// Trigger names, in the order of the GUI's trigger combo (maps::ComboItemToChannelTriggerPair).
+	/// </summary>
+	static const std::vector<std::string>& TriggerNames()
+	{
+		static const std::vector<std::string> names = { "osc1_rising", "osc1_falling", "osc2_rising", "osc2_falling" };
+		return names;
+	}
+
+	bool Apply(const std::string& key, const std::string& value, const std::string& where)
+	{
+		const auto setters = Setters();
+		const auto it = setters.find(key);
+		if (it == setters.end())
+		{
+			std::fprintf(stderr, "headless: unknown key '%s' (%s)\n", key.c_str(), where.c_str());
+			return false;
+		}
+		if (!it->second(value))
+		{
+			std::fprintf(stderr, "headless: bad value '%s' for %s (%s)\n", value.c_str(), key.c_str(), where.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	bool ApplyFile(const std::string& path)
+	{
+		std::ifstream file(path);
+		if (!file.is_open())
+		{
+			std::fprintf(stderr, "headless: cannot read config file %s\n", path.c_str());
+			return false;
+		}
+		std::string line;
+		int line_number = 0;
+		while (std::getline(file, line))
+		{
+			++line_number;
+			line = Trim(line.substr(0, line.find('#')));
+			if (line.empty()) continue;
+			const size_t eq = line.find('=');
+			const std::string where = path + ":" + std::to_string(line_number);
+			if (eq == std::string::npos)
+			{
+				std::fprintf(stderr, "headless: expected key = value (%s)\n", where.c_str());
+				return false;
+			}
+			if (!Apply(Trim(line.substr(0, eq)), Trim(line.substr(eq + 1)), where)) return false;
+		}
+		return true;
+	}
+
+	bool Fail(const char* message)
+	{
+		std::fprintf(stderr, "headless: %s\n", message);
+		return false;
+	}
+
+	bool Validate()
+	{
+		const NetworkAnalyser::Config& na = cfg.network;
+		if (cfg.gain < 1 || cfg.gain > 64 || (cfg.gain & (cfg.gain - 1)) != 0)
+			return Fail("gain must be 1, 2, 4, 8, 16, 32 or 64");
+		if (!(cfg.time_max > cfg.time_min)) return Fail("time_max must be greater than time_min");
+		if (cfg.interval < 0 || cfg.duration < 0) return Fail("interval and duration cannot be negative");
+		const double max_rate = OSC1Data.GetStreamRate();
+		const double decimation = max_rate / cfg.spectrum_rate;
+		if (!(cfg.spectrum_rate > 0 && cfg.spectrum_rate <= max_rate) || decimation != std::round(decimation))
+			return Fail("spectrum_rate must divide 375000");
+		if (!(cfg.spectrum_window > 0)) return Fail("spectrum_window must be positive");
+		if (!(na.f_start > 0 && na.f_stop > na.f_start)) return Fail("need 0 < f_start < f_stop");
+		if (na.points < 2) return Fail("points must be at least 2");
+		cfg.network.adaptive_max_points = std::max(na.adaptive_max_points, na.points);
+		if (na.avg_captures_max < na.avg_captures_min) return Fail("max_captures must be at least 2");
+		if (cfg.sweeps < 1) return Fail("sweeps must be at least 1");
+
+		fields.clear();
+		relative_phase = false;
+		for (const std::string& name : cfg.measurements)
+		{
+			if (name == "phase")
+			{
+				if (!(cfg.channels[0] && cfg.channels[1])) return Fail("phase needs both channels");
+				relative_phase = true;
+				continue;
+			}
+			const auto& table = MeasurementFields();
+			const auto it = std::find_if(table.begin(), table.end(),
+				[&name](const MeasurementField& f) { return name == f.name; });
+			if (it == table.end())
+			{
+				std::fprintf(stderr, "headless: unknown measurement '%s'\n", name.c_str());
+				return false;
+			}
+			fields.push_back(&*it);
+		}
+		return true;
+	}
+
+	static void PrintUsage()
+	{
+		std::printf(
+			"usage: LabraScope --headless [config_file | key=value]...\n"
+			"Settings apply in order, later ones overriding earlier ones. CSV goes to output.\n"
+			"  mode          measure | stream | spectrum | network (measure)\n"
+			"  channels      1 | 2 | 1,2 (1,2)\n"
+			"  gain          fixed oscilloscope gain 1..64 (1)\n"
+			"  time_min/max  window around the trigger in s (-0.015/0.015)\n"
+			"  trigger       off | osc1_rising | osc1_falling | osc2_rising | osc2_falling\n"
+			"  trigger_level V or auto (auto); trigger_hysteresis V (0.25)\n"
+			"  measurements  vmax,vmin,vpp,vavg,vrms,period,frequency,duty,rise_time,fall_time,phase\n"
+			"  spectrum_rate, spectrum_window, spectrum_window_function, spectrum_units\n"
+			"  f_start, f_stop, points, spacing, method, adaptive, max_points, max_captures,\n"
+			"  remeasure_budget, amplitude, stimulus, input_channel, output_channel,\n"
+			"  calibration, store_calibration, apply_calibration, sweeps\n"
+			"  interval      minimum s between rows (0)\n"
+			"  duration      s, 0 = until interrupted (0)\n"
+			"  output        file, or - for stdout (-)\n");
+	}
+
+	// --------------------- Device ---------------------
+
+	bool Connect()
+	{
+		int error = librador_init();
+		if (error)
+		{
+			std::fprintf(stderr, "headless: librador_init failed with error code %d\n", error);
+			return false;
+		}
+		error = librador_setup_usb();
+		if (error)
+		{
+			std::fprintf(stderr, "headless: no Labrador board found (librador_setup_usb error %d)\n", error);
+			librador_exit();
+			return false;
+		}
+		const uint16_t deviceVersion = librador_get_device_firmware_version();
+		const uint8_t deviceVariant = librador_get_device_firmware_variant();
+		if (deviceVersion != constants::DESIRED_FW_VERSION || deviceVariant != constants::DESIRED_FW_VARIANT)
+		{
+			std::fprintf(stderr, "headless: board firmware %hu/%hhu is not the expected %hu/%hhu; "
+				"start LabraScope normally once to update it\n", deviceVersion, deviceVariant,
+				constants::DESIRED_FW_VERSION, constants::DESIRED_FW_VARIANT);
+			librador_exit();
+			return false;
+		}
+		librador_set_device_mode(2);
+		librador_set_oscilloscope_gain(cfg.gain);
+		return true;
+	}
+
+	/// <summary>
+	/// Leaves the board idle however the run ended: the stimulus a sweep left on is turned off,
+	/// the FFTW wisdom is saved and librador is closed. Run after the sweep thread has been joined.
+	/// </summary>
+	void Disconnect()
+	{
+		if (cfg.mode == Mode::Network)
+		{
+			std::lock_guard<std::mutex> gen_lock(LibradorGeneratorMutex());
+			librador_send_sin_wave(cfg.network.gen_channel, 100, 0.0, 0.0);
+		}
+		FFTPlanCache::Instance().SaveWisdom(fftw_wisdom_file);
+		FFTPlanCache::Instance().Shutdown();
+		librador_exit();
+	}
+
+	void CloseOutput()
+	{
+		if (!out) return;
+		if (out == stdout) std::fflush(out);
+		else std::fclose(out);
+		out = nullptr;
+	}
+
+	// --------------------- Pacing ---------------------
+
+	double Elapsed() const
+	{
+		return std::chrono::duration<double>(Clock::now() - start).count();
+	}
+
+	bool Finished() const
+	{
+		return StopRequested().load() || (cfg.duration > 0 && Elapsed() >= cfg.duration);
+	}
+
+	/// <summary>
+	/// Sleeps until `deadline` in short steps so a signal is noticed promptly. False if the run
+	/// should stop instead.
+	/// </summary>
+	bool SleepUntil(Clock::time_point deadline) const
+	{
+		while (Clock::now() < deadline)
+		{
+			if (Finished()) return false;
+			std::this_thread::sleep_until(std::min(deadline, Clock::now() + std::chrono::milliseconds(50)));
+		}
+		return !Finished();
+	}
+
+	/// <summary>
+	/// Steps `next` on by `period` seconds. A loop that fell behind waits a full period from now
+	/// instead of catching up, which would only read the same samples again.
+	/// </summary>
+	static void Advance(Clock::time_point& next, double period)
+	{
+		const Clock::duration step = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(period));
+		const Clock::time_point now = Clock::now();
+		next += step;
+		if (next < now) next = now + step;
+	}
+
+	OscData& Osc(int channel)
+	{
+		return channel == 1 ? OSC1Data : OSC2Data;
+	}
+
+	// --------------------- Modes ---------------------
+
+	/// <summary>
+	/// One triggered acquisition of both channels, following PlotWidget::UpdateOscData.
+	/// </summary>
+	void Acquire()
+	{
+		for (OscData* osc : { &OSC1Data, &OSC2Data })
+		{
+			osc->SetTime(cfg.time_min, cfg.time_max);
+			osc->SetTriggerTimePlot(0);
+			osc->SetExtendedData();
+			osc->SetTriggerOn(cfg.trigger);
+		}
+		OscData& trigger_osc = Osc(cfg.trigger_channel);
+		const double level = cfg.auto_trigger_level ? auto_level : cfg.trigger_level;
+		const double trigger_time = trigger_osc.GetTriggerTime(cfg.trigger, cfg.trigger_type, level, cfg.trigger_hysteresis);
+		for (OscData* osc : { &OSC1Data, &OSC2Data })
+		{
+			osc->SetTriggerTime(trigger_time);
+			osc->SetData();
+		}
+		const double average = trigger_osc.GetMeasurements().vavg;
+		if (std::isfinite(average)) auto_level = average;
+	}
+
+	/// <summary>
+	/// A row of measurements per acquisition: a new window is taken once the last one has been
+	/// replaced by fresh samples, or every `interval` if that is longer.
+	/// </summary>
+	void RunMeasure()
+	{
+		std::fprintf(out, "time_s");
+		for (int ch = 1; ch <= 2; ++ch)
+		{
+			if (!cfg.channels[ch - 1]) continue;
+			for (const MeasurementField* f : fields) std::fprintf(out, ",osc%d_%s", ch, f->name);
+		}
+		if (relative_phase) std::fprintf(out, ",phase_deg");
+		std::fprintf(out, "\n");
+
+		const double period = std::max(cfg.interval, cfg.time_max - cfg.time_min);
+		start = Clock::now();
+		Clock::time_point next = start;
+		Advance(next, WarmUpSeconds + (cfg.time_max - cfg.time_min));
+		while (SleepUntil(next))
+		{
+			Advance(next, period);
+			const double t = Elapsed();
+			Acquire();
+			if (OSC1Data.GetDataSize() == 0 || OSC2Data.GetDataSize() == 0) continue;
+			std::fprintf(out, "%.7f", t);
+			for (int ch = 1; ch <= 2; ++ch)
+			{
+				if (!cfg.channels[ch - 1]) continue;
+				const SignalMeasurements& m = Osc(ch).GetMeasurements();
+				for (const MeasurementField* f : fields) std::fprintf(out, ",%.6g", m.*(f->value));
+			}
+			if (relative_phase) std::fprintf(out, ",%.6g", OSC1Data.GetRelativePhaseDeg(OSC2Data));
+			std::fprintf(out, "\n");
+			std::fflush(out);
+		}
+	}
+
+	/// <summary>
+	/// Every sample at the full stream rate. Each channel keeps its own since-last cursor, so
+	/// samples are held until the other channel has caught up and rows always pair them.
+	/// </summary>
+	void RunStream()
+	{
+		std::fprintf(out, "time_s");
+		for (int ch = 1; ch <= 2; ++ch)
+			if (cfg.channels[ch - 1]) std::fprintf(out, ",osc%d", ch);
+		std::fprintf(out, "\n");
+
+		const double dt = 1 / OSC1Data.GetStreamRate();
+		std::vector<double> pending[2];
+		uint64_t sample = 0;
+		start = Clock::now();
+		// drops what was buffered before the start, so both channels begin at the same instant
+		for (int ch = 1; ch <= 2; ++ch)
+			if (cfg.channels[ch - 1]) Osc(ch).PumpStream();
+		Clock::time_point next = start;
+		while (true)
+		{
+			Advance(next, StreamPollSeconds);
+			if (!SleepUntil(next)) break;
+			size_t rows = SIZE_MAX;
+			for (int ch = 1; ch <= 2; ++ch)
+			{
+				if (!cfg.channels[ch - 1]) continue;
+				Osc(ch).PumpStream();
+				const std::vector<double>& chunk = Osc(ch).GetStreamChunk();
+				pending[ch - 1].insert(pending[ch - 1].end(), chunk.begin(), chunk.end());
+				rows = std::min(rows, pending[ch - 1].size());
+			}
+			for (size_t i = 0; i < rows; ++i)
+			{
+				std::fprintf(out, "%.7f", (double)(sample + i) * dt);
+				for (int ch = 1; ch <= 2; ++ch)
+					if (cfg.channels[ch - 1]) std::fprintf(out, ",%.5f", pending[ch - 1][i]);
+				std::fprintf(out, "\n");
+			}
+			for (std::vector<double>& p : pending)
+				if (!p.empty()) p.erase(p.begin(), p.begin() + rows);
+			sample += rows;
+			std::fflush(out);
+		}
+	}
+
+	const std::vector<double>& SpectrumLevels(OscData& osc) const
+	{
+		switch (cfg.spectrum_units)
+		{
+		case 1: return *osc.GetSpectrumMagdBm_p();
+		case 2: return *osc.GetSpectrumMag_p();
+		default: return *osc.GetSpectrumMagdBV_p();
+		}
+	}
+
+	/// <summary>
+	/// A spectrum of the last `spectrum_window` seconds each time that many seconds have arrived,
+	/// both channels transformed at once as in the GUI. One row per bin.
+	/// </summary>
+	void RunSpectrum()
+	{
+		static const char* units[] = { "dBV", "dBm", "Vrms" };
+		std::fprintf(out, "time_s,freq_hz");
+		for (int ch = 1; ch <= 2; ++ch)
+			if (cfg.channels[ch - 1]) std::fprintf(out, ",osc%d_%s", ch, units[cfg.spectrum_units]);
+		std::fprintf(out, "\n");
+
+		const double period = std::max(cfg.interval, cfg.spectrum_window);
+		start = Clock::now();
+		Clock::time_point next = start;
+		Advance(next, cfg.spectrum_window);
+		while (SleepUntil(next))
+		{
+			Advance(next, period);
+			const double t = Elapsed();
+			for (int ch = 1; ch <= 2; ++ch)
+				if (cfg.channels[ch - 1])
+					Osc(ch).StartSpectrumAnalysis(cfg.spectrum_rate, cfg.spectrum_window, cfg.spectrum_window_function);
+			for (int ch = 1; ch <= 2; ++ch)
+				if (cfg.channels[ch - 1])
+					while (!Osc(ch).CollectSpectrumAnalysis())
+						std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			const int first = cfg.channels[0] ? 1 : 2;
+			const std::vector<double>& freq = *Osc(first).GetSpectrumFreq_p();
+			for (size_t i = 0; i < freq.size(); ++i)
+			{
+				std::fprintf(out, "%.7f,%.6g", t, freq[i]);
+				for (int ch = 1; ch <= 2; ++ch)
+				{
+					if (!cfg.channels[ch - 1]) continue;
+					const std::vector<double>& level = SpectrumLevels(Osc(ch));
+					std::fprintf(out, ",%.6g", i < level.size() ? level[i] : NAN);
+				}
+				std::fprintf(out, "\n");
+			}
+			std::fflush(out);
+		}
+	}
+
+	/// <summary>
+	/// `sweeps` network analyser sweeps, each written once it completes; points that failed the
+	/// coherence gate are written as nan.
+	/// </summary>
+	int RunNetwork()
+	{
+		NetworkAnalyser na;
+		if (!cfg.calibration.empty() && !na.LoadCalibration(cfg.calibration))
+		{
+			std::fprintf(stderr, "headless: %s is not a calibration file\n", cfg.calibration.c_str());
+			return 1;
+		}
+		std::fprintf(out, "sweep,freq_hz,mag_dB,phase_deg\n");
+		start = Clock::now();
+		for (int sweep = 1; sweep <= cfg.sweeps && !Finished(); ++sweep)
+		{
+			na.StartSweep(cfg.network);
+			while (na.running())
+			{
+				if (Finished())
+				{
+					na.Stop();
+					break;
+				}
+				std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			}
+			const std::vector<double>& f = na.freqs();
+			const std::vector<double>& mag_dB = na.mag_dB();
+			const std::vector<double>& ph = na.phase_rad();
+			for (size_t i = 0; i < f.size(); ++i)
+				std::fprintf(out, "%d,%.6g,%.6g,%.6g\n", sweep, f[i], mag_dB[i], ph[i] * 180.0 / M_PI);
+			std::fflush(out);
+			if (sweep == 1 && !cfg.store_calibration.empty() && !StopRequested().load())
+			{
+				if (!na.StoreCalibration() || !na.SaveCalibration(cfg.store_calibration))
+				{
+					std::fprintf(stderr, "headless: could not store the calibration in %s\n", cfg.store_calibration.c_str());
+					return 1;
+				}
+			}
+		}
+		return 0;
+	}
+};
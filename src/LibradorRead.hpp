@@ -0,0 +1,27 @@
+#pragma once
+#include <mutex>
+
+/// <summary>
+/// librador_get_analog_data and librador_get_analog_data_sincelast return a pointer to a buffer
+/// that librador keeps per channel and rewrites on the next read of that channel; its own lock is
+/// released before the call returns. Since the network analyser reads from its sweep thread while
+/// the UI reads every frame, every reader holds this mutex from the call until it has copied the
+/// samples out.
+/// </summary>
+inline std::mutex& LibradorReadMutex()
+{
+	static std::mutex mutex;
+	return mutex;
+}
+
+/// <summary>
+/// librador builds the waveform for librador_send_*_wave and librador_update_signal_gen_settings
+/// in per-channel globals before sending it, so the network analyser's sweep thread and the signal
+/// generator widgets must not command the generators at the same time. Every caller holds this
+/// mutex for the duration of the call.
+/// </summary>
+inline std::mutex& LibradorGeneratorMutex()
+{
+	static std::mutex mutex;
+	return mutex;
+}
@@ -0,0 +1,570 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cstdint>
+#include <cctype>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include "exprtk.hpp"
+#include "MathFunctions.hpp"
+#include "util.h"
+
+/// <summary>
+/// Persistent compiled math channels. All channel expressions are compiled into one exprtk
+/// program, "math1 := (...); math2 := (...); ...", whose symbol table binds osc1, osc2, t and
+/// math1..math4 to buffers owned here, so a frame copies the inputs once and runs one program.
+/// A channel may use another channel by name; channels are ordered so each runs after the ones it
+/// uses, and identical native function calls are computed once however many channels use them.
+/// The program is recompiled only when a text changes or the sample count outgrows the capacity
+/// the buffers were bound at; a smaller count only resizes the vector views, which compiled exprtk
+/// code follows. Texts that fail are remembered and not re-parsed every frame. The program is
+/// grown one channel at a time, so a broken channel, a reference cycle or a reference to an empty
+/// or broken channel only fails the channels involved.
+/// An element-wise program (every output sample depends only on the input samples at the same
+/// index) over a long record is split into contiguous chunks, each with its own compiled instance
+/// whose vector views are rebased onto its slice of the shared buffers every frame, and the chunks
+/// are evaluated on worker threads that are kept between frames. Anything else - indexing, reductions, loops, assignments,
+/// comparisons - is evaluated serially by a single instance over the whole record.
+/// Calls to the native functions in MathFunctions.hpp are expanded before compiling: each
+/// lpf(x, fc) becomes a statement filling a scratch vector, and the call is replaced by that
+/// vector. A non-trivial x is assigned to a scratch vector of its own first.
+/// </summary>
+class MathEngine
+{
+public:
+	/// <summary>
+	/// Smallest chunk worth a thread of its own.
+	/// </summary>
+	static constexpr size_t MinChunk = 1 << 15;
+
+	static constexpr int MaxChannels = constants::MATH_CHANNELS;
+
+	MathEngine()
+	{
+		for (int k = 0; k < MathFunction::Count; ++k)
+			functions.push_back(std::make_unique<MathFunction>((MathFunction::Kind)k, sample_period, record_size));
+	}
+	~MathEngine()
+	{
+		{
+			std::lock_guard<std::mutex> lock(pool_mutex);
+			pool_stop = true;
+		}
+		pool_cv.notify_all();
+		for (std::thread& th : workers) th.join();
+	}
+	MathEngine(const MathEngine&) = delete;
+	MathEngine& operator=(const MathEngine&) = delete;
+
+	/// <summary>
+	/// Evaluates the channel expressions (texts[ch] for math ch+1, empty if unused) over the inputs.
+	/// Each channel's result has the length of `time` and stays valid until the next call. Inputs
+	/// shorter than `time` (including empty ones) are zero-padded, longer ones are truncated.
+	/// </summary>
+	void Evaluate(const std::vector<std::string>& texts, const std::vector<double>& osc1,
+		const std::vector<double>& osc2, const std::vector<double>& time)
+	{
+		generation++;
+		const size_t n = time.size();
+		if (n == 0)
+		{
+			// If there is literally no time vector, nothing can be evaluated.
+			for (int ch = 0; ch < MaxChannels; ++ch)
+			{
+				outputs[ch].clear();
+				status[ch].success = false;
+			}
+			capacity = 0; // the outputs were dropped, so the next record recompiles
+			return;
+		}
+		if (texts != compiled_texts || n > capacity)
+		{
+			Compile(texts, n);
+		}
+		if (instances.empty())
+		{
+			return;
+		}
+		Load(osc1_buf, osc1, n);
+		Load(osc2_buf, osc2, n);
+		std::copy(time.begin(), time.end(), time_buf.begin());
+		sample_period = (n > 1) ? (time.back() - time.front()) / (double)(n - 1) : 0.0;
+		record_size = n;
+		for (int ch = 0; ch < MaxChannels; ++ch)
+		{
+			// within the capacity reserved at compile time, so the data does not move
+			if (status[ch].success) outputs[ch].resize(n);
+		}
+
+		Run(n); // fills the channel outputs
+	}
+
+	/// <summary>
+	/// Result of channel `ch` from the last Evaluate; empty if it did not compile.
+	/// </summary>
+	const std::vector<double>& Result(int ch) const
+	{
+		return outputs[ch];
+	}
+
+	const ParseStatus& Status(int ch) const
+	{
+		return status[ch];
+	}
+
+	/// <summary>
+	/// Name expressions use for channel `ch` (0-based): math1..math4.
+	/// </summary>
+	static std::string ChannelName(int ch)
+	{
+		return "math" + std::to_string(ch + 1);
+	}
+
+	/// <summary>
+	/// Bit ch set for every channel name `text` mentions.
+	/// </summary>
+	static unsigned ChannelReferences(const std::string& text)
+	{
+		unsigned refs = 0;
+		const size_t n = text.size();
+		size_t i = 0;
+		while (i < n)
+		{
+			if (!(std::isalpha((unsigned char)text[i]) || text[i] == '_'))
+			{
+				// skip numbers whole, so the "e5" of "1e5" is not taken for a name
+				if (std::isdigit((unsigned char)text[i]))
+					while (i < n && (std::isalnum((unsigned char)text[i]) || text[i] == '_' || text[i] == '.')) i++;
+				else
+					i++;
+				continue;
+			}
+			const size_t start = i;
+			while (i < n && (std::isalnum((unsigned char)text[i]) || text[i] == '_')) i++;
+			const std::string name = text.substr(start, i - start);
+			for (int ch = 0; ch < MaxChannels; ++ch)
+				if (name == ChannelName(ch)) refs |= 1u << ch;
+		}
+		return refs;
+	}
+
+	/// <summary>
+	/// Counter bumped by every Evaluate; the results have not changed while it holds still.
+	/// </summary>
+	uint64_t Generation() const
+	{
+		return generation;
+	}
+
+	/// <summary>
+	/// Number of times an expression has been compiled (for profiling).
+	/// </summary>
+	uint64_t CompileCount() const
+	{
+		return compile_count;
+	}
+
+	/// <summary>
+	/// Number of instances the compiled expression is split over (1 when serial); a record shorter
+	/// than the capacity runs on fewer of them.
+	/// </summary>
+	size_t ChunkCount() const
+	{
+		return instances.size();
+	}
+
+	/// <summary>
+	/// True if `text` only uses operators and functions that apply sample by sample, so evaluating
+	/// it over slices of the inputs gives the same samples as evaluating it over the whole record.
+	/// Deliberately conservative: an unknown identifier or any character outside plain arithmetic
+	/// makes it serial.
+	/// </summary>
+	static bool IsElementWise(const std::string& text)
+	{
+		static const char* const allowed[] = {
+			"osc1", "osc2", "t", "math1", "math2", "math3", "math4", "pi", "epsilon", "inf",
+			"abs", "acos", "acosh", "asin", "asinh", "atan", "atanh", "ceil", "cos", "cosh", "cot",
+			"csc", "deg2grad", "deg2rad", "erf", "erfc", "exp", "expm1", "floor", "frac", "grad2deg",
+			"log", "log10", "log1p", "log2", "ncdf", "rad2deg", "round", "sec", "sgn", "sin", "sinc",
+			"sinh", "sqrt", "tan", "tanh", "trunc" };
+		size_t i = 0;
+		const size_t n = text.size();
+		while (i < n)
+		{
+			const unsigned char c = (unsigned char)text[i];
+			if (std::isspace(c) || (c != 0 && std::strchr("+-*/%^(),", c)))
+			{
+				i++;
+			}
+			else if (std::isdigit(c) || c == '.')
+			{
+				// number, with an optional exponent
+				while (i < n && (std::isdigit((unsigned char)text[i]) || text[i] == '.')) i++;
+				if (i < n && (text[i] == 'e' || text[i] == 'E'))
+				{
+					i++;
+					if (i < n && (text[i] == '+' || text[i] == '-')) i++;
+				}
+				while (i < n && std::isdigit((unsigned char)text[i])) i++;
+			}
+			else if (std::isalpha(c) || c == '_')
+			{
+				const size_t start = i;
+				while (i < n && (std::isalnum((unsigned char)text[i]) || text[i] == '_')) i++;
+				const std::string name = text.substr(start, i - start);
+				if (std::find_if(std::begin(allowed), std::end(allowed),
+					[&](const char* a) { return name == a; }) == std::end(allowed))
+					return false;
+			}
+			else
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+private:
+	/// <summary>
+	/// One compiled copy of the program, with the channels in the `channels` bit mask bound. Every
+	/// vector is bound through a view of the whole buffer at the engine's capacity; Bind moves the
+	/// views onto [offset, offset + size) before a run. The symbol table keeps pointers to the
+	/// views, so an Instance never moves once compiled.
+	/// </summary>
+	struct Instance
+	{
+		struct Binding
+		{
+			std::vector<double>* buffer;
+			exprtk::vector_view<double> view;
+		};
+		std::vector<Binding> bindings;
+		exprtk::symbol_table<double> sym;
+		exprtk::expression<double> expr;
+
+		Instance(MathEngine& e, unsigned channels)
+		{
+			bindings.reserve(3 + MaxChannels + e.scratch.size()); // never reallocated
+			Add("osc1", e.osc1_buf, e.capacity);
+			Add("osc2", e.osc2_buf, e.capacity);
+			Add("t", e.time_buf, e.capacity);
+			for (int ch = 0; ch < MaxChannels; ++ch)
+			{
+				if (channels & (1u << ch)) Add(ChannelName(ch), e.outputs[ch], e.capacity);
+			}
+			sym.add_constants();
+			for (const std::unique_ptr<MathFunction>& f : e.functions)
+				sym.add_function(MathFunction::Name(f->GetKind()), *f);
+			for (size_t k = 0; k < e.scratch.size(); ++k)
+				Add(ScratchName(k), e.scratch[k], e.capacity);
+			expr.register_symbol_table(sym);
+		}
+
+		void Add(const std::string& name, std::vector<double>& buffer, size_t capacity)
+		{
+			bindings.push_back({ &buffer, exprtk::vector_view<double>(buffer.data(), capacity) });
+			sym.add_vector(name, bindings.back().view);
+		}
+
+		void Bind(size_t offset, size_t size)
+		{
+			for (Binding& b : bindings)
+			{
+				b.view.rebase(b.buffer->data() + offset);
+				b.view.set_size(size);
+			}
+		}
+	};
+
+	std::vector<std::unique_ptr<MathFunction>> functions;
+	std::vector<std::vector<double>> scratch;
+	double sample_period = 0.0;
+	size_t record_size = 0; // samples in the current record; the buffers may be longer
+	exprtk::parser<double> parser;
+	std::vector<double> osc1_buf, osc2_buf, time_buf;
+	std::vector<double> outputs[MaxChannels];
+	ParseStatus status[MaxChannels];
+	std::vector<std::string> compiled_texts;
+	size_t capacity = 0; // length the buffers and views were bound at
+	uint64_t compile_count = 0;
+	uint64_t generation = 0;
+	// Worker c runs chunk c (the calling thread takes chunk 0); started as chunks need them
+	std::vector<std::thread> workers;
+	std::mutex pool_mutex; // guards the pool_ fields
+	std::condition_variable pool_cv, done_cv;
+	uint64_t pool_round = 0;  // bumped to start a run
+	size_t pool_chunks = 0;   // chunks in the current run
+	size_t pool_pending = 0;  // worker chunks of the current run still computing
+	bool pool_stop = false;
+	// last, so the compiled instances go before the buffers and functions they refer to
+	std::vector<std::unique_ptr<Instance>> instances;
+
+	void Compile(const std::vector<std::string>& texts, size_t n)
+	{
+		compiled_texts = texts;
+		compile_count++;
+		instances.clear();
+		scratch.clear();
+
+		// Bound at the next power of two, so a longer record within that reuses the program. The
+		// buffers are sized once per compile and never reallocated until the next one, so the
+		// addresses the views hold stay valid.
+		capacity = 1;
+		while (capacity < n) capacity <<= 1;
+		osc1_buf.assign(capacity, 0.0);
+		osc2_buf.assign(capacity, 0.0);
+		time_buf.assign(capacity, 0.0);
+		unsigned used = 0, refs[MaxChannels] = {};
+		for (int ch = 0; ch < MaxChannels; ++ch)
+		{
+			outputs[ch].clear();
+			status[ch].success = false;
+			if (ch < (int)texts.size() && !Trim(texts[ch]).empty())
+			{
+				used |= 1u << ch;
+				refs[ch] = ChannelReferences(texts[ch]);
+			}
+		}
+
+		// dependency order; whatever is never placed is in a cycle or uses an unused channel
+		std::vector<int> order;
+		unsigned placed = 0;
+		for (bool progress = true; progress;)
+		{
+			progress = false;
+			for (int ch = 0; ch < MaxChannels; ++ch)
+			{
+				const unsigned bit = 1u << ch;
+				if ((used & bit) && !(placed & bit) && !(refs[ch] & ~placed))
+				{
+					order.push_back(ch);
+					placed |= bit;
+					progress = true;
+				}
+			}
+		}
+
+		// grow the program a channel at a time, checking each addition with a full-length probe
+		std::string program;
+		std::map<std::string, std::string> calls;
+		unsigned compiled = 0;
+		bool element_wise = true;
+		for (int ch : order)
+		{
+			if (refs[ch] & ~compiled) continue; // uses a broken channel
+			std::string statements, body;
+			std::map<std::string, std::string> trial_calls = calls;
+			const size_t scratch_before = scratch.size();
+			size_t scratch_count = scratch_before;
+			if (!ExpandCalls(texts[ch], statements, body, scratch_count, trial_calls)) continue;
+			const std::string trial = program + statements + ChannelName(ch) + " := (" + body + ");\n";
+			while (scratch.size() < scratch_count) scratch.emplace_back(capacity, 0.0);
+			outputs[ch].assign(capacity, 0.0);
+			Instance probe(*this, compiled | (1u << ch));
+			if (parser.compile(trial, probe.expr))
+			{
+				program = trial;
+				calls = trial_calls;
+				compiled |= 1u << ch;
+				element_wise = element_wise && IsElementWise(texts[ch]);
+			}
+			else
+			{
+				outputs[ch].clear();
+				scratch.resize(scratch_before);
+			}
+		}
+		if (!compiled) return;
+
+		size_t chunks = 1;
+		if (element_wise)
+		{
+			const size_t workers = std::max(1u, std::min(std::thread::hardware_concurrency(), 16u));
+			chunks = std::max<size_t>(1, std::min(workers, capacity / MinChunk));
+		}
+
+		// the parser is not thread safe, so every instance is compiled here
+		bool compiled_ok = true;
+		for (size_t c = 0; c < chunks && compiled_ok; ++c)
+		{
+			instances.push_back(std::make_unique<Instance>(*this, compiled));
+			compiled_ok = parser.compile(program, instances.back()->expr);
+		}
+		if (!compiled_ok)
+		{
+			instances.clear();
+			return;
+		}
+		for (int ch = 0; ch < MaxChannels; ++ch)
+			status[ch].success = (compiled & (1u << ch)) != 0;
+	}
+
+	void Run(size_t n)
+	{
+		const size_t chunks = std::max<size_t>(1, std::min(instances.size(), n / MinChunk));
+		const size_t base = n / chunks, extra = n % chunks;
+		size_t offset = 0;
+		for (size_t c = 0; c < chunks; ++c)
+		{
+			const size_t size = base + (c < extra ? 1 : 0);
+			instances[c]->Bind(offset, size);
+			offset += size;
+		}
+		if (chunks == 1)
+		{
+			instances[0]->expr.value();
+			return;
+		}
+		while (workers.size() < chunks - 1)
+		{
+			const size_t c = workers.size() + 1;
+			workers.emplace_back([this, c]() { WorkerLoop(c); });
+		}
+		{
+			std::lock_guard<std::mutex> lock(pool_mutex);
+			pool_chunks = chunks;
+			pool_pending = chunks - 1;
+			pool_round++;
+		}
+		pool_cv.notify_all();
+		// the calling thread takes the first chunk
+		instances[0]->expr.value();
+		std::unique_lock<std::mutex> lock(pool_mutex);
+		done_cv.wait(lock, [this]() { return pool_pending == 0; });
+	}
+
+	void WorkerLoop(size_t c)
+	{
+		uint64_t seen = 0;
+		for (;;)
+		{
+			Instance* inst = nullptr;
+			{
+				std::unique_lock<std::mutex> lock(pool_mutex);
+				pool_cv.wait(lock, [this, seen]() { return pool_stop || pool_round != seen; });
+				if (pool_stop) return;
+				seen = pool_round;
+				if (c >= pool_chunks) continue; // not needed this run
+				inst = instances[c].get();
+			}
+			inst->expr.value();
+			std::lock_guard<std::mutex> lock(pool_mutex);
+			if (--pool_pending == 0) done_cv.notify_one();
+		}
+	}
+
+	static constexpr const char* ScratchPrefix = "dsp_tmp";
+
+	static std::string ScratchName(size_t k)
+	{
+		return ScratchPrefix + std::to_string(k);
+	}
+
+	/// <summary>
+	/// Copies `text` to `body`, replacing every call to a MathFunction with the scratch vector it
+	/// fills and appending the statements that fill them to `statements`, innermost first. `calls`
+	/// maps each statement already in the program to its scratch vector, so a repeated call reuses
+	/// it instead of adding another. Fails on an unbalanced call or a wrong argument count.
+	/// </summary>
+	static bool ExpandCalls(const std::string& text, std::string& statements, std::string& body,
+		size_t& scratch_count, std::map<std::string, std::string>& calls)
+	{
+		body.clear();
+		const size_t n = text.size();
+		size_t i = 0;
+		while (i < n)
+		{
+			const unsigned char c = (unsigned char)text[i];
+			if (!(std::isalpha(c) || c == '_'))
+			{
+				body += text[i++];
+				continue;
+			}
+			const size_t start = i;
+			while (i < n && (std::isalnum((unsigned char)text[i]) || text[i] == '_')) i++;
+			const std::string name = text.substr(start, i - start);
+			const int kind = MathFunction::Find(name);
+			size_t open = i;
+			while (open < n && std::isspace((unsigned char)text[open])) open++;
+			if (kind < 0 || open >= n || text[open] != '(')
+			{
+				body += name;
+				continue;
+			}
+
+			// split the arguments at top-level commas
+			std::vector<std::string> args;
+			int depth = 0;
+			size_t arg_start = open + 1, k = open + 1;
+			for (; k < n; ++k)
+			{
+				const char a = text[k];
+				if (a == '(' || a == '[' || a == '{') depth++;
+				else if ((a == ')' || a == ']' || a == '}') && depth-- == 0) break;
+				else if (a == ',' && depth == 0)
+				{
+					args.push_back(text.substr(arg_start, k - arg_start));
+					arg_start = k + 1;
+				}
+			}
+			if (k >= n) return false;
+			args.push_back(text.substr(arg_start, k - arg_start));
+			i = k + 1;
+			if (args.size() != (MathFunction::HasParameter((MathFunction::Kind)kind) ? 2u : 1u)) return false;
+
+			std::string input, parameter;
+			if (!ExpandCalls(args[0], statements, input, scratch_count, calls)) return false;
+			if (args.size() > 1 && !ExpandCalls(args[1], statements, parameter, scratch_count, calls)) return false;
+			input = Trim(input);
+			bool is_vector = input == "osc1" || input == "osc2" || input == "t" ||
+				(input.rfind(ScratchPrefix, 0) == 0 &&
+					input.find_first_not_of("0123456789", std::strlen(ScratchPrefix)) == std::string::npos);
+			for (int ch = 0; ch < MaxChannels; ++ch)
+				is_vector = is_vector || input == ChannelName(ch);
+			if (!is_vector)
+			{
+				input = Emit("", " := (" + input + ");\n", statements, scratch_count, calls);
+			}
+			// the output goes second: f(x, out) or f(x, out, p)
+			const std::string after = (args.size() > 1 ? ", " + Trim(parameter) : std::string()) + ");\n";
+			body += Emit(name + "(" + input + ", ", after, statements, scratch_count, calls);
+		}
+		return true;
+	}
+
+	/// <summary>
+	/// Scratch vector filled by the statement `before` + name + `after`. The statement is added,
+	/// with a new scratch vector, only the first time it is seen.
+	/// </summary>
+	static std::string Emit(const std::string& before, const std::string& after, std::string& statements,
+		size_t& scratch_count, std::map<std::string, std::string>& calls)
+	{
+		const std::string key = before + "@" + after;
+		const auto found = calls.find(key);
+		if (found != calls.end()) return found->second;
+		const std::string tmp = ScratchName(scratch_count++);
+		statements += before + tmp + after;
+		calls.emplace(key, tmp);
+		return tmp;
+	}
+
+	static std::string Trim(const std::string& s)
+	{
+		const size_t a = s.find_first_not_of(" \t\r\n");
+		if (a == std::string::npos) return std::string();
+		const size_t b = s.find_last_not_of(" \t\r\n");
+		return s.substr(a, b - a + 1);
+	}
+
+	static void Load(std::vector<double>& dst, const std::vector<double>& src, size_t n)
+	{
+		const size_t m = std::min(n, src.size());
+		std::copy(src.begin(), src.begin() + m, dst.begin());
+		std::fill(dst.begin() + m, dst.begin() + n, 0.0);
+	}
+};
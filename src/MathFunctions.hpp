@@ -0,0 +1,269 @@
+#pragma once
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <cmath>
+#include "exprtk.hpp"
+#include "FFTPlanCache.hpp"
+
+/// <summary>
+/// Native signal-processing functions for math channel expressions: lpf, diff, integ, ma,
+/// rms_window, fftmag and envelope. exprtk generic functions cannot return a vector, so each one
+/// takes its output as the second argument, e.g. lpf(in, out, fc), and MathEngine rewrites the
+/// form users type, lpf(osc1, fc), into such calls on scratch vectors. The filters are single
+/// passes that write straight into the output and allocate nothing; fftmag and envelope go
+/// through FFTW with plans from FFTPlanCache and buffers kept between calls. Frequencies are in Hz
+/// and derivatives and integrals are per second, using the sample period the engine takes from the
+/// time base before each evaluation.
+/// </summary>
+class MathFunction : public exprtk::igeneric_function<double>
+{
+public:
+	typedef exprtk::igeneric_function<double> igfun_t;
+	typedef igfun_t::parameter_list_t parameter_list_t;
+	typedef igfun_t::generic_type generic_type;
+	typedef generic_type::scalar_view scalar_t;
+	typedef generic_type::vector_view vector_t;
+
+	using igfun_t::operator();
+
+	enum Kind { LowPass, Derivative, Integral, MovingAverage, MovingRms, FftMagnitude, Envelope, Count };
+
+	/// <summary>
+	/// `dt` is the sample period in seconds and `samples` the record length. exprtk hands a
+	/// generic function its vectors at the length they were compiled at, which can be longer
+	/// than the record, so the kernels only run over the first `samples`. Both are read on every
+	/// call, so they must outlive the function.
+	/// </summary>
+	MathFunction(Kind kind, const double& dt, const size_t& samples)
+		: igfun_t(HasParameter(kind) ? "VVT" : "VV"), kind(kind), dt(dt), samples(samples)
+	{
+	}
+	~MathFunction()
+	{
+		Release();
+	}
+	MathFunction(const MathFunction&) = delete;
+	MathFunction& operator=(const MathFunction&) = delete;
+
+	static const char* Name(Kind kind)
+	{
+		static const char* names[Count] = { "lpf", "diff", "integ", "ma", "rms_window", "fftmag", "envelope" };
+		return names[kind];
+	}
+
+	/// <summary>
+	/// True if the function takes a scalar after the signal (cut-off or window length).
+	/// </summary>
+	static bool HasParameter(Kind kind)
+	{
+		return kind == LowPass || kind == MovingAverage || kind == MovingRms;
+	}
+
+	/// <summary>
+	/// Kind named `name`, or -1 if it is not one of these functions.
+	/// </summary>
+	static int Find(const std::string& name)
+	{
+		for (int k = 0; k < Count; ++k)
+			if (name == Name((Kind)k)) return k;
+		return -1;
+	}
+
+	Kind GetKind() const
+	{
+		return kind;
+	}
+
+	double operator()(parameter_list_t parameters) override
+	{
+		vector_t in(parameters[0]);
+		vector_t out(parameters[1]);
+		const size_t n = std::min({ in.size(), out.size(), samples });
+		if (n == 0) return 0.0;
+		const double p = HasParameter(kind) ? scalar_t(parameters[2])() : 0.0;
+		const double* x = in.begin();
+		double* y = out.begin();
+		switch (kind)
+		{
+		case LowPass: LowPassKernel(x, y, n, p, dt); break;
+		case Derivative: DerivativeKernel(x, y, n, dt); break;
+		case Integral: IntegralKernel(x, y, n, dt); break;
+		case MovingAverage: MovingAverageKernel(x, y, n, WindowLength(p, n)); break;
+		case MovingRms: MovingRmsKernel(x, y, n, WindowLength(p, n)); break;
+		case FftMagnitude: FftMagnitudeKernel(x, y, n); break;
+		case Envelope: EnvelopeKernel(x, y, n); break;
+		default: return 0.0;
+		}
+		return 1.0;
+	}
+
+	/// <summary>
+	/// First-order (RC) low-pass with a -3 dB point at fc, started at the first sample so there
+	/// is no turn-on transient. fc at or above Nyquist leaves the signal nearly untouched.
+	/// </summary>
+	static void LowPassKernel(const double* x, double* y, size_t n, double fc, double dt)
+	{
+		const double a = (fc > 0.0 && dt > 0.0) ? 1.0 - std::exp(-2.0 * M_PI * fc * dt) : 0.0;
+		double s = x[0];
+		for (size_t i = 0; i < n; ++i)
+		{
+			s += a * (x[i] - s);
+			y[i] = s;
+		}
+	}
+
+	/// <summary>
+	/// Central difference, one-sided at the ends, per second.
+	/// </summary>
+	static void DerivativeKernel(const double* x, double* y, size_t n, double dt)
+	{
+		if (n < 2 || !(dt > 0.0))
+		{
+			std::fill(y, y + n, 0.0);
+			return;
+		}
+		const double inv = 1.0 / dt, half_inv = 0.5 / dt;
+		y[0] = (x[1] - x[0]) * inv;
+		for (size_t i = 1; i + 1 < n; ++i)
+			y[i] = (x[i + 1] - x[i - 1]) * half_inv;
+		y[n - 1] = (x[n - 1] - x[n - 2]) * inv;
+	}
+
+	/// <summary>
+	/// Running trapezoidal integral from zero at the first sample, in units of signal * seconds.
+	/// </summary>
+	static void IntegralKernel(const double* x, double* y, size_t n, double dt)
+	{
+		const double h = 0.5 * dt;
+		double s = 0.0;
+		y[0] = 0.0;
+		for (size_t i = 1; i < n; ++i)
+		{
+			s += h * (x[i] + x[i - 1]);
+			y[i] = s;
+		}
+	}
+
+	/// <summary>
+	/// Trailing average of the last w samples; the first w - 1 average what is available.
+	/// </summary>
+	static void MovingAverageKernel(const double* x, double* y, size_t n, size_t w)
+	{
+		double s = 0.0;
+		for (size_t i = 0; i < n; ++i)
+		{
+			s += x[i];
+			if (i >= w) s -= x[i - w];
+			y[i] = s / (double)std::min(i + 1, w);
+		}
+	}
+
+	/// <summary>
+	/// Trailing RMS over the last w samples, with the same start-up as MovingAverageKernel.
+	/// </summary>
+	static void MovingRmsKernel(const double* x, double* y, size_t n, size_t w)
+	{
+		double s = 0.0;
+		for (size_t i = 0; i < n; ++i)
+		{
+			s += x[i] * x[i];
+			if (i >= w) s -= x[i - w] * x[i - w];
+			// the running sum can dip a rounding error below zero after a loud stretch
+			y[i] = std::sqrt(std::max(0.0, s / (double)std::min(i + 1, w)));
+		}
+	}
+
+	/// <summary>
+	/// Single-sided amplitude spectrum of the whole record: y[k] is the amplitude of the component
+	/// at k / (n dt) Hz for k <= n / 2 (the mean at k = 0), and the rest of y is zero. Left as it
+	/// was if no FFT plan could be had without blocking (see FFTPlanCache::GetR2C).
+	/// </summary>
+	void FftMagnitudeKernel(const double* x, double* y, size_t n)
+	{
+		if (!Forward(x, n)) return;
+		const size_t bins = n / 2 + 1;
+		const double edge = 1.0 / (double)n, scale = 2.0 / (double)n;
+		for (size_t k = 0; k < bins; ++k)
+		{
+			const bool unpaired = k == 0 || (n % 2 == 0 && k == n / 2); // no negative-frequency twin
+			y[k] = std::hypot(spectrum[k][0], spectrum[k][1]) * (unpaired ? edge : scale);
+		}
+		std::fill(y + bins, y + n, 0.0);
+	}
+
+	/// <summary>
+	/// Magnitude of the analytic signal, sqrt(x^2 + H{x}^2), with the Hilbert transform H taken
+	/// over the whole record. The record is treated as periodic, so the first and last cycles of
+	/// a signal that does not wrap cleanly show some ripple. Left as it was if no plan could be had
+	/// without blocking.
+	/// </summary>
+	void EnvelopeKernel(const double* x, double* y, size_t n)
+	{
+		if (n < 2)
+		{
+			for (size_t i = 0; i < n; ++i) y[i] = std::abs(x[i]);
+			return;
+		}
+		const fftw_plan inverse = FFTPlanCache::Instance().GetC2R((int)n);
+		if (!inverse || !Forward(x, n)) return;
+		// -j on the positive frequencies; DC and Nyquist have no quadrature part
+		const size_t bins = n / 2 + 1;
+		spectrum[0][0] = spectrum[0][1] = 0.0;
+		for (size_t k = 1; k < bins; ++k)
+		{
+			const double re = spectrum[k][0];
+			spectrum[k][0] = spectrum[k][1];
+			spectrum[k][1] = -re;
+		}
+		if (n % 2 == 0) spectrum[n / 2][0] = spectrum[n / 2][1] = 0.0;
+		fftw_execute_dft_c2r(inverse, spectrum, real); // unnormalised, and overwrites spectrum
+		const double inv = 1.0 / (double)n;
+		for (size_t i = 0; i < n; ++i)
+		{
+			const double h = real[i] * inv;
+			y[i] = std::sqrt(x[i] * x[i] + h * h);
+		}
+	}
+
+private:
+	const Kind kind;
+	const double& dt;
+	const size_t& samples;
+	// FFT buffers for fftmag and envelope, reallocated only when the record length changes
+	size_t length = 0;
+	double* real = nullptr;
+	fftw_complex* spectrum = nullptr;
+
+	// r2c transform of x[0..n) into spectrum. False if no plan could be had without blocking.
+	bool Forward(const double* x, size_t n)
+	{
+		if (n != length)
+		{
+			Release();
+			real = fftw_alloc_real(n);
+			spectrum = fftw_alloc_complex(n / 2 + 1);
+			length = n;
+		}
+		const fftw_plan plan = FFTPlanCache::Instance().GetR2C((int)n);
+		if (!plan) return false;
+		std::copy(x, x + n, real);
+		fftw_execute_dft_r2c(plan, real, spectrum);
+		return true;
+	}
+
+	void Release()
+	{
+		if (real) fftw_free(real);
+		if (spectrum) fftw_free(spectrum);
+		real = nullptr;
+		spectrum = nullptr;
+		length = 0;
+	}
+
+	static size_t WindowLength(double p, size_t n)
+	{
+		if (!(p >= 1.0)) return 1;
+		return (size_t)std::min((double)n, std::round(p));
+	}
+};
@@ -0,0 +1,383 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "TVD.hpp"
+#define _USE_MATH_DEFINES
+#include "math.h"
+
+/// <summary>
+/// Standard time-domain measurements of one signal. NaN marks a measurement that
+/// could not be made (no data, no full period, etc).
+/// </summary>
+struct SignalMeasurements
+{
+	double vmax = std::numeric_limits<double>::quiet_NaN();
+	double vmin = std::numeric_limits<double>::quiet_NaN();
+	double vpp = std::numeric_limits<double>::quiet_NaN();
+	double vavg = std::numeric_limits<double>::quiet_NaN();
+	double vrms = std::numeric_limits<double>::quiet_NaN();
+	double period = std::numeric_limits<double>::quiet_NaN();     // s
+	double frequency = std::numeric_limits<double>::quiet_NaN();  // Hz
+	double phase_deg = std::numeric_limits<double>::quiet_NaN();  // absolute phase at window centre
+	double phase_freq = std::numeric_limits<double>::quiet_NaN(); // refined frequency the phase was taken at
+	double duty = std::numeric_limits<double>::quiet_NaN();       // 0..1, fraction of period above mid level
+	double rise_time = std::numeric_limits<double>::quiet_NaN();  // s, 10% -> 90%
+	double fall_time = std::numeric_limits<double>::quiet_NaN();  // s, 90% -> 10%
+};
+
+/// <summary>
+/// Hann-windowed single-bin DFT projections, referenced to the centre of the window.
+/// The complex exponentials are generated with rotating-phasor recurrences (re-seeded every
+/// block so rounding cannot drift) and the window comes from a cached table, so the inner loop
+/// is multiply-adds only. Several bins and several channels are accumulated in the same pass.
+/// Assumes uniformly spaced samples (as produced by OscData::SetData).
+/// </summary>
+class PhaseEstimator
+{
+public:
+	static constexpr size_t MaxChannels = 2;
+	static constexpr size_t MaxBins = 3;
+
+	/// <summary>
+	/// Refines f0 on channel 0 (3-point parabolic fit of |S(f)| at f0-df, f0, f0+df, all from one
+	/// pass), then projects every channel at the refined frequency in a second, shared pass.
+	/// Returns false if nothing could be estimated.
+	/// </summary>
+	bool Estimate(const std::vector<double>& time, const std::vector<double>* const* channels,
+		const double* means, size_t n_channels, double f0, double* phase_deg_out, double& freq_out)
+	{
+		const size_t N = time.size();
+		if (N < 8 || n_channels == 0 || n_channels > MaxChannels) return false;
+		for (size_t c = 0; c < n_channels; ++c)
+			if (channels[c]->size() < N) return false;
+		if (!(std::isfinite(f0) && f0 > 0.0)) return false;
+
+		const double span = std::max(1e-12, time[N - 1] - time.front());
+		const double dt = span / (double)(N - 1);
+		const double df = 1.0 / span; // ~frequency bin of the aperture
+
+		// ---- 1) coarse bins on the reference channel ----
+		double re[MaxChannels][MaxBins], im[MaxChannels][MaxBins];
+		const double coarse[3] = { f0 - df, f0, f0 + df };
+		Project(channels, means, 1, N, dt, coarse, 3, re, im);
+		const double Am = re[0][0] * re[0][0] + im[0][0] * im[0][0];
+		const double A0 = re[0][1] * re[0][1] + im[0][1] * im[0][1];
+		const double Ap = re[0][2] * re[0][2] + im[0][2] * im[0][2];
+
+		double delta = 0.0;
+		const double denom = (Am - 2.0 * A0 + Ap);
+		if (std::fabs(denom) > 0.0)
+			delta = std::clamp(0.5 * (Am - Ap) / denom, -1.0, 1.0);
+		const double f1 = std::max(0.0, f0 + delta * df);
+
+		// ---- 2) every channel at the refined frequency ----
+		Project(channels, means, n_channels, N, dt, &f1, 1, re, im);
+		bool any = false;
+		for (size_t c = 0; c < n_channels; ++c) {
+			if (std::isfinite(re[c][0]) && std::isfinite(im[c][0])) {
+				phase_deg_out[c] = std::atan2(im[c][0], re[c][0]) * (180.0 / M_PI);
+				any = true;
+			}
+			else phase_deg_out[c] = std::numeric_limits<double>::quiet_NaN();
+		}
+		freq_out = f1;
+		return any;
+	}
+
+private:
+	static constexpr size_t Block = 256; // samples between exact phasor re-seeds
+
+	std::vector<double> window;
+
+	const double* HannTable(size_t N)
+	{
+		if (window.size() != N) {
+			window.resize(N);
+			for (size_t n = 0; n < N; ++n)
+				window[n] = 0.5 * (1.0 - std::cos(2.0 * M_PI * (double)n / (double)(N - 1)));
+		}
+		return window.data();
+	}
+
+	// S_c(f_k) = sum_n w[n] (x_c[n] - mean_c) e^{-i 2 pi f_k (t_n - t_centre)}
+	void Project(const std::vector<double>* const* channels, const double* means, size_t n_channels,
+		size_t N, double dt, const double* freqs, size_t n_bins,
+		double (&re_out)[MaxChannels][MaxBins], double (&im_out)[MaxChannels][MaxBins])
+	{
+		const double* w = HannTable(N);
+		const double centre = 0.5 * (double)(N - 1);
+		double w_step[MaxBins];
+		for (size_t k = 0; k < n_bins; ++k) w_step[k] = 2.0 * M_PI * freqs[k] * dt;
+		for (size_t c = 0; c < n_channels; ++c)
+			for (size_t k = 0; k < n_bins; ++k) re_out[c][k] = im_out[c][k] = 0.0;
+
+		double rot_re[MaxBins], rot_im[MaxBins];
+		for (size_t k = 0; k < n_bins; ++k) {
+			rot_re[k] = std::cos(w_step[k]);
+			rot_im[k] = -std::sin(w_step[k]);
+		}
+
+		for (size_t n0 = 0; n0 < N; n0 += Block) {
+			const size_t n1 = std::min(N, n0 + Block);
+			// exact seed at the block start: e^{-i w (n0 - centre)}
+			double p_re[MaxBins], p_im[MaxBins];
+			for (size_t k = 0; k < n_bins; ++k) {
+				const double ang = w_step[k] * ((double)n0 - centre);
+				p_re[k] = std::cos(ang);
+				p_im[k] = -std::sin(ang);
+			}
+			// per-block partial sums keep the double accumulation as accurate as the old long double one
+			double acc_re[MaxChannels][MaxBins] = {}, acc_im[MaxChannels][MaxBins] = {};
+			for (size_t n = n0; n < n1; ++n) {
+				for (size_t c = 0; c < n_channels; ++c) {
+					const double wx = w[n] * ((*channels[c])[n] - means[c]);
+					for (size_t k = 0; k < n_bins; ++k) {
+						acc_re[c][k] += wx * p_re[k];
+						acc_im[c][k] += wx * p_im[k];
+					}
+				}
+				for (size_t k = 0; k < n_bins; ++k) {
+					const double r = p_re[k] * rot_re[k] - p_im[k] * rot_im[k];
+					p_im[k] = p_re[k] * rot_im[k] + p_im[k] * rot_re[k];
+					p_re[k] = r;
+				}
+			}
+			for (size_t c = 0; c < n_channels; ++c)
+				for (size_t k = 0; k < n_bins; ++k) {
+					re_out[c][k] += acc_re[c][k];
+					im_out[c][k] += acc_im[c][k];
+				}
+		}
+	}
+};
+
+/// <summary>
+/// Computes every SignalMeasurements field for a (time, data) record in one go.
+/// Plain statistics come from a single fused pass over the raw samples; period, duty and
+/// edge times share a single pass over the TV-denoised signal. Scratch buffers are kept
+/// between calls so repeated measurements do not reallocate.
+/// </summary>
+class MeasurementEngine
+{
+public:
+	const SignalMeasurements& Measure(const std::vector<double>& time, const std::vector<double>& data)
+	{
+		m = SignalMeasurements{};
+		const size_t N = std::min(time.size(), data.size());
+		if (data.empty()) return m;
+
+		// ---- 1) Fused statistics pass (raw data, includes DC) ----
+		double vmax = data[0], vmin = data[0];
+		double sum = 0.0;
+		long double sum_sq = 0.0L;
+		for (double v : data) {
+			vmax = std::max(vmax, v);
+			vmin = std::min(vmin, v);
+			sum += v;
+			sum_sq += (long double)v * (long double)v;
+		}
+		m.vmax = vmax;
+		m.vmin = vmin;
+		m.vpp = vmax - vmin;
+		m.vavg = sum / (double)data.size();
+		m.vrms = std::sqrt((double)(sum_sq / (long double)data.size()));
+
+		// ---- 2) Timing measurements need a strictly increasing time base ----
+		if (N < 8) return m;
+		for (size_t i = 1; i < N; ++i)
+			if (!(time[i] > time[i - 1])) return m;
+
+		MeasureTiming(time, data, N);
+		MeasurePhase(time, data, N);
+		return m;
+	}
+
+	const SignalMeasurements& Last() const { return m; }
+
+	/// <summary>
+	/// Phase of `other` relative to the last measured record (other - ref, degrees). Both records
+	/// must share a time base; they are projected together at the reference's refined frequency.
+	/// </summary>
+	double RelativePhaseDeg(const std::vector<double>& time, const std::vector<double>& data,
+		const std::vector<double>& other, double other_mean)
+	{
+		if (!(std::isfinite(m.period) && m.period > 0.0) || !std::isfinite(other_mean)) return NaN();
+		if (data.size() != time.size() || other.size() != time.size()) return NaN();
+		const std::vector<double>* ch[2] = { &data, &other };
+		const double mean[2] = { m.vavg, other_mean };
+		double phase[2], f1 = NaN();
+		if (!phase_estimator.Estimate(time, ch, mean, 2, 1.0 / m.period, phase, f1)) return NaN();
+		return wrap_deg(phase[1] - phase[0]);
+	}
+
+private:
+	SignalMeasurements m;
+	std::vector<double> raw, residual, scratch, t_rise;
+	PhaseEstimator phase_estimator;
+
+	static inline double NaN() { return std::numeric_limits<double>::quiet_NaN(); }
+	static inline double wrap_deg(double a) {
+		if (!std::isfinite(a)) return a;
+		a = std::fmod(a + 180.0, 360.0);
+		if (a < 0) a += 360.0;
+		return a - 180.0;
+	}
+	static double median_inplace(std::vector<double>& v) {
+		if (v.empty()) return NaN();
+		size_t n = v.size() / 2;
+		std::nth_element(v.begin(), v.begin() + n, v.end());
+		double med = v[n];
+		if ((v.size() & 1) == 0) {
+			// even: lower neighbour is the max of the left partition
+			med = 0.5 * (med + *std::max_element(v.begin(), v.begin() + n));
+		}
+		return med;
+	}
+	static inline double lerp_time(const std::vector<double>& time, size_t i, double x0, double x1, double level) {
+		const double alpha = (level - x0) / (x1 - x0);
+		return time[i - 1] + alpha * (time[i] - time[i - 1]);
+	}
+
+	// Period (mid-level crossings + OLS), duty cycle and 10-90% edge times, all from the denoised signal.
+	void MeasureTiming(const std::vector<double>& time, const std::vector<double>& data, size_t N)
+	{
+		// ---- DENOISE ----
+		raw.assign(data.begin(), data.begin() + N);
+		const double lambda = 0.1; // 0.05-0.3 is a common sweet spot
+		const std::vector<double> x = tv_denoise(raw, lambda);
+		if (x.size() != N) return;
+
+		// ---- LEVELS FROM DENOISED + RESIDUAL NOISE (MAD) ----
+		residual.resize(N);
+		double vmin = x[0], vmax = x[0];
+		for (size_t i = 0; i < N; ++i) {
+			vmin = std::min(vmin, x[i]);
+			vmax = std::max(vmax, x[i]);
+			residual[i] = raw[i] - x[i];
+		}
+		if (!std::isfinite(vmin) || !std::isfinite(vmax)) return;
+		const double vpp = vmax - vmin;
+		if (!(vpp > 0.0)) return;
+		const double vmid = 0.5 * (vmax + vmin);
+		const double v10 = vmin + 0.1 * vpp;
+		const double v90 = vmin + 0.9 * vpp;
+
+		scratch = residual;
+		const double r_med = median_inplace(scratch);
+		for (size_t i = 0; i < N; ++i) scratch[i] = std::abs(residual[i] - r_med);
+		const double mad = median_inplace(scratch);
+		const double sigma = (std::isfinite(mad) ? 1.4826 * mad : 0.0);
+
+		// Hysteresis: larger of (3 sigma) and (5% Vpp), with a very small absolute floor.
+		const double h = std::max(std::max(3.0 * sigma, 0.05 * vpp), 1e-6);
+		const double lo = vmid - h;
+
+		// ---- SINGLE PASS: RISING MID CROSSINGS, HIGH TIME, EDGES ----
+		t_rise.clear();
+		bool armed = (x[0] <= lo); // start armed if we begin below lo
+		size_t i_first_rise = 0, i_last_rise = 0;
+		size_t high_samples = 0, high_at_first_rise = 0, high_at_last_rise = 0;
+
+		double t10_up = NaN(), t90_down = NaN();
+		bool rise_armed = (x[0] <= v10), fall_armed = (x[0] >= v90);
+		double rise_sum = 0.0, fall_sum = 0.0;
+		int rise_count = 0, fall_count = 0;
+
+		for (size_t i = 1; i < N; ++i) {
+			const double x0 = x[i - 1];
+			const double x1 = x[i];
+
+			if (x1 > vmid) ++high_samples;
+
+			if (armed) {
+				if (x0 <= vmid && x1 > vmid) {
+					const double dx = x1 - x0;
+					// shallow-edge guard: require slope big enough in volts/sample
+					if (dx > 1e-4 * vpp) {
+						const double t = lerp_time(time, i, x0, x1, vmid);
+						if (std::isfinite(t)) {
+							if (t_rise.empty()) { i_first_rise = i; high_at_first_rise = high_samples; }
+							t_rise.push_back(t);
+							i_last_rise = i;
+							high_at_last_rise = high_samples;
+						}
+					}
+					armed = false; // disarm until we drop below lo again
+				}
+			}
+			else if (x1 < lo) armed = true; // re-arm when safely below lo
+
+			// 10-90% rise: remember the latest 10% up-crossing, complete at the 90% up-crossing
+			if (x1 <= v10) rise_armed = true;
+			if (rise_armed && x0 < v10 && x1 >= v10) t10_up = lerp_time(time, i, x0, x1, v10);
+			if (rise_armed && x0 < v90 && x1 >= v90 && std::isfinite(t10_up)) {
+				rise_sum += lerp_time(time, i, x0, x1, v90) - t10_up;
+				++rise_count;
+				rise_armed = false;
+				t10_up = NaN();
+			}
+			// 90-10% fall: latest 90% down-crossing, complete at the 10% down-crossing
+			if (x1 >= v90) fall_armed = true;
+			if (fall_armed && x0 > v90 && x1 <= v90) t90_down = lerp_time(time, i, x0, x1, v90);
+			if (fall_armed && x0 > v10 && x1 <= v10 && std::isfinite(t90_down)) {
+				fall_sum += lerp_time(time, i, x0, x1, v10) - t90_down;
+				++fall_count;
+				fall_armed = false;
+				t90_down = NaN();
+			}
+		}
+		if (rise_count > 0) m.rise_time = rise_sum / rise_count;
+		if (fall_count > 0) m.fall_time = fall_sum / fall_count;
+
+		// ---- PERIOD FROM CROSSINGS (CENTERED OLS; FALLBACK FOR 2) ----
+		const size_t M = t_rise.size();
+		if (M < 2) return;
+
+		double T = NaN();
+		if (M == 2) {
+			T = t_rise[1] - t_rise[0];
+		}
+		else {
+			// Centered least-squares slope of t_k ~ t0 + k*T, k = 0..M-1
+			const long double Mld = (long double)M;
+			const long double mean_k = (Mld - 1.0L) * 0.5L;
+			long double mean_t = 0.0L;
+			for (size_t k = 0; k < M; ++k) mean_t += (long double)t_rise[k];
+			mean_t /= Mld;
+			long double cov_kt = 0.0L, var_k = 0.0L;
+			for (size_t k = 0; k < M; ++k) {
+				const long double kc = (long double)k - mean_k;
+				const long double tc = (long double)t_rise[k] - mean_t;
+				cov_kt += kc * tc;
+				var_k += kc * kc;
+			}
+			if (var_k == 0.0L) return;
+			T = (double)(cov_kt / var_k);
+		}
+		if (!(std::isfinite(T) && T > 0.0)) return;
+		m.period = T;
+		m.frequency = 1.0 / T;
+
+		// Duty over the whole periods between the first and last rising crossing
+		if (i_last_rise > i_first_rise) {
+			const double span = (double)(i_last_rise - i_first_rise);
+			m.duty = std::clamp((double)(high_at_last_rise - high_at_first_rise) / span, 0.0, 1.0);
+		}
+	}
+
+	// Absolute phase at f ~ 1/T (referenced to the window centre), with a 3-point parabolic
+	// refinement of the frequency on |S(f)|.
+	void MeasurePhase(const std::vector<double>& time, const std::vector<double>& data, size_t N)
+	{
+		if (!(std::isfinite(m.period) && m.period > 0.0) || !std::isfinite(m.vavg)) return;
+		if (time.size() != N || data.size() != N) return;
+		const std::vector<double>* ch[1] = { &data };
+		const double mean[1] = { m.vavg };
+		double phase[1], f1 = NaN();
+		if (!phase_estimator.Estimate(time, ch, mean, 1, 1.0 / m.period, phase, f1)) return;
+		m.phase_freq = f1;
+		m.phase_deg = wrap_deg(phase[0]);
+	}
+};
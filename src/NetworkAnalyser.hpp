@@ -7,11 +7,19 @@
 #include <algorithm>  // std::min, std::max, std::clamp
 #include <cstdint>
 #include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
 #include <limits>
 #include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <complex>
 
 #include "librador.h"
 #include "implot.h"
+#include "LibradorRead.hpp"
+#include "FFTPlanCache.hpp"
 
 class NetworkAnalyser {
 public:
@@ -28,13 +36,42 @@ public:
         int    settle_cycles = 1;
         int    dwell_cycles = 4;
 
+        // Broadband mode: a multisine in the generator's 512-sample table measures every point of
+        // a band from one capture instead of one tone per point (see plan_bands_)
+        bool   broadband = false;
+        int    multisine_periods = 4;        // periods averaged per band; coherence needs >= 2
+        int    multisine_max_harmonic = 200; // highest table harmonic, sets the span of a band
+
+        // Adaptive refinement: after the sweep, single tones are added between points the grid
+        // resolves poorly, until none is left or the sweep has adaptive_max_points in total
+        bool   adaptive = false;
+        int    adaptive_max_points = 300;
+        double adaptive_tol_dB = 0.5;    // allowed miss of a point by its neighbours' line
+        double adaptive_tol_rad = 0.05;
+
+        // Averaging: a stepped point's record is split into captures of dwell_cycles each, whose
+        // lock-in results are averaged as complex spectra. A point takes avg_captures_min, then
+        // doubles the count up to avg_captures_max until their coherence puts the random error
+        // of |H| below avg_rel_error, so only noisy points pay for more.
+        int    avg_captures_min = 2;
+        int    avg_captures_max = 8;
+        double avg_rel_error = 0.01;
+
+        // Re-measure: a stepped point still under coherence_min, typically hit by a disturbance
+        // rather than steady noise, is measured afresh with its captures discarded, up to
+        // remeasure_attempts times, while the sweep has remeasure_budget left. Multisine points
+        // under it are measured again by stepped tones from the same budget.
+        int    remeasure_attempts = 2;
+        int    remeasure_budget = 20;
+
         // Optional IFBW ? limits; OFF by default
         bool   use_ifbw_limits = false;
         double dwell_tau_mult = 4.0;
         double settle_tau_mult = 3.0;
 
-        // UI / frame loop period (ETA one-frame minimum at WaitSettle)
-        double ui_frame_period_s = 0.020; // ~20 ms typical
+        // Sweep thread timing, added to settle + dwell at every point
+        double gen_command_s = 0.003;     // generator command overhead after a tone change
+        double capture_latency_s = 0.033; // samples still in flight: one 33-packet USB transfer
 
         // Sampling policy
         bool   auto_sample_rate = true;
@@ -66,10 +103,22 @@ public:
         // Coherence gate
         double coherence_min = 0.65;
 
+        // Divide every point by the through calibration, if one is loaded
+        bool   apply_calibration = true;
+
         // Display / safety
         double mag_floor_dB = -100.0;
     };
 
+    // Through calibration: H(f) of the setup (cables, probes, front end) with the network
+    // replaced by a through connection, as measured by a sweep. Sweeps divide each point by it,
+    // interpolated onto their own frequencies.
+    struct Calibration {
+        std::vector<double> f;                 // Hz, ascending
+        std::vector<std::complex<double>> H;
+        bool empty() const { return f.empty(); }
+    };
+
     // ===== ETA & Button Label (matches runtime) =====
     std::string AcquireButtonLabelFromUI(const Config& ui_cfg, const char* base = "Acquire") const {
         char eta[32];
@@ -79,10 +128,11 @@ public:
         return std::string(buf);
     }
 
-    // ETA: per point waits settle+dwell, with a ONE-FRAME minimum at WaitSettle.
+    // ETA: the sweep thread's wait per point, generator command + settle + dwell + USB latency,
+    // with the fewest captures; extra captures and re-measures come on top.
     double EstimateSweepSeconds_UI(const Config& c) const {
         if (c.points <= 0) return 0.0;
-        const double dt = std::max(1e-6, c.ui_frame_period_s);
+        const double overhead = c.gen_command_s + c.capture_latency_s;
 
         auto settle_term = [&](double f) {
             const double by_cycles = std::max(1, c.settle_cycles) / f;
@@ -95,9 +145,10 @@ public:
         };
         auto dwell_term = [&](double f) {
             const double by_cycles = std::max(1, c.dwell_cycles) / f;
-            if (!c.use_ifbw_limits) return by_cycles;
+            const double captures = std::max(1, c.avg_captures_min);
+            if (!c.use_ifbw_limits) return captures * by_cycles;
             const double tau = 1.0 / (2.0 * M_PI * c.IFBW_Hz);
-            return std::max(by_cycles, c.dwell_tau_mult * tau);
+            return captures * std::max(by_cycles, c.dwell_tau_mult * tau);
         };
 
         double total = 0.0;
@@ -105,67 +156,151 @@ public:
             const double n_1 = (double)std::max(1, c.points - 1);
             const double r = std::pow(c.f_stop / c.f_start, 1.0 / n_1);
             double f = c.f_start;
-            for (int i = 0; i < c.points; ++i, f *= r) {
-                const double t_wait_cont = settle_term(f) + dwell_term(f);
-                total += std::max(dt, t_wait_cont);
-            }
+            for (int i = 0; i < c.points; ++i, f *= r)
+                total += overhead + settle_term(f) + dwell_term(f);
         }
         else {
             const double n_1 = (double)std::max(1, c.points - 1);
             const double df = (c.f_stop - c.f_start) / n_1;
             for (int i = 0; i < c.points; ++i) {
                 const double f = c.f_start + i * df;
-                const double t_wait_cont = settle_term(f) + dwell_term(f);
-                total += std::max(dt, t_wait_cont);
+                total += overhead + settle_term(f) + dwell_term(f);
             }
         }
-		total += 4.0+4*total/30; // estimated overhead
-        return total;
+        // refinement points are single tones: budget them at the grid's average
+        const double extra = c.adaptive ? std::max(0, c.adaptive_max_points - c.points) * total / c.points : 0.0;
+        if (c.broadband) {
+            std::vector<double> f = sweep_grid_(c.f_start, c.f_stop, c.points, c.log_spacing);
+            const int periods = std::max(2, c.multisine_periods);
+            total = 0.0;
+            for (const Band& b : plan_bands_(c, f))
+                total += overhead + settle_term(b.f_low) + periods / b.f0;
+        }
+        return total + extra;
     }
 
-    // Readonly for plotting
-    std::vector<double> freqs() const {
-        const int n = std::clamp(idx_ + (state_ == State::Done ? 0 : 0), 0, (int)freqs_.size());
-        return std::vector<double>(freqs_.begin(), freqs_.begin() + n);
-    }
+    // Smallest and largest value of a result, skipping points that failed the coherence gate.
+    struct Extent {
+        double min = std::numeric_limits<double>::infinity();
+        double max = -std::numeric_limits<double>::infinity();
+        bool empty() const { return !(min <= max); }
+        void add(double v) { if (!std::isnan(v)) { min = std::min(min, v); max = std::max(max, v); } }
+    };
 
-    std::vector<double> mag_linear() const {
-        const int n = std::clamp(idx_, 0, (int)mag_.size());
-        return std::vector<double>(mag_.begin(), mag_.begin() + n);
-    }
+    // Readonly for plotting, sorted by frequency; UI thread only. The sweep thread appends
+    // points in measurement order to arrays sized before it starts, writing point i before it
+    // publishes i + 1 points; each call folds the newly published ones into the sorted arrays,
+    // which hold only measured points. The references stay valid, but the next call may move
+    // the data.
+    const std::vector<double>& freqs() const { sync_(); return freqs_; }
+    const std::vector<double>& mag_linear() const { sync_(); return mag_; }
+    const std::vector<double>& mag_dB() const { sync_(); return mag_dB_; }
+    const std::vector<double>& phase_rad() const { sync_(); return ph_; }
+    Extent mag_linear_extent() const { sync_(); return mag_extent_; }
+    Extent mag_dB_extent() const { sync_(); return mag_dB_extent_; }
+    Extent phase_extent() const { sync_(); return ph_extent_; }
+
+    // Changes whenever the results do (points arrive, or a new sweep clears them), so readers
+    // can keep whatever they derived from them until it moves.
+    uint64_t generation() const { sync_(); return generation_; }
+
+    bool done() const { return !running(); }
+    bool running() const { return running_.load(std::memory_order_acquire); }
+    int  current_index() const { return published_.load(std::memory_order_acquire); }
 
-    std::vector<double> mag_dB() const {
-        const int n = std::clamp(idx_, 0, (int)mag_dB_.size());
-        return std::vector<double>(mag_dB_.begin(), mag_dB_.begin() + n);
-    }
+    const Config& CurrentConfig() const { return cfg_; }
 
-    std::vector<double> phase_rad() const {
-        const int n = std::clamp(idx_, 0, (int)ph_.size());
-        return std::vector<double>(ph_.begin(), ph_.begin() + n);
+    // ===== Calibration (UI thread; a sweep uses the one loaded when it started) =====
+    const Calibration& CurrentCalibration() const { return cal_; }
+    void ClearCalibration() { cal_ = Calibration{}; }
+
+    // Takes the last sweep, which must have finished, as the through calibration: every point
+    // that passed the coherence gate, with the calibration that sweep applied taken back out.
+    // False (and the calibration unchanged) with fewer than two such points.
+    bool StoreCalibration() {
+        if (running()) return false;
+        sync_();
+        Calibration c;
+        for (size_t i = 0; i < freqs_.size(); ++i) {
+            if (std::isnan(mag_dB_[i]) || (!c.f.empty() && !(freqs_[i] > c.f.back()))) continue;
+            c.f.push_back(freqs_[i]);
+            c.H.push_back(std::polar(mag_[i], ph_[i]) * cal_at_(freqs_[i]));
+        }
+        if (c.f.size() < 2) return false;
+        cal_ = std::move(c);
+        return true;
     }
 
-
-    bool done() const { return state_ == State::Done || state_ == State::Idle; }
-    bool running() const {
-        return state_ == State::SetTone || state_ == State::WaitSettle ||
-            state_ == State::Capture || state_ == State::NextPoint;
+    // Binary calibration file: "LCAL", uint32 version, uint32 count, then count records of
+    // { double f, double re, double im }, all in host byte order.
+    bool SaveCalibration(const std::string& path) const {
+        if (cal_.empty()) return false;
+        std::ofstream file(path, std::ios::binary);
+        if (!file.is_open()) return false;
+        const uint32_t header[2] = { CalFileVersion, (uint32_t)cal_.f.size() };
+        file.write(CalFileMagic, 4);
+        file.write(reinterpret_cast<const char*>(header), sizeof(header));
+        for (size_t i = 0; i < cal_.f.size(); ++i) {
+            const double rec[3] = { cal_.f[i], cal_.H[i].real(), cal_.H[i].imag() };
+            file.write(reinterpret_cast<const char*>(rec), sizeof(rec));
+        }
+        return (bool)file;
+    }
+    // False, with the calibration unchanged, if the file is not a calibration this can read.
+    bool LoadCalibration(const std::string& path) {
+        std::ifstream file(path, std::ios::binary);
+        char magic[4];
+        uint32_t header[2];
+        if (!file.read(magic, 4) || std::memcmp(magic, CalFileMagic, 4) != 0) return false;
+        if (!file.read(reinterpret_cast<char*>(header), sizeof(header))) return false;
+        if (header[0] != CalFileVersion || header[1] < 2 || header[1] > (1u << 20)) return false;
+        Calibration c;
+        c.f.resize(header[1]);
+        c.H.resize(header[1]);
+        for (uint32_t i = 0; i < header[1]; ++i) {
+            double rec[3];
+            if (!file.read(reinterpret_cast<char*>(rec), sizeof(rec))) return false;
+            if (!(rec[0] > 0.0) || !std::isfinite(rec[0]) || (i > 0 && !(rec[0] > c.f[i - 1]))) return false;
+            c.f[i] = rec[0];
+            c.H[i] = { rec[1], rec[2] };
+        }
+        cal_ = std::move(c);
+        return true;
     }
-    int  current_index() const { return idx_; }
 
-    const Config& CurrentConfig() const { return cfg_; }
+    NetworkAnalyser() = default;
+    NetworkAnalyser(const NetworkAnalyser&) = delete;
+    NetworkAnalyser& operator=(const NetworkAnalyser&) = delete;
+    ~NetworkAnalyser() { Stop(); }
 
     // Lifecycle
     void Reset() {
+        Stop();
         freqs_.clear(); mag_.clear(); mag_dB_.clear(); ph_.clear();
+        meas_f_.clear(); meas_mag_.clear(); meas_mag_dB_.clear(); meas_ph_.clear();
         plan_.clear();
-        state_ = State::Idle; idx_ = -1;
+        published_.store(0, std::memory_order_release);
+        merged_ = 0;
+        mag_extent_ = mag_dB_extent_ = ph_extent_ = Extent{};
+        ++generation_;
         fs_adc_nominal_ = 0.0;
-        fs_eff_point_ = 0.0;
+    }
+
+    // Cancels a running sweep (waking it from its wait) and joins the thread. Points already
+    // measured stay published.
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex_);
+            stop_ = true;
+        }
+        wake_cv_.notify_all();
+        if (sweep_thread_.joinable()) sweep_thread_.join();
+        running_.store(false, std::memory_order_release);
     }
 
     void StartSweep(const Config& cfg) {
-        cfg_ = cfg;
         Reset();
+        cfg_ = cfg;
 
         // Sort & dedup amplitude breakpoints
         if (!cfg_.amp_points.empty()) {
@@ -184,158 +319,452 @@ public:
 
         make_sweep_(cfg_.f_start, cfg_.f_stop, cfg_.points, cfg_.log_spacing);
 
-        mag_.assign(plan_.size(), 0.0);
-        ph_.assign(plan_.size(), 0.0);
-        mag_dB_.assign(plan_.size(), 0.0);
-
-        idx_ = 0;
-        state_ = State::SetTone;
-    }
-
-    // ====== MULTI-ADVANCE TICK ======
-    void Tick() {
-        // Advance through as many non-waiting states as possible in this call.
-        // Only WaitSettle may cause us to return early (single-frame pause).
-        for (int steps = 0; steps < 16; ++steps) { // guard
-            if (state_ == State::Idle || state_ == State::Done)
-                return;
-
-            switch (state_) {
-            case State::SetTone: {
-                const auto& p = plan_[idx_];
-
-                const double a_eff = std::min(amp_for_freq_(p.f), cfg_.gen_amplitude_v);
-                librador_send_sin_wave(cfg_.gen_channel, p.f, a_eff, cfg_.gen_offset_v);
-                coarse_sleep_ms_(3); // generator command overhead
-
-                // Compute waits for this point
-                t_settle_s_ = settle_time_(p.f);
-                t_dwell_s_ = dwell_time_(p.f);
-                t_wait_total_s_ = t_settle_s_ + t_dwell_s_; // wait settle + dwell before capture
-
-                fs_eff_point_ = choose_sample_rate_(p.f, t_dwell_s_); // <<< present
-                t_wait_begin_ = Clock::now();
-                state_ = State::WaitSettle;
-            } continue;
-
-            case State::WaitSettle: {
-                const double elapsed = sec_since_(t_wait_begin_);
-                if (elapsed < t_wait_total_s_) {
-                    // Not yet: accept a single-frame delay. Return without advancing further.
-                    return;
-                }
-                // Time elapsed; advance this frame into Capture
-                state_ = State::Capture;
-            } continue;
-
-            case State::Capture: {
-                const auto& p = plan_[idx_];
-
-                // Single capture per point
-                auto* xin = librador_get_analog_data(cfg_.ch_input, t_dwell_s_, fs_eff_point_, 0.0, 0);
-                auto* yout = librador_get_analog_data(cfg_.ch_output, t_dwell_s_, fs_eff_point_, 0.0, 0);
-
-                if (!xin || !yout || xin->empty() || yout->empty() || xin->size() != yout->size()) {
-                    mag_[idx_] = std::numeric_limits<double>::quiet_NaN();
-                    mag_dB_[idx_] = std::numeric_limits<double>::quiet_NaN();
-                    ph_[idx_] = std::numeric_limits<double>::quiet_NaN();
-                    state_ = State::NextPoint;
-                    continue;
-                }
+        // room for the refinement points too: the arrays must not move once the thread runs
+        const size_t capacity = cfg_.adaptive
+            ? std::max(plan_.size(), (size_t)std::max(0, cfg_.adaptive_max_points)) : plan_.size();
+        meas_f_.assign(capacity, 0.0);
+        for (size_t i = 0; i < plan_.size(); ++i) meas_f_[i] = plan_[i].f;
+        meas_mag_.assign(capacity, 0.0);
+        meas_ph_.assign(capacity, 0.0);
+        meas_mag_dB_.assign(capacity, 0.0);
+        cfg_.points = (int)capacity;
+        remeasures_left_ = std::max(0, cfg_.remeasure_budget);
+        prepare_calibration_();
+
+        stop_ = false;
+        running_.store(true, std::memory_order_release);
+        sweep_thread_ = std::thread(&NetworkAnalyser::sweep_, this);
+    }
 
-                // Optional SG prefilter
-                if (cfg_.denoise_enable) {
-                    const double spc = fs_eff_point_ / std::max(1e-9, p.f);
-                    int win = (int)std::round(std::clamp(cfg_.denoise_frac_cycle * spc, 5.0, 21.0));
-                    if (win % 2 == 0) ++win;
-                    if (spc >= 10.0) {
-                        savgol_q2_filter_inplace_(*xin, win);
-                        savgol_q2_filter_inplace_(*yout, win);
-                    }
-                }
+private:
+    using Clock = std::chrono::steady_clock;
 
-                // Lock-in on single window
-                IQ X{}, Y{};
-                const double omega = 2.0 * M_PI * p.f / fs_eff_point_;
-                lockin_accumulate_demean_(*xin, omega, 0.0, X);
-                lockin_accumulate_demean_(*yout, omega, 0.0, Y);
-
-                const double N = (double)xin->size();
-                if (N > 0.0) {
-                    X.I /= N; X.Q /= N; Y.I /= N; Y.Q /= N;
-
-                    const double Xr = X.I, Xi = X.Q;
-                    const double Yr = Y.I, Yi = Y.Q;
-                    const double Sxx = (Xr * Xr + Xi * Xi);
-                    const double Syy = (Yr * Yr + Yi * Yi);
-                    const double Sxy_re = (Yr * Xr + Yi * Xi);
-                    const double Sxy_im = (Yi * Xr - Yr * Xi);
-
-                    const double eps = 1e-30;
-                    const double coh_num = Sxy_re * Sxy_re + Sxy_im * Sxy_im;
-                    const double coh_den = (Sxx * Syy) + eps;
-                    const double gamma2 = coh_num / coh_den;
-
-                    const double H_re = Sxy_re / (Sxx + eps);
-                    const double H_im = Sxy_im / (Sxx + eps);
-                    const double m = std::hypot(H_re, H_im);
-                    const double a = std::atan2(H_im, H_re);
-
-                    const double m_floor = std::pow(10.0, cfg_.mag_floor_dB / 20.0);
-                    const double m_safe = std::max(m, m_floor);
-                    const bool   bad = (!std::isfinite(gamma2)) || gamma2 < cfg_.coherence_min;
-
-                    mag_[idx_] = m;
-                    mag_dB_[idx_] = bad ? std::numeric_limits<double>::quiet_NaN()
-                        : 20.0 * std::log10(m_safe);
-                    ph_[idx_] = bad ? std::numeric_limits<double>::quiet_NaN() : a;
-                }
-                else {
-                    mag_[idx_] = std::numeric_limits<double>::quiet_NaN();
-                    mag_dB_[idx_] = std::numeric_limits<double>::quiet_NaN();
-                    ph_[idx_] = std::numeric_limits<double>::quiet_NaN();
-                }
+    struct PointPlan { double f; };
+    struct IQ { double I = 0.0, Q = 0.0; };
+    static constexpr int LockinBlock = 256; // samples smoothed at a time, kept in L1
+    static constexpr int LockinLanes = 4;   // interleaved oscillators, one per SIMD lane
+    friend struct NetworkAnalyserBench; // bench/network_lockin_bench times lockin_pair_
+
+    Config cfg_;
+
+    // One multisine capture of the broadband mode. Every point of the band is a harmonic of the
+    // table's repetition rate f0.
+    struct Band {
+        double f0 = 0.0;            // table repetition rate, as the generator timer will run it
+        double usecs = 0.0;         // table step handed to librador
+        double f_low = 0.0;         // lowest line, sets the settle time and amplitude
+        int    stride = 1;          // ADC samples per record sample
+        int    period_samples = 0;  // record samples per table period
+        int    first = 0;           // first point of plan_ in the band
+        int    count = 0;
+        std::vector<int> harmonics; // harmonic of f0 of each point
+    };
+
+    static constexpr int MultisineTableSize = 512;         // librador's generator buffer
+    static constexpr int MultisineMinPeriodSamples = 16384; // decimate no further than this
+    static constexpr double GenClockHz = 48000000.0;        // XMEGA clock behind the table timer
+    static constexpr double MinRefineGap = 1e-3;            // relative, narrowest gap refined
+    static constexpr char CalFileMagic[4] = { 'L', 'C', 'A', 'L' };
+    static constexpr uint32_t CalFileVersion = 1;
+
+    std::vector<PointPlan> plan_;
+    std::vector<Band> bands_;
+    std::vector<double> meas_f_, meas_mag_, meas_mag_dB_, meas_ph_; // measurement order
+    mutable std::vector<double> freqs_, mag_, mag_dB_, ph_;         // sorted, UI thread
+    mutable int merged_ = 0;                                         // points folded into them
+    mutable Extent mag_extent_, mag_dB_extent_, ph_extent_;
+    mutable uint64_t generation_ = 0;
+    std::vector<double> xin_, yout_; // sweep thread's copies of the captured records
+    std::vector<double> sg_weights_; // Savitzky-Golay taps for sg_window_, kept between points
+    int sg_window_ = 0;
+    int remeasures_left_ = 0;        // sweep thread's share of remeasure_budget
+
+    Calibration cal_;                      // UI thread's, what the next sweep uses
+    std::vector<double> cal_x_, cal_dB_, cal_ph_; // the running sweep's: log f, dB, unwrapped rad
+    SpectrumWorkspace workspace_;    // per-period transforms of the broadband mode
 
-                state_ = State::NextPoint;
-            } continue;
+    double fs_adc_nominal_ = 0.0;
 
-            case State::NextPoint: {
-                idx_++;
-                if (idx_ >= (int)plan_.size()) {
-                    state_ = State::Done;
-                    return;
+    std::thread sweep_thread_;
+    std::atomic<int>  published_{ 0 };
+    std::atomic<bool> running_{ false };
+    std::atomic<bool> stop_{ false };
+    std::mutex wake_mutex_;
+    std::condition_variable wake_cv_;
+
+    // ===== sweep thread =====
+    // Each point's capture is scheduled from the moment its tone command returns, so the record
+    // (the last t_dwell seconds that have reached the host) starts after the tone has settled.
+    void sweep_() {
+        bool completed = true;
+        if (cfg_.broadband) {
+            for (const Band& b : bands_) {
+                if (!(completed = measure_band_(b))) break;
+                for (int j = b.first; completed && j < b.first + b.count; ++j) {
+                    if (!std::isnan(meas_mag_dB_[j]) || remeasures_left_ <= 0) continue;
+                    --remeasures_left_;
+                    completed = measure_tone_(j, meas_f_[j]);
                 }
-                else {
-                    state_ = State::SetTone; // advance immediately this frame
+                if (!completed) break;
+                published_.store(b.first + b.count, std::memory_order_release);
+            }
+        }
+        else {
+            for (int i = 0; i < (int)plan_.size(); ++i) {
+                if (!(completed = measure_tone_(i, plan_[i].f))) break;
+                published_.store(i + 1, std::memory_order_release);
+            }
+        }
+        if (completed && cfg_.adaptive) refine_();
+        running_.store(false, std::memory_order_release);
+    }
+
+    // Sets the tone, waits for settle + dwell and measures point i at the frequency the generator
+    // really produces, which is the one recorded. A point that fails the coherence gate is
+    // measured again from fresh captures of the same tone while the re-measure budget allows.
+    // False if stopped meanwhile.
+    bool measure_tone_(int i, double f_request) {
+        const double f = sine_tone_freq_(f_request);
+        const double a_eff = std::min(amp_for_freq_(f), cfg_.gen_amplitude_v);
+        {
+            std::lock_guard<std::mutex> gen_lock(LibradorGeneratorMutex());
+            librador_send_sin_wave(cfg_.gen_channel, f_request, a_eff, cfg_.gen_offset_v);
+        }
+
+        const double t_settle = settle_time_(f);
+        const double t_dwell = dwell_time_(f);
+        const double fs_eff = choose_sample_rate_(f, t_dwell);
+        const double t_captures = std::max(1, cfg_.avg_captures_min) * t_dwell + cfg_.capture_latency_s;
+        double t_wait = cfg_.gen_command_s + t_settle + t_captures;
+        meas_f_[i] = f;
+        for (int attempt = 0; ; ++attempt) {
+            if (!wait_until_(Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(t_wait))))
+                return false;
+            if (!measure_point_(i, f, t_dwell, fs_eff)) return false;
+            if (!std::isnan(meas_mag_dB_[i]) || attempt >= cfg_.remeasure_attempts || remeasures_left_ <= 0)
+                return true;
+            --remeasures_left_;
+            t_wait = t_captures; // a record that starts after the last one ended
+        }
+    }
+
+    // Adaptive refinement, in rounds: every round measures the refine_targets_ of everything
+    // measured so far (lowest first, so the tone only steps up), until there are none or the
+    // arrays are full.
+    void refine_() {
+        int count = published_.load(std::memory_order_relaxed);
+        const int capacity = (int)meas_f_.size();
+        std::vector<int> order;
+        while (count < capacity) {
+            order.resize(count);
+            for (int i = 0; i < count; ++i) order[i] = i;
+            std::sort(order.begin(), order.end(), [this](int a, int b) { return meas_f_[a] < meas_f_[b]; });
+            const std::vector<double> targets = refine_targets_(order, capacity - count);
+            if (targets.empty()) return;
+            for (double f : targets) {
+                if (!measure_tone_(count, f)) return;
+                published_.store(++count, std::memory_order_release);
+            }
+        }
+    }
+
+    // New frequencies for a refinement round, at most `budget`: the midpoints (geometric for a
+    // log sweep) of the gaps either side of each point that misses the line through its two
+    // neighbours by more than adaptive_tol_dB or adaptive_tol_rad, or that failed the coherence
+    // gate next to one that passed (the edge of a dropout, not the inside of a stopband). The
+    // worst gaps go first. Gaps narrower than MinRefineGap of their frequency are left, as are
+    // those whose midpoint the generator can only produce at one of the gap's ends.
+    std::vector<double> refine_targets_(const std::vector<int>& order, int budget) const {
+        const int n = (int)order.size();
+        auto x = [&](int k) { const double f = meas_f_[order[k]]; return cfg_.log_spacing ? std::log(f) : f; };
+        auto bad = [&](int k) { return std::isnan(meas_mag_dB_[order[k]]); };
+
+        std::vector<double> err(n, 0.0);
+        for (int k = 0; k < n; ++k) {
+            if (bad(k)) {
+                if ((k > 0 && !bad(k - 1)) || (k + 1 < n && !bad(k + 1))) err[k] = 2.0;
+                continue;
+            }
+            if (k == 0 || k == n - 1 || bad(k - 1) || bad(k + 1)) continue;
+            const int a = order[k - 1], i = order[k], b = order[k + 1];
+            const double w = (x(k) - x(k - 1)) / std::max(1e-300, x(k + 1) - x(k - 1));
+            const double dm = meas_mag_dB_[i] - (meas_mag_dB_[a] + w * (meas_mag_dB_[b] - meas_mag_dB_[a]));
+            const double dp = std::remainder(meas_ph_[i] - (meas_ph_[a]
+                + w * std::remainder(meas_ph_[b] - meas_ph_[a], 2.0 * M_PI)), 2.0 * M_PI);
+            err[k] = std::max(std::abs(dm) / std::max(1e-9, cfg_.adaptive_tol_dB),
+                std::abs(dp) / std::max(1e-9, cfg_.adaptive_tol_rad));
+        }
+
+        std::vector<std::pair<double, double>> gaps; // score, new frequency
+        for (int k = 0; k + 1 < n; ++k) {
+            const double score = std::max(err[k], err[k + 1]);
+            const double fa = meas_f_[order[k]], fb = meas_f_[order[k + 1]];
+            if (score < 1.0 || fb - fa < MinRefineGap * fb) continue;
+            const double f = cfg_.log_spacing ? std::sqrt(fa * fb) : 0.5 * (fa + fb);
+            const double f_gen = sine_tone_freq_(f);
+            if (f_gen <= fa || f_gen >= fb) continue;
+            gaps.emplace_back(score, f);
+        }
+        std::sort(gaps.begin(), gaps.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+        if ((int)gaps.size() > budget) gaps.resize(std::max(0, budget));
+
+        std::vector<double> targets;
+        for (const auto& g : gaps) targets.push_back(g.second);
+        std::sort(targets.begin(), targets.end());
+        return targets;
+    }
+
+    // Sleeps until `deadline`, returning false if Stop() is called first. Timed waits can wake
+    // a scheduler tick late (~15 ms on Windows), so the last 2 ms are spent yielding instead.
+    bool wait_until_(Clock::time_point deadline) {
+        {
+            std::unique_lock<std::mutex> lock(wake_mutex_);
+            if (wake_cv_.wait_until(lock, deadline - std::chrono::milliseconds(2),
+                    [this] { return stop_.load(); }))
+                return false;
+        }
+        while (Clock::now() < deadline) {
+            if (stop_.load()) return false;
+            std::this_thread::yield();
+        }
+        return !stop_.load();
+    }
+
+    // Measures point i from the tone already playing, once avg_captures_min captures of t_dwell
+    // have reached the host. They are read as one record, the lock-in runs on each capture, and
+    // more are read (double the count each time, from a record that starts after the last one
+    // ended) until avg_rel_error or avg_captures_max is reached. librador hands out a shared
+    // buffer per channel, so the records are copied under LibradorReadMutex and processed after.
+    // False if stopped meanwhile.
+    bool measure_point_(int i, double f, double t_dwell, double fs_eff) {
+        const int k_min = std::max(1, cfg_.avg_captures_min);
+        const int k_max = std::max(k_min, cfg_.avg_captures_max);
+        const double omega = 2.0 * M_PI * f / fs_eff;
+
+        double Sxx = 0.0, Syy = 0.0;
+        std::complex<double> Sxy = 0.0;
+        int k = 0;
+        for (int batch = k_min; ; batch = std::min(k, k_max - k)) {
+            if (k > 0 && !wait_until_(Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                    std::chrono::duration<double>(batch * t_dwell + cfg_.capture_latency_s))))
+                return false;
+
+            const bool ok = capture_pair_(batch * t_dwell, fs_eff);
+            if (!ok || xin_.size() < (size_t)batch || xin_.size() != yout_.size()) {
+                store_failed_(i);
+                return true;
+            }
+            const int n = (int)(xin_.size() / batch);
+
+            // Optional SG prefilter, applied by the lock-in as it goes
+            int half = 0;
+            if (cfg_.denoise_enable) {
+                const double spc = fs_eff / std::max(1e-9, f);
+                int win = (int)std::round(std::clamp(cfg_.denoise_frac_cycle * spc, 5.0, 21.0));
+                if (win % 2 == 0) ++win;
+                if (spc >= 10.0 && n >= win) {
+                    if (sg_window_ != win) {
+                        sg_weights_.resize(win);
+                        gen_savgol_q2_weights_(win, sg_weights_.data());
+                        sg_window_ = win;
+                    }
+                    half = win / 2;
                 }
-            } continue;
+            }
 
-            default: return;
+            // Lock-in per capture, both channels in one pass
+            for (int j = 0; j < batch; ++j) {
+                IQ X{}, Y{};
+                lockin_pair_(xin_.data() + (size_t)j * n, yout_.data() + (size_t)j * n, n, omega,
+                    sg_weights_.data() + half, half, X, Y);
+                const std::complex<double> Xc(X.I, X.Q), Yc(Y.I, Y.Q);
+                Sxx += std::norm(Xc);
+                Syy += std::norm(Yc);
+                Sxy += Yc * std::conj(Xc);
             }
+            k += batch;
+            if (k >= k_max || h_rel_error_(Sxx, Syy, Sxy, k) <= cfg_.avg_rel_error) break;
         }
+        store_point_(i, Sxx / k, Syy / k, Sxy / (double)k, k);
+        return true;
     }
 
-private:
-    using Clock = std::chrono::steady_clock;
+    // Random error of |H| from k averaged captures with this coherence (Bendat & Piersol):
+    // sqrt(1 - g^2) / (|g| sqrt(2k)).
+    static double h_rel_error_(double Sxx, double Syy, std::complex<double> Sxy, int k) {
+        const double gamma2 = std::norm(Sxy) / (Sxx * Syy + 1e-30);
+        if (!(gamma2 > 0.0)) return std::numeric_limits<double>::infinity();
+        return std::sqrt(std::max(0.0, 1.0 - gamma2) / (2.0 * k * gamma2));
+    }
 
-    struct PointPlan { double f; };
-    struct IQ { double I = 0.0, Q = 0.0; };
+    // Copies the last window_s seconds of both channels into xin_ and yout_, newest first. They
+    // are two librador calls, and a USB transfer landing in between would shift one record
+    // against the other (a phase error), so the newest input samples are read again afterwards
+    // and the pair is retaken until nothing arrived in between. False if a read failed.
+    bool capture_pair_(double window_s, double fs) {
+        std::lock_guard<std::mutex> read_lock(LibradorReadMutex());
+        for (int attempt = 0; attempt < 4; ++attempt) {
+            auto* xin = librador_get_analog_data(cfg_.ch_input, window_s, fs, 0.0, 0);
+            if (!xin) return false;
+            xin_.assign(xin->begin(), xin->end());
+            auto* yout = librador_get_analog_data(cfg_.ch_output, window_s, fs, 0.0, 0);
+            if (!yout) return false;
+            yout_.assign(yout->begin(), yout->end());
+
+            const size_t k = std::min<size_t>(xin_.size(), 64);
+            auto* check = librador_get_analog_data(cfg_.ch_input, k / fs, fs, 0.0, 0);
+            if (!check) return false;
+            const size_t m = std::min(k, check->size());
+            if (std::equal(check->begin(), check->begin() + m, xin_.begin())) break;
+        }
+        return true;
+    }
 
-    enum class State { Idle, SetTone, WaitSettle, Capture, NextPoint, Done };
+    // Writes point i from the auto and cross spectra averaged over `captures`: H = Sxy / Sxx,
+    // with magnitude and phase blanked where the coherence is below coherence_min. The gate
+    // applies to the average, whose noise is `captures` times weaker than one capture's:
+    // k g^2 / (k g^2 + 1 - g^2), which is g^2 itself for one capture.
+    void store_point_(int i, double Sxx, double Syy, std::complex<double> Sxy, int captures) {
+        const double Sxy_re = Sxy.real();
+        const double Sxy_im = Sxy.imag();
+
+        const double eps = 1e-30;
+        const double coh_num = Sxy_re * Sxy_re + Sxy_im * Sxy_im;
+        const double coh_den = (Sxx * Syy) + eps;
+        const double gamma2 = coh_num / coh_den;
+        const double gamma2_mean = captures * gamma2 / (captures * gamma2 + std::max(0.0, 1.0 - gamma2) + eps);
+
+        const std::complex<double> H = std::complex<double>(Sxy_re, Sxy_im) / (Sxx + eps) / cal_at_(meas_f_[i]);
+        const double m = std::abs(H);
+        const double a = std::arg(H);
+
+        const double m_floor = std::pow(10.0, cfg_.mag_floor_dB / 20.0);
+        const double m_safe = std::max(m, m_floor);
+        const bool   bad = (!std::isfinite(gamma2_mean)) || gamma2_mean < cfg_.coherence_min;
+
+        meas_mag_[i] = m;
+        meas_mag_dB_[i] = bad ? std::numeric_limits<double>::quiet_NaN()
+            : 20.0 * std::log10(m_safe);
+        meas_ph_[i] = bad ? std::numeric_limits<double>::quiet_NaN() : a;
+    }
+    void store_failed_(int i) {
+        meas_mag_[i] = std::numeric_limits<double>::quiet_NaN();
+        meas_mag_dB_[i] = std::numeric_limits<double>::quiet_NaN();
+        meas_ph_[i] = std::numeric_limits<double>::quiet_NaN();
+    }
 
-    Config cfg_;
-    State  state_ = State::Idle;
+    // Measures every point of band b from one capture. The table repeats every period_samples
+    // record samples exactly, so each period is transformed on its own with no window and every
+    // line lands on its harmonic's bin; Sxx, Syy and Sxy are averaged over the periods. Returns
+    // false if the sweep was stopped during the wait.
+    bool measure_band_(const Band& b) {
+        unsigned char table[MultisineTableSize];
+        multisine_table_(b.harmonics, table);
+        const double a_eff = std::min(amp_for_freq_(b.f_low), cfg_.gen_amplitude_v);
+        {
+            std::lock_guard<std::mutex> gen_lock(LibradorGeneratorMutex());
+            librador_update_signal_gen_settings(cfg_.gen_channel, table, MultisineTableSize, b.usecs,
+                a_eff, cfg_.gen_offset_v);
+        }
 
-    std::vector<PointPlan> plan_;
-    std::vector<double> freqs_, mag_, mag_dB_, ph_;
+        const int periods = std::max(2, cfg_.multisine_periods);
+        const double t_wait = cfg_.gen_command_s + settle_time_(b.f_low) + periods / b.f0
+            + cfg_.capture_latency_s;
+        if (!wait_until_(Clock::now() + std::chrono::duration_cast<Clock::duration>(
+                std::chrono::duration<double>(t_wait))))
+            return false;
+
+        const size_t M = (size_t)b.period_samples;
+        const size_t n = (size_t)periods * M;
+        const bool ok = capture_pair_((double)n * b.stride / fs_adc_nominal_, fs_adc_nominal_ / b.stride);
+        if (!ok || xin_.size() != n || yout_.size() != n) {
+            for (int j = 0; j < b.count; ++j) store_failed_(b.first + j);
+            return true;
+        }
 
-    int    idx_ = -1;
+        // librador returns newest first; oldest first keeps the sign of the phase
+        std::reverse(xin_.begin(), xin_.end());
+        std::reverse(yout_.begin(), yout_.end());
+
+        std::vector<double> Sxx(b.count, 0.0), Syy(b.count, 0.0);
+        std::vector<std::complex<double>> Sxy(b.count), X(b.count);
+        workspace_.Prepare(M, SpectrumWorkspace::Rectangular);
+        for (int p = 0; p < periods; ++p) {
+            std::copy(xin_.begin() + p * M, xin_.begin() + (p + 1) * M, workspace_.In());
+            workspace_.Execute();
+            for (int j = 0; j < b.count; ++j) {
+                const fftw_complex& v = workspace_.Out()[b.harmonics[j]];
+                X[j] = std::complex<double>(v[0], v[1]);
+                Sxx[j] += std::norm(X[j]);
+            }
+            std::copy(yout_.begin() + p * M, yout_.begin() + (p + 1) * M, workspace_.In());
+            workspace_.Execute();
+            for (int j = 0; j < b.count; ++j) {
+                const fftw_complex& v = workspace_.Out()[b.harmonics[j]];
+                const std::complex<double> Y(v[0], v[1]);
+                Syy[j] += std::norm(Y);
+                Sxy[j] += Y * std::conj(X[j]);
+            }
+        }
+        for (int j = 0; j < b.count; ++j)
+            store_point_(b.first + j, Sxx[j], Syy[j], Sxy[j], periods);
+        return true;
+    }
 
-    double fs_adc_nominal_ = 0.0;
-    double fs_eff_point_ = 0.0;
+    void sync_() const {
+        const int n = published_.load(std::memory_order_acquire);
+        if (merged_ >= n) return;
+        if (merged_ == 0) {
+            freqs_.reserve(meas_f_.size()); mag_.reserve(meas_f_.size());
+            mag_dB_.reserve(meas_f_.size()); ph_.reserve(meas_f_.size());
+        }
+        ++generation_;
+        for (; merged_ < n; ++merged_) {
+            const double f = meas_f_[merged_];
+            // refinement points land between others, grid points (in order) at the end
+            const size_t at = std::upper_bound(freqs_.begin(), freqs_.end(), f) - freqs_.begin();
+            freqs_.insert(freqs_.begin() + at, f);
+            mag_.insert(mag_.begin() + at, meas_mag_[merged_]);
+            mag_dB_.insert(mag_dB_.begin() + at, meas_mag_dB_[merged_]);
+            ph_.insert(ph_.begin() + at, meas_ph_[merged_]);
+            mag_extent_.add(meas_mag_[merged_]);
+            mag_dB_extent_.add(meas_mag_dB_[merged_]);
+            ph_extent_.add(meas_ph_[merged_]);
+        }
+    }
 
-    double t_settle_s_ = 0.0, t_dwell_s_ = 0.0, t_wait_total_s_ = 0.0;
-    Clock::time_point t_wait_begin_{};
+    // Calibration as the sweep interpolates it: dB and unwrapped phase against log f, so a
+    // through with delay interpolates cleanly between points.
+    void prepare_calibration_() {
+        cal_x_.clear(); cal_dB_.clear(); cal_ph_.clear();
+        if (!cfg_.apply_calibration) return;
+        for (size_t i = 0; i < cal_.f.size(); ++i) {
+            const double m = std::abs(cal_.H[i]);
+            if (!(m > 0.0)) continue;
+            double ph = std::arg(cal_.H[i]);
+            if (!cal_ph_.empty()) ph = cal_ph_.back() + std::remainder(ph - cal_ph_.back(), 2.0 * M_PI);
+            cal_x_.push_back(std::log(cal_.f[i]));
+            cal_dB_.push_back(20.0 * std::log10(m));
+            cal_ph_.push_back(ph);
+        }
+    }
+    // The running (or last) sweep's calibration at f, held at its end values outside its span;
+    // 1 with none.
+    std::complex<double> cal_at_(double f) const {
+        if (cal_x_.empty()) return 1.0;
+        const double x = std::log(f);
+        const size_t j = std::upper_bound(cal_x_.begin(), cal_x_.end(), x) - cal_x_.begin();
+        double dB, ph;
+        if (j == 0) { dB = cal_dB_.front(); ph = cal_ph_.front(); }
+        else if (j == cal_x_.size()) { dB = cal_dB_.back(); ph = cal_ph_.back(); }
+        else {
+            const double w = (x - cal_x_[j - 1]) / (cal_x_[j] - cal_x_[j - 1]);
+            dB = cal_dB_[j - 1] + w * (cal_dB_[j] - cal_dB_[j - 1]);
+            ph = cal_ph_[j - 1] + w * (cal_ph_[j] - cal_ph_[j - 1]);
+        }
+        return std::polar(std::pow(10.0, dB / 20.0), ph);
+    }
 
     // ===== timing models (we use settle + dwell before capture) =====
     double dwell_time_(double f) const {
@@ -354,32 +783,144 @@ private:
     }
 
     // ===== hardware/flow helpers =====
-    static double sec_since_(Clock::time_point t0) {
-        using namespace std::chrono;
-        return duration<double>(Clock::now() - t0).count();
-    }
-    static void coarse_sleep_ms_(int ms) {
-        std::this_thread::sleep_for(std::chrono::milliseconds(ms));
-    }
     double get_device_fs_adc_() {
         return cfg_.fs_adc_hint;
     }
     void make_sweep_(double f0, double f1, int n, bool logsp) {
-        freqs_.resize(n);
-        plan_.resize(n);
+        std::vector<double> f = sweep_grid_(f0, f1, n, logsp);
+        bands_.clear();
+        if (cfg_.broadband) bands_ = plan_bands_(cfg_, f);
+        plan_.resize(f.size());
+        for (size_t i = 0; i < f.size(); ++i) plan_[i] = { f[i] };
+    }
+    static std::vector<double> sweep_grid_(double f0, double f1, int n, bool logsp) {
+        std::vector<double> f(n);
         if (logsp) {
             const double r = std::pow(f1 / f0, 1.0 / (n - 1));
-            double f = f0;
-            for (int i = 0; i < n; ++i, f *= r) { freqs_[i] = f; plan_[i] = { f }; }
+            double x = f0;
+            for (int i = 0; i < n; ++i, x *= r) f[i] = x;
         }
         else {
             const double df = (f1 - f0) / (n - 1);
+            for (int i = 0; i < n; ++i) f[i] = f0 + i * df;
+        }
+        return f;
+    }
+
+    // ===== broadband (multisine) planning =====
+    // Splits the sweep points f into bands that one table each can excite. A band starts at its
+    // lowest remaining point with f0 low enough that the next point is a different harmonic, and
+    // takes points until the harmonic passes multisine_max_harmonic; points are moved onto the
+    // harmonic nearest to them and those landing on the same one are merged, so f is rewritten
+    // with the frequencies actually measured. Low, closely spaced points need a low f0 and so a
+    // long period: the lowest band sets most of the sweep time.
+    static std::vector<Band> plan_bands_(const Config& c, std::vector<double>& f) {
+        std::sort(f.begin(), f.end());
+        const int k_max = std::clamp(c.multisine_max_harmonic, 2, MultisineTableSize / 2 - 1);
+        std::vector<Band> bands;
+        std::vector<double> lines;
+        lines.reserve(f.size());
+        size_t i = 0;
+        while (i < f.size()) {
+            Band b;
+            const double lo = f[i];
+            const double gap = (i + 1 < f.size()) ? f[i + 1] - lo : lo;
+            // also keeps the table step at librador's 1 us minimum
+            const double k_need = std::max(lo / std::max(gap, 1e-9), lo * MultisineTableSize * 1e-6);
+            const int k_lo = std::clamp((int)std::ceil(k_need - 1e-9), 1, k_max / 2);
+            const double step_ticks = table_timing_(lo / k_lo, b.usecs);
+            b.f0 = GenClockHz / (MultisineTableSize * step_ticks);
+
+            // coherent record: a whole number of ADC samples per period, decimated by a divisor
+            const long long m_full = std::llround(MultisineTableSize * step_ticks * c.fs_adc_hint / GenClockHz);
+            long long stride = std::max(1LL, m_full / MultisineMinPeriodSamples);
+            while (stride > 1 && m_full % stride != 0) --stride;
+            b.stride = (int)stride;
+            b.period_samples = (int)(m_full / stride);
+
+            b.first = (int)lines.size();
+            for (; i < f.size(); ++i) {
+                const int k = std::max(1, (int)std::lround(f[i] / b.f0));
+                if (k > k_max || 2 * k >= b.period_samples) break;
+                if (!b.harmonics.empty() && k == b.harmonics.back()) continue;
+                b.harmonics.push_back(k);
+                lines.push_back(k * b.f0);
+            }
+            if (b.harmonics.empty()) { ++i; continue; } // not measurable at any f0 allowed
+            b.count = (int)b.harmonics.size();
+            b.f_low = b.harmonics.front() * b.f0;
+            bands.push_back(std::move(b));
+        }
+        f.swap(lines);
+        return bands;
+    }
+
+    // Table step for a repetition rate near f0, in ticks of GenClockHz, with the step to pass to
+    // librador in usecs. librador programs the first clock divider whose period fits in 16 bits
+    // and truncates the period to whole ticks; the step is rounded to whole ticks here and given
+    // half a tick extra, so librador lands on exactly that many.
+    static double table_timing_(double f0, double& usecs) {
+        static const int dividers[7] = { 1, 2, 4, 8, 64, 256, 1024 };
+        const double target = 1e6 / (MultisineTableSize * f0);
+        int d = 0;
+        while (d < 6 && GenClockHz * target / (1e6 * dividers[d]) >= 65535.0) ++d;
+        const double period = std::clamp(std::round(GenClockHz * target / (1e6 * dividers[d])), 1.0, 65533.0);
+        usecs = (period + 0.5) * dividers[d] * 1e6 / GenClockHz;
+        return period * dividers[d];
+    }
+
+    // Frequency librador_send_sin_wave(f) really produces: it spreads one cycle over an even
+    // number of table samples (at most 512, at least 1 us apart) and the firmware truncates the
+    // step to whole timer ticks, so tones land up to a tick's worth (2 % at 5 kHz) below f.
+    static double sine_tone_freq_(double f) {
+        static const int dividers[7] = { 1, 2, 4, 8, 64, 256, 1024 };
+        const int n = 2 * ((int)std::min(1e6 / f, (double)MultisineTableSize) / 2);
+        if (n < 2) return f;
+        const double usecs = 1e6 / (n * f);
+        int d = 0;
+        while (d < 6 && GenClockHz * usecs / (1e6 * dividers[d]) >= 65535.0) ++d;
+        const double period = std::max(1.0, std::floor(GenClockHz * usecs / (1e6 * dividers[d])));
+        return GenClockHz / (n * period * dividers[d]);
+    }
+
+    // Fills the generator table with unit-amplitude lines at the given harmonics, phased for a
+    // low crest factor: Schroeder's phases, then rounds of clipping the peaks and taking the
+    // phases back from the clipped waveform. The flattest waveform found is scaled to 8 bits.
+    static void multisine_table_(const std::vector<int>& lines, unsigned char* table) {
+        const int N = MultisineTableSize;
+        const int n = (int)lines.size();
+        std::vector<double> cs(N), sn(N), x(N), best(N, 0.0), phase(n);
+        for (int t = 0; t < N; ++t) { cs[t] = std::cos(2.0 * M_PI * t / N); sn[t] = std::sin(2.0 * M_PI * t / N); }
+        for (int i = 0; i < n; ++i) phase[i] = -M_PI * i * (i + 1) / std::max(1, n);
+
+        double best_peak = std::numeric_limits<double>::infinity();
+        for (int round = 0; round < 100; ++round) {
+            std::fill(x.begin(), x.end(), 0.0);
+            for (int i = 0; i < n; ++i) {
+                const double c = std::cos(phase[i]), s = std::sin(phase[i]);
+                for (int t = 0, kt = 0; t < N; ++t, kt = (kt + lines[i]) % N)
+                    x[t] += c * cs[kt] - s * sn[kt];
+            }
+            double peak = 0.0;
+            for (double v : x) peak = std::max(peak, std::abs(v));
+            if (peak < best_peak) { best_peak = peak; best = x; }
+
+            const double clip = 0.7 * peak;
+            for (double& v : x) v = std::clamp(v, -clip, clip);
             for (int i = 0; i < n; ++i) {
-                const double f = f0 + i * df;
-                freqs_[i] = f; plan_[i] = { f };
+                double re = 0.0, im = 0.0;
+                for (int t = 0, kt = 0; t < N; ++t, kt = (kt + lines[i]) % N) {
+                    re += x[t] * cs[kt];
+                    im += x[t] * sn[kt];
+                }
+                phase[i] = std::atan2(-im, re);
             }
         }
+        const double scale = (best_peak > 0.0) ? 1.0 / best_peak : 0.0;
+        for (int t = 0; t < N; ++t)
+            table[t] = (unsigned char)std::lround(127.5 * (1.0 + best[t] * scale));
     }
+
     double choose_sample_rate_(double f, double dwell_s) const {
         if (!cfg_.auto_sample_rate)
             return std::clamp(fs_adc_nominal_, cfg_.fs_min, cfg_.fs_max);
@@ -410,52 +951,69 @@ private:
     }
 
     // Lock-in & filtering helpers
-    static void lockin_accumulate_demean_(const std::vector<double>& sig, double omega, double phi0, IQ& out) {
-        if (sig.empty()) return;
-
-        double mean = 0.0;
-        for (double v : sig) mean += v;
-        mean /= sig.size();
-
-        double c = std::cos(phi0), s = std::sin(phi0);
-        const double dc = std::cos(omega), ds = std::sin(omega);
-
-        double Scc = 0.0, Sss = 0.0;
-        for (double v : sig) {
-            const double x = v - mean;
-            out.I += x * c;
-            out.Q += x * s;
-            Scc += c * c;
-            Sss += s * s;
+    // Lock-in of the records x and y at omega (rad/sample), mean removed, in one pass over
+    // both. With half > 0 each record is first smoothed by the 2 * half + 1 tap symmetric
+    // filter whose centre tap w points at (its first and last half samples pass through); the
+    // smoothing is done a block at a time into stack buffers, so nothing is written back. The
+    // reference oscillator runs as LockinLanes interleaved recurrences, reseeded from cos/sin
+    // at every block so that its error does not grow with the record.
+    static void lockin_pair_(const double* x, const double* y, int N, double omega,
+        const double* w, int half, IQ& X, IQ& Y) {
+        constexpr int L = LockinLanes;
+        double sx[L] = {}, sy[L] = {}, xc[L] = {}, xs[L] = {}, yc[L] = {}, ys[L] = {};
+        double sc[L] = {}, ss[L] = {}, scc[L] = {}, sss[L] = {};
+        double c[L], s[L];
+        const double dc = std::cos(L * omega), ds = std::sin(L * omega);
+        alignas(32) double fx[LockinBlock], fy[LockinBlock];
+
+        for (int b0 = 0; b0 < N; b0 += LockinBlock) {
+            const int n = std::min(LockinBlock, N - b0);
+            const double* xb = x + b0;
+            const double* yb = y + b0;
+            if (half > 0) {
+                // smoothed outputs exist for [half, N - half); the rest pass through
+                const int lo = std::clamp(half - b0, 0, n), hi = std::clamp(N - half - b0, lo, n);
+                for (int t = 0; t < lo; ++t) { fx[t] = xb[t]; fy[t] = yb[t]; }
+                for (int t = lo; t < hi; ++t) { fx[t] = w[0] * xb[t]; fy[t] = w[0] * yb[t]; }
+                for (int k = 1; k <= half; ++k) {
+                    const double wk = w[k];
+                    for (int t = lo; t < hi; ++t) {
+                        fx[t] += wk * (xb[t - k] + xb[t + k]);
+                        fy[t] += wk * (yb[t - k] + yb[t + k]);
+                    }
+                }
+                for (int t = hi; t < n; ++t) { fx[t] = xb[t]; fy[t] = yb[t]; }
+                xb = fx; yb = fy;
+            }
 
-            const double c_next = c * dc - s * ds;
-            const double s_next = c * ds + s * dc;
-            c = c_next; s = s_next;
+            for (int j = 0; j < L; ++j) { c[j] = std::cos(omega * (b0 + j)); s[j] = std::sin(omega * (b0 + j)); }
+            auto step = [&](int j, double vx, double vy) {
+                sx[j] += vx; sy[j] += vy;
+                xc[j] += vx * c[j]; xs[j] += vx * s[j];
+                yc[j] += vy * c[j]; ys[j] += vy * s[j];
+                sc[j] += c[j]; ss[j] += s[j];
+                scc[j] += c[j] * c[j]; sss[j] += s[j] * s[j];
+                const double cn = c[j] * dc - s[j] * ds;
+                s[j] = c[j] * ds + s[j] * dc;
+                c[j] = cn;
+            };
+            int t = 0;
+            for (; t + L <= n; t += L)
+                for (int j = 0; j < L; ++j) step(j, xb[t + j], yb[t + j]);
+            for (int j = 0; t + j < n; ++j) step(j, xb[t + j], yb[t + j]);
         }
-        out.I /= (Scc + 1e-30);
-        out.Q /= (Sss + 1e-30);
-    }
-    static void savgol_q2_filter_inplace_(std::vector<double>& x, int window) {
-        if (window < 5) return;
-        if (window % 2 == 0) ++window;
-        const int N = (int)x.size();
-        if (N < window) return;
-
-        std::vector<double> w(window);
-        gen_savgol_q2_weights_(window, w.data());
 
-        std::vector<double> y(N);
-        const int half = window / 2;
-
-        for (int i = half; i < N - half; ++i) {
-            double s = 0.0;
-            for (int k = -half; k <= half; ++k) s += w[k + half] * x[i + k];
-            y[i] = s;
+        double Sx = 0, Sy = 0, Xc = 0, Xs = 0, Yc = 0, Ys = 0, Sc = 0, Ss = 0, Scc = 0, Sss = 0;
+        for (int j = 0; j < L; ++j) {
+            Sx += sx[j]; Sy += sy[j]; Xc += xc[j]; Xs += xs[j]; Yc += yc[j]; Ys += ys[j];
+            Sc += sc[j]; Ss += ss[j]; Scc += scc[j]; Sss += sss[j];
         }
-        for (int i = 0; i < half; ++i) y[i] = x[i];
-        for (int i = N - half; i < N; ++i) y[i] = x[i];
-
-        x.swap(y);
+        // sum (v - mean) * ref = sum v * ref - mean * sum ref
+        const double mx = Sx / N, my = Sy / N;
+        X.I += (Xc - mx * Sc) / (Scc + 1e-30);
+        X.Q += (Xs - mx * Ss) / (Sss + 1e-30);
+        Y.I += (Yc - my * Sc) / (Scc + 1e-30);
+        Y.Q += (Ys - my * Ss) / (Sss + 1e-30);
     }
     static void gen_savgol_q2_weights_(int window, double* w) {
         const int m = window / 2;
@@ -14,6 +14,7 @@
 #include <algorithm>
 #include "implot.h"
 #include "OscData.hpp"
+#include "Decimation.hpp"
 
 /// <summary>Oscilloscope Control Widget (Plot settings + Math Mode)</summary>
 class OSCControl : public ControlWidget
@@ -25,7 +26,7 @@ public:
 
     ExportRowState OSC1ExportState;
     ExportRowState OSC2ExportState;
-    ExportRowState MathExportState;
+    ExportRowState MathExportStates[constants::MATH_CHANNELS];
     float ExportPathComboWidth = 100.f;
     const char* ExportFileExtension = "csv"; // or use your existing FileExtension
 
@@ -37,6 +38,8 @@ public:
     bool  AutofitX = false;
     int   TriggerTypeComboCurrentItem = 0;
     bool  Trigger = true;
+    int   AcquireModeComboCurrentItem = 0;  // OscData::AcquireMode
+    int   AverageCountComboCurrentItem = 3; // 16 frames
 
     // Trigger level (SIValue control)
     SIValue TriggerLevel = SIValue("##trigger1_level", "Level",
@@ -57,9 +60,20 @@ public:
     bool Cursor1toggle = false;
     bool Cursor2toggle = false;
     bool SignalPropertiesToggle = false;
+    bool PersistenceToggle = false;
+    bool RollModeToggle = false;
+    int  DecimationComboCurrentItem = 0;
+    int  PersistenceDecayComboCurrentItem = 2;
     bool AutoTriggerHysteresisToggle = true;
     bool HysteresisDisplayOptionEnabled = false;
 
+    // ===== Segmented Memory =====
+    int   SegmentCount = 1000;
+    float SegmentPreMs = 0.5f;
+    float SegmentPostMs = 2.0f;
+    int   SegmentViewComboCurrentItem = 0; // 0 Off, 1 Selected, 2 Overlay
+    int   SegmentSelected = 0;
+
     // ===== Math Mode =====
     struct MathControls
     {
@@ -69,12 +83,20 @@ public:
         bool Parsable{ false };
     };
     MathControls MathControls1, MathControls2, MathControls3, MathControls4;
+    /// Controls of math channel `ch` (0-based), i.e. MathControls1..4
+    MathControls& GetMathControls(int ch)
+    {
+        MathControls* all[constants::MATH_CHANNELS] = { &MathControls1, &MathControls2, &MathControls3, &MathControls4 };
+        return *all[ch];
+    }
 
     // ===== Colours =====
     ImColor OSC1Colour = colourConvert(constants::OSC1_ACCENT);
     ImColor OSC2Colour = colourConvert(constants::OSC2_ACCENT);
     ImColor GenColour = colourConvert(constants::GEN_ACCENT);
-    ImColor MathColour = colourConvert(constants::MATH_ACCENT);
+    ImColor MathColours[constants::MATH_CHANNELS] = {
+        colourConvert(constants::MATH_ACCENT), colourConvert(constants::MATH2_ACCENT),
+        colourConvert(constants::MATH3_ACCENT), colourConvert(constants::MATH4_ACCENT) };
     ImColor Green = ImColor(float(20. / 255), float(143. / 255), 0.f, 1.f);
     ImColor Red = ImColor(float(143. / 255), 0.f, 0.f, 1.f);
 
@@ -129,6 +151,25 @@ public:
             ImGui::TableNextColumn(); ImGui::Text("Signal Properties");
             ImGui::TableNextColumn(); ToggleSwitch((label + "sig_prop_toggle").c_str(), &SignalPropertiesToggle, GenColour);
 
+            ImGui::TableNextColumn(); ImGui::Text("Roll Mode");
+            ImGui::TableNextColumn(); ToggleSwitch((label + "roll_toggle").c_str(), &RollModeToggle, GenColour);
+
+            ImGui::TableNextColumn(); ImGui::Text("Decimation");
+            ImGui::TableNextColumn(); ImGui::SetNextItemWidth(controlWidth);
+            ImGui::Combo("##Decimation", &DecimationComboCurrentItem,
+                DecimationComboList, IM_ARRAYSIZE(DecimationComboList));
+
+            ImGui::TableNextColumn(); ImGui::Text("Persistence");
+            ImGui::TableNextColumn(); ToggleSwitch((label + "persistence_toggle").c_str(), &PersistenceToggle, GenColour);
+
+            if (PersistenceToggle)
+            {
+                ImGui::TableNextColumn(); ImGui::Text("Decay");
+                ImGui::TableNextColumn(); ImGui::SetNextItemWidth(controlWidth);
+                ImGui::Combo("##Persistence Decay", &PersistenceDecayComboCurrentItem,
+                    PersistenceDecayComboList, IM_ARRAYSIZE(PersistenceDecayComboList));
+            }
+
             ImGui::EndTable();
         }
 
@@ -171,6 +212,30 @@ public:
             ImGui::TableNextColumn(); ImGui::Text("Auto Level");
             ImGui::TableNextColumn(); ToggleSwitch("##Auto1", &AutoTriggerLevel, GenColour);
 
+            // Acquisition mode (averaging / envelope across frames)
+            ImGui::TableNextColumn(); ImGui::Text("Acquire");
+            ImGui::TableNextColumn(); ImGui::SetNextItemWidth(controlWidth);
+            ImGui::Combo("##Acquire Mode", &AcquireModeComboCurrentItem,
+                AcquireModeComboList, IM_ARRAYSIZE(AcquireModeComboList));
+
+            if (GetAcquireMode() == OscData::AcquireMode::LinearAverage || GetAcquireMode() == OscData::AcquireMode::ExpAverage)
+            {
+                ImGui::TableNextColumn(); ImGui::Text("Frames");
+                ImGui::TableNextColumn(); ImGui::SetNextItemWidth(controlWidth);
+                ImGui::Combo("##Average Count", &AverageCountComboCurrentItem,
+                    AverageCountComboList, IM_ARRAYSIZE(AverageCountComboList));
+            }
+            else if (GetAcquireMode() == OscData::AcquireMode::Envelope)
+            {
+                ImGui::TableNextColumn();
+                ImGui::TableNextColumn();
+                if (WhiteOutlineButton("Reset##Envelope", ImVec2(controlWidth, 0)))
+                {
+                    OSC1Data->ResetAccumulation();
+                    OSC2Data->ResetAccumulation();
+                }
+            }
+
             // Optional hysteresis UI
             if (HysteresisDisplayOptionEnabled)
             {
@@ -207,39 +272,53 @@ public:
             ExportFileExtension,
             ExportPathComboWidth);
 
-        // Get MATH data
-        std::vector<double> tMath = MathData->GetTime();
-        std::vector<double> vMath = MathData->GetData();
-
-        DrawExportRow2Col("Math",
-            MathExportState,
-            tMath, vMath,
-            "Time", "Voltage",
-            ExportFileExtension,
-            ExportPathComboWidth);
+        // Get MATH data, for the channels in use
+        for (int ch = 0; ch < constants::MATH_CHANNELS; ++ch)
+        {
+            if (GetMathControls(ch).Text.empty()) continue;
+            std::vector<double> tMath = MathData[ch].GetTime();
+            std::vector<double> vMath = MathData[ch].GetData();
+            const std::string name = "Math" + std::to_string(ch + 1);
+
+            DrawExportRow2Col(name.c_str(),
+                MathExportStates[ch],
+                tMath, vMath,
+                "Time", "Voltage",
+                ExportFileExtension,
+                ExportPathComboWidth);
+        }
 
 
         // --- Math Mode  ---
         ImGui::SeparatorText("Math");
-        // ImGui::Text("Display");
-        // ImGui::SameLine();
-		ImGui::Text(" OFF");
-		ImGui::SameLine();
-        ToggleSwitch((label + "Math1_toggle").c_str(), &MathControls1.On, ImU32(MathColour));
-        ImGui::SameLine();
-		ImGui::Text("ON");
+        for (int ch = 0; ch < constants::MATH_CHANNELS; ++ch)
+        {
+            MathControls& math = GetMathControls(ch);
+            ImGui::PushID(ch);
+            ImGui::AlignTextToFramePadding();
+            ImGui::TextColored(MathColours[ch].Value, "math%d", ch + 1);
+            ImGui::SameLine();
+            ToggleSwitch((label + "Math_toggle").c_str(), &math.On, ImU32(MathColours[ch]));
+            ImGui::SameLine();
+            ImGui::SetNextItemWidth(ImGui::GetContentRegionAvail().x - ImGui::GetFontSize() * 2.0f);
+            MiniHLInput("Expression",
+                math.Text,
+                rules,
+                /*text*/ ImGui::GetColorU32(ImGuiCol_Text),
+                /*bg  */ ImGui::GetColorU32(ImGuiCol_FrameBg),
+                ch == 0 ? "eg. osc1 + osc2,  sin(2*pi*100*t)" : "eg. lpf(math1, 1000)"
+            );
+            renderMathStatus(math);
+            ImGui::PopID();
+        }
 
-        ImGui::Text("Expression");
-        ImGui::SameLine();
-        MiniHLInput("Expression",
-            MathControls1.Text,
-            rules,
-            /*text*/ ImGui::GetColorU32(ImGuiCol_Text),
-            /*bg  */ ImGui::GetColorU32(ImGuiCol_FrameBg),
-            "eg. osc1 + osc2,  sin(2*pi*100*t)"
-        );
-
-        if (!MathControls1.Parsable && MathControls1.Text.length() > 0)
+        renderSegmentedMemory(width);
+    }
+
+    /// Parse mark after a math expression, with the reason on hover when it failed
+    void renderMathStatus(const MathControls& math)
+    {
+        if (!math.Parsable && math.Text.length() > 0)
         {
             ImGui::SameLine();
             ImGui::TextColored(ImVec4(1, 0, 0, 1), u8"\u2717");
@@ -247,7 +326,7 @@ public:
             ImVec2 mx = ImGui::GetItemRectMax();
             float pad = 6.0f;
             mn.x -= pad; mn.y -= pad; mx.x += pad; mx.y += pad;
-            std::string error_tooltip = "Text not parsable!";
+            std::string error_tooltip = "Text not parsable, or it uses a math channel that is empty, not parsable or uses this one!";
             if (ImGui::IsMouseHoveringRect(mn, mx))
             {
                 ImGui::BeginTooltip();
@@ -257,15 +336,172 @@ public:
                 ImGui::EndTooltip();
             }
         }
-        else if (MathControls1.Text.length())
+        else if (math.Text.length())
         {
             ImGui::SameLine();
             ImGui::TextColored(ImVec4(0, 1, 0, 1), u8"\u2714");
         }
     }
 
+    /// Segmented memory view mode
+    int GetSegmentView() const { return SegmentViewComboCurrentItem; }
+    /// The channel segmented memory captures on (follows the trigger source)
+    OscData* GetSegmentSource() const
+    {
+        return (TriggerTypeComboCurrentItem < 2) ? OSC1Data : OSC2Data;
+    }
+    ImColor GetSegmentSourceColour() const
+    {
+        return (TriggerTypeComboCurrentItem < 2) ? OSC1Colour : OSC2Colour;
+    }
+
     bool controlLab() override { return false; }
 
+    /// Segmented memory: arm/stop, scrubbing, overlay and per-segment measurements
+    void renderSegmentedMemory(float width)
+    {
+        ImGui::SeparatorText("Segmented Memory");
+        SegmentedMemory& seg = GetSegmentSource()->GetSegments();
+        const float labWidth = 100.0f;
+        const float controlWidth = (width - 2 * labWidth) / 2;
+
+        if (ImGui::BeginTable("SegmentsTable", 4))
+        {
+            ImGui::TableSetupColumn("One", ImGuiTableColumnFlags_WidthFixed, labWidth);
+            ImGui::TableSetupColumn("Two", ImGuiTableColumnFlags_WidthFixed, controlWidth);
+            ImGui::TableSetupColumn("Three", ImGuiTableColumnFlags_WidthFixed, labWidth);
+            ImGui::TableSetupColumn("Four", ImGuiTableColumnFlags_WidthFixed, controlWidth);
+
+            ImGui::BeginDisabled(seg.IsArmed());
+            ImGui::TableNextColumn(); ImGui::Text("Segments");
+            ImGui::TableNextColumn(); ImGui::SetNextItemWidth(controlWidth);
+            if (ImGui::InputInt("##Segment Count", &SegmentCount, 100, 1000))
+                SegmentCount = std::clamp(SegmentCount, 1, 100000);
+
+            ImGui::TableNextColumn(); ImGui::Text("Pre (ms)");
+            ImGui::TableNextColumn(); ImGui::SetNextItemWidth(controlWidth);
+            ImGui::DragFloat("##Segment Pre", &SegmentPreMs, 0.05f, 0.0f, 50.0f, "%.2f", ImGuiSliderFlags_AlwaysClamp);
+
+            ImGui::TableNextColumn(); ImGui::Text("Post (ms)");
+            ImGui::TableNextColumn(); ImGui::SetNextItemWidth(controlWidth);
+            ImGui::DragFloat("##Segment Post", &SegmentPostMs, 0.05f, 0.01f, 100.0f, "%.2f", ImGuiSliderFlags_AlwaysClamp);
+            ImGui::EndDisabled();
+
+            ImGui::TableNextColumn();
+            ImGui::BeginDisabled(seg.IsMeasuring());
+            if (!seg.IsArmed())
+            {
+                if (WhiteOutlineButton("Arm##Segments", ImVec2(labWidth - 10, 0)))
+                    ArmSegments(seg);
+            }
+            else if (WhiteOutlineButton("Stop##Segments", ImVec2(labWidth - 10, 0)))
+            {
+                seg.Stop();
+            }
+            ImGui::EndDisabled();
+            ImGui::TableNextColumn();
+            ImGui::Text("%zu / %zu%s", seg.Count(), seg.Capacity(), seg.IsArmed() ? " (armed)" : "");
+
+            ImGui::TableNextColumn(); ImGui::Text("View");
+            ImGui::TableNextColumn(); ImGui::SetNextItemWidth(controlWidth);
+            ImGui::Combo("##Segment View", &SegmentViewComboCurrentItem,
+                SegmentViewComboList, IM_ARRAYSIZE(SegmentViewComboList));
+
+            const int count = (int)seg.Count();
+            SegmentSelected = std::clamp(SegmentSelected, 0, std::max(count - 1, 0));
+            ImGui::TableNextColumn(); ImGui::Text("Segment");
+            ImGui::TableNextColumn(); ImGui::SetNextItemWidth(controlWidth);
+            ImGui::BeginDisabled(count == 0);
+            ImGui::SliderInt("##Segment Selected", &SegmentSelected, 0, std::max(count - 1, 0));
+            ImGui::EndDisabled();
+
+            ImGui::EndTable();
+        }
+        if (seg.Count() == 0)
+            return;
+
+        const SegmentedMemory::Segment& info = seg.Info(SegmentSelected);
+        ImGui::Text("Trigger at %.6f s after arming", info.time_s);
+
+        // per-segment measurements
+        ImGui::BeginDisabled(seg.IsMeasuring());
+        if (WhiteOutlineButton("Measure All##Segments", ImVec2(labWidth + 20, 0)))
+            seg.StartMeasureAll();
+        ImGui::EndDisabled();
+        ImGui::SameLine();
+        if (seg.IsMeasuring())
+        {
+            ImGui::ProgressBar(seg.MeasureProgress(), ImVec2(controlWidth, 0));
+            return;
+        }
+        const size_t measured = seg.MeasuredCount();
+        if (measured == 0)
+            return;
+        ImGui::Text("%zu measured", measured);
+
+        struct Stat { double lo = DBL_MAX, hi = -DBL_MAX, sum = 0; size_t n = 0; };
+        Stat freq, vpp, duty;
+        auto add = [](Stat& st, double v) { if (std::isfinite(v)) { st.lo = std::min(st.lo, v); st.hi = std::max(st.hi, v); st.sum += v; st.n++; } };
+        for (size_t i = 0; i < measured; ++i)
+        {
+            const SignalMeasurements& m = seg.Measurement(i);
+            add(freq, m.frequency);
+            add(vpp, m.vpp);
+            add(duty, 100.0 * m.duty);
+        }
+        if (ImGui::BeginTable("SegmentStats", 5, ImGuiTableFlags_Borders | ImGuiTableFlags_SizingFixedFit))
+        {
+            ImGui::TableSetupColumn("");
+            ImGui::TableSetupColumn("Selected");
+            ImGui::TableSetupColumn("Min");
+            ImGui::TableSetupColumn("Mean");
+            ImGui::TableSetupColumn("Max");
+            ImGui::TableHeadersRow();
+            const bool have_sel = (size_t)SegmentSelected < measured;
+            const SignalMeasurements sel = have_sel ? seg.Measurement(SegmentSelected) : SignalMeasurements{};
+            auto row = [](const char* name, double selected, const Stat& st)
+            {
+                ImGui::TableNextColumn(); ImGui::TextUnformatted(name);
+                ImGui::TableNextColumn();
+                if (std::isfinite(selected)) ImGui::Text("%.4g", selected);
+                else ImGui::TextUnformatted("-");
+                if (st.n == 0)
+                {
+                    for (int c = 0; c < 3; ++c) { ImGui::TableNextColumn(); ImGui::TextUnformatted("-"); }
+                    return;
+                }
+                ImGui::TableNextColumn(); ImGui::Text("%.4g", st.lo);
+                ImGui::TableNextColumn(); ImGui::Text("%.4g", st.sum / st.n);
+                ImGui::TableNextColumn(); ImGui::Text("%.4g", st.hi);
+            };
+            row("Freq (Hz)", sel.frequency, freq);
+            row("Vpp (V)", sel.vpp, vpp);
+            row("Duty (%)", 100.0 * sel.duty, duty);
+            ImGui::EndTable();
+        }
+    }
+
+    OscData::AcquireMode GetAcquireMode() const
+    {
+        return (OscData::AcquireMode)AcquireModeComboCurrentItem;
+    }
+    /// Number of frames averaged in the averaging acquire modes
+    int GetAverageCount() const
+    {
+        return 1 << (AverageCountComboCurrentItem + 1);
+    }
+
+    DecimationMethod GetDecimationMethod() const
+    {
+        return (DecimationMethod)DecimationComboCurrentItem;
+    }
+
+    /// Persistence decay time constant in seconds, 0 for infinite persistence
+    double GetPersistenceDecaySeconds() const
+    {
+        return PersistenceDecaySeconds[PersistenceDecayComboCurrentItem];
+    }
+
 
 private:
     const std::string label;
@@ -277,6 +513,48 @@ private:
         "OSC2 Rising Edge", "OSC2 Falling Edge"
     };
 
+    // Acquire mode list (order matches OscData::AcquireMode)
+    const char* AcquireModeComboList[4] = {
+        "Normal", "Average", "Exp. Average", "Envelope"
+    };
+    const char* AverageCountComboList[8] = {
+        "2", "4", "8", "16", "32", "64", "128", "256"
+    };
+
+    const char* SegmentViewComboList[3] = {
+        "Off", "Selected", "Overlay"
+    };
+
+    // Arms segmented memory on the trigger source with the current trigger settings
+    void ArmSegments(SegmentedMemory& seg)
+    {
+        SegmentedMemory::Config cfg;
+        const double fs = cfg.sample_rate;
+        cfg.pre_samples = (int)std::lround(SegmentPreMs * 1e-3 * fs);
+        cfg.post_samples = std::max(1, (int)std::lround(SegmentPostMs * 1e-3 * fs));
+        // keep the arena to 128 M samples (256 MB)
+        const size_t seg_len = (size_t)cfg.pre_samples + cfg.post_samples;
+        const size_t max_segments = std::max<size_t>(1, (size_t(1) << 27) / seg_len);
+        cfg.segments = (int)std::min<size_t>((size_t)SegmentCount, max_segments);
+        cfg.rising = (TriggerTypeComboCurrentItem % 2) == 0;
+        cfg.level = TriggerLevel.getValue();
+        const double vpp = GetSegmentSource()->GetVpp();
+        cfg.hysteresis = std::isfinite(vpp) ? std::max(0.01, TriggerHysteresis * vpp) : 0.05;
+        seg.Arm(cfg);
+        SegmentSelected = 0;
+    }
+
+    // Trace decimation list (order matches DecimationMethod)
+    const char* DecimationComboList[2] = {
+        "Min/Max", "LTTB"
+    };
+
+    // Persistence decay list
+    const char* PersistenceDecayComboList[6] = {
+        "Infinite", "0.25 s", "0.5 s", "1 s", "2 s", "5 s"
+    };
+    const double PersistenceDecaySeconds[6] = { 0.0, 0.25, 0.5, 1.0, 2.0, 5.0 };
+
 
     // MiniHLInput rules (unchanged)
     std::vector<MiniHLRule> rules = {
@@ -308,11 +586,22 @@ private:
         {"cosh", constants::FunctionColour, "cosh(x)", true, true, true},
         {"tanh", constants::FunctionColour, "tanh(x)", true, true, true},
         {"pow", constants::FunctionColour,  "pow(x,y) (x^y)", true, true, true},
+        {"lpf", constants::FunctionColour,  "lpf(x,fc) (first-order low-pass, fc in Hz)", true, true, true},
+        {"diff", constants::FunctionColour, "diff(x) (derivative, per second)", true, true, true},
+        {"integ", constants::FunctionColour, "integ(x) (running integral, x*s)", true, true, true},
+        {"ma", constants::FunctionColour,   "ma(x,n) (moving average of n samples)", true, true, true},
+        {"rms_window", constants::FunctionColour, "rms_window(x,n) (moving RMS of n samples)", true, true, true},
+        {"fftmag", constants::FunctionColour, "fftmag(x) (amplitude spectrum, sample k at k/record Hz)", true, true, true},
+        {"envelope", constants::FunctionColour, "envelope(x) (Hilbert envelope)", true, true, true},
 
         // Signals
         {"osc1", ImU32(OSC1Colour), "oscilloscope signal 1", true, true, true},
         {"osc2", ImU32(OSC2Colour), "oscilloscope signal 2", true, true, true},
-		{"t",   ImU32(MathColour),  "time variable",            true, true, true},
+		{"t",   ImU32(MathColours[0]),  "time variable",            true, true, true},
+        {"math1", ImU32(MathColours[0]), "math channel 1", true, true, true},
+        {"math2", ImU32(MathColours[1]), "math channel 2", true, true, true},
+        {"math3", ImU32(MathColours[2]), "math channel 3", true, true, true},
+        {"math4", ImU32(MathColours[3]), "math channel 4", true, true, true},
 
         // Constants
         {"pi", constants::NumberColour, "3.14159...", true, true, true},
@@ -3,11 +3,23 @@
 #include "librador.h"
 #include <algorithm>
 #include <chrono>
+#include <thread>
+#include <atomic>
 #include "fftw3.h"
 #include <complex>
+#include <map>
 #include <array>
 #include <float.h>
 #include "TVD.hpp"
+#include "Measurements.hpp"
+#include "SegmentedMemory.hpp"
+#include "RollBuffer.hpp"
+#include "FFTPlanCache.hpp"
+#include "Welch.hpp"
+#include "Spectrogram.hpp"
+#include "SpectralMetrics.hpp"
+#include "ZoomFFT.hpp"
+#include "LibradorRead.hpp"
 #define _USE_MATH_DEFINES
 #include "math.h"
 #include <cmath>
@@ -25,6 +37,7 @@ public:
 		data_ft_out = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * ft_size);
 		data_ft_in_filtered = (double*)fftw_malloc(sizeof(double) * ft_size);
 		data_ft_out_filtered = (fftw_complex*)fftw_malloc(sizeof(fftw_complex) * ft_size);
+		std::lock_guard<std::mutex> planner_lock(FFTPlanCache::Instance().PlannerMutex());
 		plan = fftw_plan_dft_r2c_1d(ft_size, data_ft_in, data_ft_out,FFTW_ESTIMATE);
 		reverse_plan = fftw_plan_dft_c2r_1d(
 		    ft_size, data_ft_out_filtered, data_ft_in_filtered, FFTW_ESTIMATE);
@@ -33,20 +46,26 @@ public:
 		std::fill(mini_buffer.begin(), mini_buffer.end(), 1.65);
 		data_ft_out_normalized.resize(ft_size);
 	}
+	~OscData()
+	{
+		if (spectrum_job.joinable()) spectrum_job.join();
+	}
 	void SetRawData() // sets the raw_data vector to be used for signal properties (to be changed soon)
 	{
 		if (!paused)
 		{
-
-			std::vector<double>* raw_data_ptr = librador_get_analog_data(
-			    channel, ft_time_window, ft_sample_rate, delay_s, filter_mode);
-			if (raw_data_ptr)
 			{
-				raw_data = *raw_data_ptr;
-			}
-			else
-			{
-				raw_data = {};
+				std::lock_guard<std::mutex> read_lock(LibradorReadMutex());
+				std::vector<double>* raw_data_ptr = librador_get_analog_data(
+				    channel, ft_time_window, ft_sample_rate, delay_s, filter_mode);
+				if (raw_data_ptr)
+				{
+					raw_data = *raw_data_ptr;
+				}
+				else
+				{
+					raw_data = {};
+				}
 			}
 			raw_time_step = 1 / ft_sample_rate;
 			double time_step = raw_time_step;
@@ -75,6 +94,7 @@ public:
 			{
 				ext_time_window = time_max - time_min + trigger_timeout;
 			}
+			std::lock_guard<std::mutex> read_lock(LibradorReadMutex());
 			std::vector<double>* extended_data_ptr = librador_get_analog_data(channel,
 				ext_time_window, sample_rate_hz, delay_s, filter_mode);
 			if (extended_data_ptr)
@@ -92,6 +112,10 @@ public:
 	{
 		return data;
 	}
+	const std::vector<double>& GetDataRef() const // no copy, for per-frame readers
+	{
+		return data;
+	}
 	void SetData() // sets the data vector for plotting, this is exactly what is plotted
 	{
 		if (!paused)
@@ -114,6 +138,7 @@ public:
 					extended_data.end()
 				);
 			}
+			Accumulate();
 			this->time_step = time_window / data.size();
 			double time_step = time_window / data.size();
 			time.resize(data.size());
@@ -121,6 +146,7 @@ public:
 			std::generate(time.begin(), time.end(),
 			    [n = 0, &time_step, &local_time_start]() mutable
 			    { return n++ * time_step + local_time_start; });
+			data_generation++;
 		}
 	}
 	// SetData overload to set data directly (used for math channel)
@@ -136,12 +162,76 @@ public:
 			std::generate(time.begin(), time.end(),
 				[n = 0, &time_step, &local_time_start]() mutable
 				{ return n++ * time_step + local_time_start; });
+			data_generation++;
+		}
+	}
+	/// <summary>
+	/// Counter bumped every time SetData replaces the plotted data; anything derived from the
+	/// plotted data can be cached against it.
+	/// </summary>
+	uint64_t GetDataGeneration() const
+	{
+		return data_generation;
+	}
+	// --------------------- Averaging / envelope ---------------------
+
+	/// <summary>
+	/// How successive triggered frames are combined by SetData.
+	/// Normal: latest frame only. LinearAverage: mean of the last N frames. ExpAverage: exponential
+	/// average with weight 1/N (cumulative until N frames have arrived). Envelope: latest frame plus
+	/// the running min/max of every frame since the last reset.
+	/// </summary>
+	enum class AcquireMode { Normal = 0, LinearAverage, ExpAverage, Envelope };
+
+	void SetAcquireMode(AcquireMode mode, int count)
+	{
+		count = std::max(count, 1);
+		if (mode != acquire_mode || count != acquire_count)
+		{
+			acquire_mode = mode;
+			acquire_count = count;
+			ResetAccumulation();
 		}
 	}
+	AcquireMode GetAcquireMode() const
+	{
+		return acquire_mode;
+	}
+	/// <summary>
+	/// Discards all accumulated frames (also done automatically when the time base changes).
+	/// </summary>
+	void ResetAccumulation()
+	{
+		accumulated_frames = 0;
+		average_ring_pos = 0;
+		average_sum.clear();
+		average_ring.clear();
+		envelope_min.clear();
+		envelope_max.clear();
+	}
+	/// <summary>
+	/// Number of frames contributing to the current average or envelope.
+	/// </summary>
+	int GetAccumulatedFrames() const
+	{
+		return accumulated_frames;
+	}
+	const std::vector<double>& GetEnvelopeMin() const
+	{
+		return envelope_min;
+	}
+	const std::vector<double>& GetEnvelopeMax() const
+	{
+		return envelope_max;
+	}
 	std::vector<double> GetTime()
 	{
 		return time;
 	}
+	const std::vector<double>& GetTimeRef() const
+	{
+		return time;
+	}
 	double GetTimeStep()
 	{
 		return time_step;
@@ -301,6 +391,12 @@ public:
 	}
 	void SetPaused(bool paused)
 	{
+		if (this->paused && !paused)
+		{
+			// the roll ring missed everything while paused: rebuild it from the device history
+			roll.Clear();
+			roll_columns = 0;
+		}
 		this->paused = paused;
 	}
 	int GetDataSize()
@@ -311,7 +407,7 @@ public:
 	{
 		if (data.size() != 0)
 		{
-			return *std::max_element(data.begin(), data.end());
+			return GetMeasurements().vmax;
 		}
 		else
 		{
@@ -323,7 +419,7 @@ public:
 	{
 		if (data.size() != 0)
 		{
-			return *std::min_element(data.begin(), data.end());
+			return GetMeasurements().vmin;
 		}
 		else
 		{
@@ -337,6 +433,7 @@ public:
 			int num_periods = 10;
 			double sample_rate_hz = CalculateSampleRate();
 			double periodic_time_window = GetTimeBetweenTriggers() * num_periods;
+			std::lock_guard<std::mutex> read_lock(LibradorReadMutex());
 			std::vector<double>* periodic_data_ptr = librador_get_analog_data(
 				channel, periodic_time_window, sample_rate_hz, delay_s, filter_mode);
 			if (periodic_data_ptr)
@@ -440,103 +537,195 @@ public:
 		sum /= periodic_data.size();
 		return sum;
 	}
-	void PerformSpectrumAnalysis(double sample_rate = 375000,
+	/// <summary>
+	/// Single-FFT spectrum of the last `time_window` seconds, computed on the calling thread, which
+	/// waits for a background FFT plan measurement if it needs a new plan. Returns false, doing
+	/// nothing, while a StartSpectrumAnalysis job is still computing; call it again later.
+	/// </summary>
+	bool PerformSpectrumAnalysis(double sample_rate = 375000,
 		double time_window = 5,
 		int windowing_function = 0)       // 0=Hann, 1=Rectangular
 	{
-		// ---- 0) Acquire one record (single-block FFT, DSO-style) ----
-		std::vector<double>* data_for_spectrum_ptr =
-			librador_get_analog_data(channel, time_window, sample_rate, delay_s, filter_mode);
+		if (!WaitSpectrumJob()) return false;
+		const auto t0 = std::chrono::steady_clock::now();
+		CaptureSpectrumRecord(sample_rate, time_window);
+		ComputeSpectrum(sample_rate, windowing_function);
+		PublishSpectrum();
+		spectrum_elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
 
-		if (data_for_spectrum_ptr) {
-			data_for_spectrum = *data_for_spectrum_ptr;
-			std::reverse(data_for_spectrum.begin(), data_for_spectrum.end()); // keep your original behavior
+		// NOTE:
+		// - 'spectrum_data'      : per-bin Vrms (V)
+		// - 'spectrum_data_db_v' : per-bin dBV (20*log10(Vrms))
+		// - 'spectrum_data_db_m' : per-bin dBm re 1 mW into spectrum_load_ohms
+		return true;
+	}
+	/// <summary>
+	/// Same as PerformSpectrumAnalysis, but the FFT runs on a worker thread so both channels can be
+	/// transformed at once; call CollectSpectrumAnalysis() each frame to publish the result. The record
+	/// is still read here, since librador returns one reused buffer per channel. Returns false,
+	/// starting nothing, while the previous job is still computing.
+	/// </summary>
+	bool StartSpectrumAnalysis(double sample_rate, double time_window, int windowing_function)
+	{
+		return StartSpectrumJob(sample_rate, time_window,
+			[this, sample_rate, windowing_function]() { ComputeSpectrum(sample_rate, windowing_function); });
+	}
+	/// <summary>
+	/// Zoom FFT of the band config.centre_hz +- config.span_hz / 2 over the last `time_window`
+	/// seconds, on the spectrum worker like StartSpectrumAnalysis (and likewise false if busy).
+	/// </summary>
+	bool StartZoomAnalysis(double sample_rate, double time_window, ZoomSpectrum::Config config)
+	{
+		return StartSpectrumJob(sample_rate, time_window,
+			[this, sample_rate, config]() { ComputeZoomSpectrum(sample_rate, config); });
+	}
+	bool IsSpectrumBusy() const
+	{
+		return spectrum_job.joinable();
+	}
+	/// <summary>
+	/// Publishes the worker's spectrum once it has finished. Returns true on the call that does.
+	/// </summary>
+	bool CollectSpectrumAnalysis()
+	{
+		if (!spectrum_job.joinable() || !spectrum_job_done.load())
+		{
+			return false;
 		}
-		else {
-			data_for_spectrum.clear();
+		spectrum_job.join();
+		PublishSpectrum();
+		return true;
+	}
+	/// <summary>
+	/// Seconds from reading the record to the spectrum being ready, for the last acquisition.
+	/// </summary>
+	double GetSpectrumElapsed() const
+	{
+		return spectrum_elapsed_s;
+	}
+
+	// --------------------- Welch spectrum ---------------------
+
+	/// <summary>
+	/// Starts feeding the stream pump into a fresh Welch average (gated acquisition). `sample_rate`
+	/// must divide the stream rate; the stream is boxcar-averaged down to it.
+	/// </summary>
+	void StartWelch(WelchSpectrum::Config config, double sample_rate)
+	{
+		config.input_rate = ft_sample_rate;
+		config.decimation = std::max(1, (int)std::lround(ft_sample_rate / sample_rate));
+		welch.Configure(config);
+		welch_streaming = true;
+		welch_published_segments = 0;
+	}
+	void StopWelch()
+	{
+		welch_streaming = false;
+	}
+	bool IsWelchStreaming() const
+	{
+		return welch_streaming;
+	}
+	/// <summary>
+	/// Runs the Welch average over the last `time_window` seconds in one go (lookback acquisition).
+	/// Returns false, doing nothing, while a single-FFT job is still computing.
+	/// </summary>
+	bool WelchFromRecord(WelchSpectrum::Config config, double sample_rate, double time_window)
+	{
+		if (!WaitSpectrumJob()) return false;
+		const auto t0 = std::chrono::steady_clock::now();
+		welch_streaming = false;
+		config.input_rate = sample_rate;
+		config.decimation = 1;
+		welch.Configure(config);
+		welch_published_segments = 0;
+		data_for_spectrum.clear();
+		{
+			std::lock_guard<std::mutex> read_lock(LibradorReadMutex());
+			std::vector<double>* record_ptr = librador_get_analog_data(channel, time_window, sample_rate, delay_s, filter_mode);
+			if (record_ptr)
+			{
+				data_for_spectrum.assign(record_ptr->rbegin(), record_ptr->rend());
+			}
+		}
+		if (!data_for_spectrum.empty())
+		{
+			welch.Push(data_for_spectrum.data(), data_for_spectrum.size());
+		}
+		PublishWelch(true);
+		spectrum_elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+		return true;
+	}
+	/// <summary>
+	/// Copies the current Welch average into the spectrum vectors if new segments have been added
+	/// since the last call, or always if `force` is set (an empty average clears the spectrum).
+	/// Returns true if the spectrum was rewritten.
+	/// </summary>
+	bool PublishWelch(bool force = false)
+	{
+		if (!force && welch.Segments() == welch_published_segments)
+		{
+			return false;
 		}
+		welch_published_segments = welch.Segments();
+		welch.Result(spectrum_freq, spectrum_data);
+		spectrum_window = welch.GetConfig().window;
+		SetSpectrumLevels();
+		return true;
+	}
+	size_t GetWelchSegments() const
+	{
+		return welch.Segments();
+	}
+	// --------------------- Spectrogram ---------------------
 
-		const size_t L = data_for_spectrum.size();
-		if (L == 0) {
-			time_for_spectrum.clear();
-			spectrum_freq.clear();
-			spectrum_data.clear();
+	/// <summary>
+	/// Runs or stops the spectrogram worker for this channel. A changed config restarts it (clearing
+	/// the history). `sample_rate` must divide the stream rate.
+	/// </summary>
+	void SetSpectrogram(bool on, Spectrogram::Config config, double sample_rate)
+	{
+		if (!on)
+		{
+			if (spectrogram.IsRunning())
+			{
+				spectrogram.Stop();
+			}
 			return;
 		}
-
-		// ---- 1) Time axis for whole capture ----
-		time_for_spectrum.resize(L);
-		for (size_t i = 0; i < L; ++i)
-			time_for_spectrum[i] = i / sample_rate;
-
-		// ---- 2) Window (Rect by default; Hann if requested) ----
-		std::vector<double> w(L, 1.0);
-		if (windowing_function == 0 && L > 1) { // Hann
-			const double inv = 1.0 / double(L - 1);
-			for (size_t n = 0; n < L; ++n)
-				w[n] = 0.5 * (1.0 - std::cos(2.0 * M_PI * n * inv));
+		config.input_rate = ft_sample_rate;
+		config.decimation = std::max(1, (int)std::lround(ft_sample_rate / sample_rate));
+		if (!spectrogram.IsRunning() || spectrogram.GetConfig() != config)
+		{
+			spectrogram.Start(config);
 		}
+	}
+	Spectrogram& GetSpectrogram()
+	{
+		return spectrogram;
+	}
 
-		// Coherent gain (sum of window) � used to correct tone amplitude
-		double sumw = 0.0;
-		for (double a : w) sumw += a;
-		const double inv_sumw = (sumw != 0.0) ? (1.0 / sumw) : 0.0;
-
-		// ---- 3) Detrend (remove mean) + apply window ----
-		double mean = 0.0;
-		for (double v : data_for_spectrum) mean += v;
-		mean /= double(L);
-
-		std::vector<double> in(L);
-		for (size_t n = 0; n < L; ++n)
-			in[n] = (data_for_spectrum[n] - mean) * w[n];
-
-		// ---- 4) FFT (real->complex, one-sided) ----
-		const bool   even = (L % 2 == 0);
-		const size_t Nb = L / 2 + 1;                 // one-sided bins
-		const double df = sample_rate / double(L); // frequency step
-
-		spectrum_freq.resize(Nb);
-		for (size_t k = 0; k < Nb; ++k)
-			spectrum_freq[k] = k * df;
-
-		fftw_complex* out = fftw_alloc_complex(Nb);
-		fftw_plan plan = fftw_plan_dft_r2c_1d(int(L), in.data(), out, FFTW_ESTIMATE);
-		fftw_execute(plan);
-		fftw_destroy_plan(plan);
-
-		// ---- 5) Scale to per-bin Vrms (DSO behaviour) ----
-	// For a bin-centered sine with peak amplitude A_pk:
-	//   |X[k]| ~ sum(w) * A_pk / 2  (FFTW forward is unscaled)
-	// Single-sided interior bins doubled (×2); DC/Nyquist are not.
-	// Vrms = A_pk / sqrt(2)  =>  Vrms = |X[k]| * (s / sum(w)) / sqrt(2)
-		const double root2 = std::sqrt(2.0);
-
-		spectrum_data.resize(Nb);         // per-bin Vrms (Volts)
-		spectrum_data_db_v.resize(Nb);    // per-bin dBV
-		spectrum_data_db_m.resize(Nb);    // per-bin dBm (re 1 mW into spectrum_load_ohms)
-
-		for (size_t k = 0; k < Nb; ++k) {
-			const double re = out[k][0];
-			const double im = out[k][1];
-			const double mag = std::hypot(re, im);           // |X[k]|
-			const bool is_dc = (k == 0);
-			const bool is_nyq = (even && k == Nb - 1);
-			const double s = (is_dc || is_nyq) ? 1.0 : 2.0;  // single-sided factor
+	/// <summary>
+	/// Incremented whenever the spectrum vectors are rewritten.
+	/// </summary>
+	uint64_t GetSpectrumGeneration() const
+	{
+		return spectrum_generation;
+	}
 
-			const double vrms = (mag * (s * inv_sumw)) / root2; // per-bin Vrms
-			spectrum_data[k] = vrms;
-			spectrum_data_db_v[k] = vrms_to_dBV(vrms);
-			spectrum_data_db_m[k] = vrms_to_dBm(vrms, spectrum_load_ohms);
+	/// <summary>
+	/// Distortion and noise figures of the current spectrum, recomputed only when it changes.
+	/// </summary>
+	const SpectralMetrics& GetSpectralMetrics()
+	{
+		if (metrics_generation != spectrum_generation)
+		{
+			ComputeSpectralMetrics(spectrum_freq, spectrum_data, spectrum_window, spectral_metrics);
+			metrics_generation = spectrum_generation;
 		}
-
-		fftw_free(out);
-
-		// NOTE:
-		// - 'spectrum_data'      : per-bin Vrms (V)
-		// - 'spectrum_data_db_v' : per-bin dBV (20*log10(Vrms))
-		// - 'spectrum_data_db_m' : per-bin dBm re 1 mW into spectrum_load_ohms
+		return spectral_metrics;
 	}
+
 	std::vector<double> GetSpectrumMag() { return spectrum_data; } // Vrms
 	std::vector<double> GetSpectrumMagdBV() { return spectrum_data_db_v; }
 	std::vector<double> GetSpectrumMagdBm() { return spectrum_data_db_m; }
@@ -614,259 +803,196 @@ public:
 	}
 	std::vector<double> GetMiniBuffer()
 	{
+		return mini_buffer;
+	}
+	/// <summary>
+	/// Reads every full-rate sample that arrived since the last call (librador keeps a single
+	/// "since last" cursor per channel, so this must be the only incremental reader) and hands
+	/// it to the consumers of the continuous stream: the mini buffer and segmented memory.
+	/// Pausing freezes only the scope's own display buffers (mini buffer and roll); segmented
+	/// memory, streaming Welch and the spectrogram keep running. Call once per frame.
+	/// </summary>
+	void PumpStream()
+	{
+		stream_chunk.clear();
+		{
+			std::lock_guard<std::mutex> read_lock(LibradorReadMutex());
+			std::vector<double>* buffer_update_ptr = librador_get_analog_data_sincelast(
+			    channel, 5, ft_sample_rate, delay_s, filter_mode);
+			if (!buffer_update_ptr || buffer_update_ptr->empty())
+			{
+				return;
+			}
+			// librador returns newest first
+			stream_chunk.assign(buffer_update_ptr->rbegin(), buffer_update_ptr->rend());
+		}
 		if (!paused)
 		{
-			FillMiniBuffer();
+			FillMiniBuffer(stream_chunk);
+		}
+		segments.Process(stream_chunk.data(), stream_chunk.size());
+		if (roll_mode && !paused)
+		{
+			roll.Append(stream_chunk.data(), stream_chunk.size());
+		}
+		if (welch_streaming)
+		{
+			welch.Push(stream_chunk.data(), stream_chunk.size());
+		}
+		if (spectrogram.IsRunning())
+		{
+			spectrogram.Push(stream_chunk.data(), stream_chunk.size());
 		}
-		return mini_buffer;
 	}
 
-	int GetChannel() const
+	// --------------------- Roll mode ---------------------
+
+	/// <summary>
+	/// Roll (strip-chart) mode: the newest sample is drawn at the right edge of the time window and
+	/// the trace scrolls left. The display is built from PumpStream data only, so SetExtendedData,
+	/// the trigger search and SetData are not needed while it is on.
+	/// </summary>
+	void SetRollMode(bool on)
 	{
-		return channel;
+		if (on != roll_mode)
+		{
+			roll_mode = on;
+			roll_columns = 0; // force a refill on the next UpdateRoll
+		}
 	}
-	std::vector<double> GetRawData() // unused will remove later
+	bool GetRollMode() const
 	{
-		return raw_data;
+		return roll_mode;
 	}
-	// --------------------- Basic stats ---------------------
-
-	double GetVmax() const {
-		if (data.empty()) return NaN();
-		return *std::max_element(data.begin(), data.end());
+	/// <summary>
+	/// Rebuilds the roll trace for the current time window at `columns` columns (plot resolution).
+	/// The ring is only refilled from the device buffer when the geometry changes; otherwise the
+	/// cost is one pass over the columns. data/time become the column means so measurements,
+	/// the math channel and export keep working.
+	/// </summary>
+	void UpdateRoll(int columns)
+	{
+		if (!roll_mode || paused || time_window <= 0)
+		{
+			return;
+		}
+		if (roll.Configure(time_window, columns, max_sample_rate) || columns != roll_columns)
+		{
+			roll_columns = columns;
+			// one-off refill of the history: ~16 samples per column is plenty for the min/max look,
+			// new data arriving afterwards is folded in at full rate
+			const double refill_rate = std::min(max_sample_rate, 16.0 * columns / time_window);
+			roll_refill.clear();
+			{
+				std::lock_guard<std::mutex> read_lock(LibradorReadMutex());
+				std::vector<double>* history_ptr = librador_get_analog_data(channel, time_window, refill_rate, delay_s, filter_mode);
+				if (history_ptr)
+				{
+					roll_refill.assign(history_ptr->rbegin(), history_ptr->rend());
+				}
+			}
+			if (!roll_refill.empty())
+			{
+				// each refill sample stands in for the full-rate samples it was taken from
+				const int64_t weight = std::max<int64_t>(1, std::llround(max_sample_rate / refill_rate));
+				roll.Append(roll_refill.data(), roll_refill.size(), weight);
+			}
+		}
+		roll.Build(time_max, roll_trace_time, roll_trace_data, time, data);
+		time_step = roll.ColumnSeconds();
+		data_generation++;
 	}
-
-	double GetVmin() const {
-		if (data.empty()) return NaN();
-		return *std::min_element(data.begin(), data.end());
+	const std::vector<double>& GetRollTraceTime() const
+	{
+		return roll_trace_time;
 	}
-
-	double GetVpp() const {
-		if (data.empty()) return NaN();
-		double vmax = GetVmax();
-		double vmin = GetVmin();
-		if (!valid(vmax) || !valid(vmin)) return NaN();
-		return vmax - vmin;
+	const std::vector<double>& GetRollTraceData() const
+	{
+		return roll_trace_data;
 	}
-
-	double GetVavg() const {
-		if (data.empty()) return NaN();
-		double sum = std::accumulate(data.begin(), data.end(), 0.0);
-		return sum / (double)data.size();
+	/// <summary>
+	/// Samples the last PumpStream call read, oldest first at GetStreamRate(); empty if it read none.
+	/// </summary>
+	const std::vector<double>& GetStreamChunk() const
+	{
+		return stream_chunk;
 	}
-
-	double GetVrms() const {
-		if (data.empty()) return NaN();
-		// RMS of the signal as-is (includes DC)
-		long double acc = 0.0L;
-		for (double v : data) acc += (long double)v * (long double)v;
-		double mean_sq = (double)(acc / (long double)data.size());
-		return std::sqrt(mean_sq);
+	double GetStreamRate() const
+	{
+		return ft_sample_rate;
 	}
-
-	// --------------------- Period via mid-level crossings ---------------------
-
-	// Assumes members: std::vector<double> time, data;
-	// Helpers you likely already have:
-	//   inline bool valid(double x); inline double NaN(); inline double wrap_deg(double a);
-
-	double GetPeriod() const {
-		// Use the overlap to be safe.
-		const size_t N = std::min(time.size(), data.size());
-		if (N < 8) return NaN();
-
-		// Require strictly increasing timestamps.
-		for (size_t i = 1; i < N; ++i)
-			if (!(time[i] > time[i - 1])) return NaN();
-
-
-		// ---- 1) DENOISE ----
-		// Make a contiguous copy for TVD (in case 'data' has extra capacity or is a view).
-		std::vector<double> periodic_data;
-		periodic_data.assign(data.begin(), data.begin() + N);
-		// You can tune lambda externally; 0.05–0.3 is a common sweet spot.
-		double lambda = 0.1;
-		std::vector<double> x = tv_denoise(periodic_data, lambda);   // denoised signal (length N expected)
-		if (x.size() != N) return NaN();
-
-		// ---- 2) MIDPOINT & HYSTERESIS FROM DENOISED + RESIDUAL NOISE ----
-		// Compute vmin, vmax from the denoised signal (more stable than raw).
-		auto [min_it, max_it] = std::minmax_element(x.begin(), x.end());
-		const double vmin = *min_it;
-		const double vmax = *max_it;
-		if (!std::isfinite(vmin) || !std::isfinite(vmax)) return NaN();
-
-		const double vpp = vmax - vmin;
-		if (!(vpp > 0.0)) return NaN();
-
-		const double vmid = 0.5 * (vmax + vmin);
-
-		// Estimate residual noise from raw - denoised via MAD (robust).
-		auto median_of = [](std::vector<double>& v)->double {
-			if (v.empty()) return std::numeric_limits<double>::quiet_NaN();
-			size_t n = v.size() / 2;
-			std::nth_element(v.begin(), v.begin() + n, v.end());
-			double m = v[n];
-			if ((v.size() & 1) == 0) {
-				// even: also get the lower neighbor
-				std::nth_element(v.begin(), v.begin() + n - 1, v.end());
-				m = 0.5 * (m + v[n - 1]);
-			}
-			return m;
-		};
-
-		std::vector<double> r; r.reserve(N);
-		for (size_t i = 0; i < N; ++i) r.push_back(periodic_data[i] - x[i]);
-
-		double r_med = [&] {
-			std::vector<double> tmp = r;
-			return median_of(tmp);
-		}();
-
-		double mad = [&] {
-			std::vector<double> tmp; tmp.reserve(N);
-			for (double ri : r) tmp.push_back(std::abs(ri - r_med));
-			return median_of(tmp);
-		}();
-
-		const double sigma = (std::isfinite(mad) ? 1.4826 * mad : 0.0);
-
-		// Hysteresis: derive from noise and amplitude. Floor to avoid chatter on tiny signals.
-		// Larger of (3σ) and (5% Vpp), with a very small absolute floor.
-		const double h = std::max(std::max(3.0 * sigma, 0.05 * vpp), 1e-6);
-		const double lo = vmid - h;
-
-		// ---- 3) RISING vmid CROSSINGS ON DENOISED (RE-ARM BELOW lo) ----
-		std::vector<double> t_cross; t_cross.reserve(N / 3);
-		bool armed = (x[0] <= lo); // start armed if we begin below lo
-
-		for (size_t i = 1; i < N; ++i) {
-			const double x0 = x[i - 1];
-			const double x1 = x[i];
-
-			if (armed) {
-				// rising crossing exactly at vmid (guarantees interpolation is inside segment)
-				if (x0 <= vmid && x1 > vmid) {
-					const double dx = x1 - x0;     // > 0 in normal rising case
-					if (dx != 0.0) {
-						// Optional shallow-edge guard: require slope big enough in volts/sample
-						// (helps with ultra-low amplitude + noise). Tune 1e-4 as needed.
-						if (dx > 1e-4 * vpp) {
-							const double alpha = (vmid - x0) / dx; // in [0,1] by construction
-							const double t = time[i - 1] + alpha * (time[i] - time[i - 1]);
-							if (std::isfinite(t)) t_cross.push_back(t);
-						}
-					}
-					armed = false; // disarm until we drop below lo again
-				}
-			}
-			else {
-				if (x1 < lo) armed = true; // re-arm when safely below lo
-			}
-		}
-
-		// ---- 4) PERIOD FROM CROSSINGS (CENTERED OLS; FALLBACK FOR 2) ----
-		const size_t M = t_cross.size();
-		if (M < 2) return NaN();
-
-		if (M == 2) {
-			const double T = t_cross[1] - t_cross[0];
-			return (std::isfinite(T) && T > 0.0) ? T : NaN();
-		}
-
-		// Centered least-squares slope of t_k ≈ t0 + k*T, k = 0..M-1
-		const long double Mld = (long double)M;
-		const long double mean_k = (Mld - 1.0L) * 0.5L;
-
-		long double mean_t = 0.0L;
-		for (size_t k = 0; k < M; ++k) mean_t += (long double)t_cross[k];
-		mean_t /= Mld;
-
-		long double cov_kt = 0.0L, var_k = 0.0L;
-		for (size_t k = 0; k < M; ++k) {
-			const long double kc = (long double)k - mean_k;
-			const long double tc = (long double)t_cross[k] - mean_t;
-			cov_kt += kc * tc;
-			var_k += kc * kc;
-		}
-
-		if (var_k == 0.0L) return NaN();
-		const double T = (double)(cov_kt / var_k);
-		return (std::isfinite(T) && T > 0.0) ? T : NaN();
+	SegmentedMemory& GetSegments()
+	{
+		return segments;
+	}
+	const SegmentedMemory& GetSegments() const
+	{
+		return segments;
 	}
 
+	int GetChannel() const
+	{
+		return channel;
+	}
+	std::vector<double> GetRawData() // unused will remove later
+	{
+		return raw_data;
+	}
+	// --------------------- Measurements ---------------------
 
-
-	// --------------------- Absolute phase at f ≈ 1/T (ref at window center) ---------------------
-	double GetPhaseDeg(double* freq_used_out = nullptr) const {
-		const size_t N = std::min(time.size(), data.size());
-		if (N < 8) {
-			if (freq_used_out) *freq_used_out = NaN();
-			return NaN();
-		}
-		for (size_t i = 1; i < N; ++i)
-			if (!(time[i] > time[i - 1])) { if (freq_used_out) *freq_used_out = NaN(); return NaN(); }
-
-		// Base frequency from period
-		const double T = GetPeriod();
-		if (!(valid(T) && T > 0.0)) { if (freq_used_out) *freq_used_out = NaN(); return NaN(); }
-		const double f0 = 1.0 / T;
-
-		// DC removal
-		const double mean = GetVavg();
-		if (!valid(mean)) { if (freq_used_out) *freq_used_out = NaN(); return NaN(); }
-
-		// Reference time at window center to stabilize phase when the window slides
-		const double t0 = 0.5 * (time.front() + time.back());
-
-		// Hann window (weight)
-		auto hann_w = [N](size_t n)->double {
-			if (N < 2) return 1.0;
-			return 0.5 * (1.0 - std::cos(2.0 * M_PI * (double)n / (double)(N - 1)));
-		};
-
-		// Small frequency refinement around f0 using a 3-point parabolic peak on |S(f)|:
-		// Evaluate S at f0-df, f0, f0+df
-		const double span = std::max(1e-12, time.back() - time.front());
-		const double df = 1.0 / span;  // ~frequency bin of the aperture
-		auto proj = [&](double f)->std::pair<double, double> {
-			long double Re = 0.0L, Im = 0.0L;
-			for (size_t n = 0; n < N; ++n) {
-				const double x = data[n] - mean;
-				const double w = hann_w(n);
-				const double ang = 2.0 * M_PI * f * (time[n] - t0);  // center-referenced
-				const double c = std::cos(ang), s = std::sin(ang);
-				Re += (long double)(w * x) * (long double)c;
-				Im -= (long double)(w * x) * (long double)s; // e^{-iωt}
-			}
-			return { (double)Re, (double)Im };
-		};
-		auto mag2 = [](double Re, double Im) { return Re * Re + Im * Im; };
-
-		const auto [Re0m, Im0m] = proj(f0 - df);
-		const auto [Re0, Im0] = proj(f0);
-		const auto [Re0p, Im0p] = proj(f0 + df);
-
-		const double A0m = mag2(Re0m, Im0m);
-		const double A0 = mag2(Re0, Im0);
-		const double A0p = mag2(Re0p, Im0p);
-
-		// Parabolic interpolation of peak shift (Δ in bins of df)
-		double delta = 0.0;
-		const double denom = (A0m - 2.0 * A0 + A0p);
-		if (std::fabs(denom) > 0.0) {
-			delta = 0.5 * (A0m - A0p) / denom;  // in [-1, +1] ideally
-			delta = std::max(-1.0, std::min(1.0, delta));
+	/// <summary>
+	/// All standard measurements of the plotted data. Computed once per data generation by the
+	/// measurement engine and cached until SetData replaces the data.
+	/// </summary>
+	const SignalMeasurements& GetMeasurements() const
+	{
+		if (measured_generation != data_generation)
+		{
+			measurement_engine.Measure(time, data);
+			measured_generation = data_generation;
 		}
-		const double f1 = std::max(0.0, f0 + delta * df);
+		return measurement_engine.Last();
+	}
 
-		// Final projection at refined f1 (still referenced to t0)
-		const auto [Re, Im] = proj(f1);
-		if (!(std::isfinite(Re) && std::isfinite(Im))) { if (freq_used_out) *freq_used_out = NaN(); return NaN(); }
+	double GetVmax() const { return GetMeasurements().vmax; }
+	double GetVmin() const { return GetMeasurements().vmin; }
+	double GetVpp() const { return GetMeasurements().vpp; }
+	double GetVavg() const { return GetMeasurements().vavg; }
+	double GetVrms() const { return GetMeasurements().vrms; } // includes DC
+	double GetPeriod() const { return GetMeasurements().period; } // mid-level crossings of the denoised signal
+	double GetFrequency() const { return GetMeasurements().frequency; }
+	double GetDuty() const { return GetMeasurements().duty; }
+	double GetRiseTime() const { return GetMeasurements().rise_time; }
+	double GetFallTime() const { return GetMeasurements().fall_time; }
+
+	// Absolute phase at f ~ 1/T (ref at window center)
+	double GetPhaseDeg(double* freq_used_out = nullptr) const
+	{
+		const SignalMeasurements& m = GetMeasurements();
+		if (freq_used_out) *freq_used_out = m.phase_freq;
+		return m.phase_deg;
+	}
 
-		if (freq_used_out) *freq_used_out = f1;
-		const double phi = std::atan2(Im, Re) * (180.0 / M_PI);
-		return wrap_deg(phi);
+	/// <summary>
+	/// Phase of `other` relative to this channel (other - this, degrees), with both channels
+	/// projected in the same pass at this channel's refined frequency. NaN if this channel has
+	/// no period or the two records do not share a time base. Cached per pair of data generations.
+	/// </summary>
+	double GetRelativePhaseDeg(const OscData& other) const
+	{
+		RelativePhase& cached = relative_phase[&other];
+		if (cached.generation == data_generation && cached.other_generation == other.data_generation)
+			return cached.deg;
+		const SignalMeasurements& m = GetMeasurements();
+		const SignalMeasurements& mo = other.GetMeasurements();
+		if (!std::isfinite(m.period) || time.size() != other.time.size() || time.empty()
+			|| time.front() != other.time.front() || time.back() != other.time.back())
+			cached.deg = std::numeric_limits<double>::quiet_NaN();
+		else
+			cached.deg = measurement_engine.RelativePhaseDeg(time, data, other.data, mo.vavg);
+		cached.generation = data_generation;
+		cached.other_generation = other.data_generation;
+		return cached.deg;
 	}
 
 
@@ -892,14 +1018,64 @@ private:
 	double extended_data_sample_rate_hz = 0;
 	int max_plot_samples = 2048;
 	double max_sample_rate = 375000;
+	// averaging / envelope across triggered frames
+	AcquireMode acquire_mode = AcquireMode::Normal;
+	int acquire_count = 16;
+	int accumulated_frames = 0;
+	size_t average_ring_pos = 0;
+	std::vector<double> average_sum = {};  // LinearAverage: running sum, ExpAverage: current average
+	std::vector<double> average_ring = {}; // LinearAverage: last acquire_count frames
+	std::vector<double> envelope_min = {};
+	std::vector<double> envelope_max = {};
+	struct TimeBase
+	{
+		double time_min, time_window, sample_rate, trigger_time_plot;
+		size_t size;
+		bool trigger_on;
+		bool operator!=(const TimeBase& o) const
+		{
+			return time_min != o.time_min || time_window != o.time_window || sample_rate != o.sample_rate
+				|| trigger_time_plot != o.trigger_time_plot || size != o.size || trigger_on != o.trigger_on;
+		}
+	};
+	TimeBase accumulated_time_base = {};
+	// measurements (cached per data generation)
+	uint64_t data_generation = 0;
+	mutable uint64_t measured_generation = 0;
+	mutable MeasurementEngine measurement_engine;
+	struct RelativePhase
+	{
+		uint64_t generation = UINT64_MAX, other_generation = UINT64_MAX;
+		double deg = 0.0;
+	};
+	mutable std::map<const OscData*, RelativePhase> relative_phase; // GetRelativePhaseDeg, per other channel
 	// spectrum analyser
 	std::vector<double> data_for_spectrum = {};
 	std::vector<double> time_for_spectrum = {};
+	SpectrumWorkspace spectrum_fft; // aligned FFT buffers and window for PerformSpectrumAnalysis
+	ZoomSpectrum zoom;              // filter and FFT buffers for StartZoomAnalysis
 	std::vector<double> spectrum_data = {};      // per-bin Vrms (linear)
 	std::vector<double> spectrum_data_db_v = {}; // per-bin dBV
 	std::vector<double> spectrum_data_db_m = {}; // per-bin dBm
 	std::vector<double> spectrum_freq = {};
 	double spectrum_load_ohms = 50.0;           // dBm reference load
+	uint64_t spectrum_generation = 0;
+	int spectrum_window = SpectrumWorkspace::Hann; // window the displayed spectrum was taken with
+	SpectralMetrics spectral_metrics;
+	uint64_t metrics_generation = 0;
+	// single-FFT worker (StartSpectrumAnalysis) and the vectors it fills before PublishSpectrum
+	std::thread spectrum_job;
+	std::atomic<bool> spectrum_job_done{ false };
+	double spectrum_elapsed_s = 0.0;
+	std::vector<double> staging_freq = {};
+	std::vector<double> staging_data = {};
+	std::vector<double> staging_db_v = {};
+	std::vector<double> staging_db_m = {};
+	int staging_window = SpectrumWorkspace::Hann;
+	WelchSpectrum welch;
+	Spectrogram spectrogram;
+	bool welch_streaming = false;
+	size_t welch_published_segments = 0;
 	// frequency stuff
 	std::vector<double> raw_data = {};
 	std::vector<double> raw_time = {}; // time associated with raw_data
@@ -920,6 +1096,15 @@ private:
 	std::vector<double> mini_buffer = {};
 	double mini_buffer_length = 0.05; // seconds
 	int mini_buffer_next_index = 0;
+	// continuous stream (full rate, oldest first) and its consumers
+	std::vector<double> stream_chunk = {};
+	SegmentedMemory segments;
+	bool roll_mode = false;
+	int roll_columns = 0;
+	RollBuffer roll;
+	std::vector<double> roll_trace_time = {}; // interleaved min/max polyline
+	std::vector<double> roll_trace_data = {};
+	std::vector<double> roll_refill = {};
 	
 	// osc control parameters
 	bool paused = false;
@@ -975,39 +1160,281 @@ private:
 		double ft_sample_mag = std::sqrt(ft_sample[0] * ft_sample[0] + ft_sample[1] * ft_sample[1]);
 		return ft_sample_mag;
 	}
-	void FillMiniBuffer() // used for auto osc gain and that's all
+	void FillMiniBuffer(const std::vector<double>& chunk) // used for auto osc gain and that's all
 	{
-		std::vector<double>* buffer_update_ptr = librador_get_analog_data_sincelast(
-		    channel, 5, ft_sample_rate, delay_s, filter_mode);
-		if (buffer_update_ptr)
+		int buffer_update_size = chunk.size();
+		for (int i = 0; i < buffer_update_size; i++)
 		{
-			int buffer_update_size = buffer_update_ptr->size();
-			for (int i = 0; i < buffer_update_size; i++)
+			int mini_buffer_idx = (mini_buffer_next_index + i) % mini_buffer.size();
+			mini_buffer[mini_buffer_idx] = chunk[i];
+		}
+		mini_buffer_next_index
+		    = (mini_buffer_next_index + buffer_update_size) % mini_buffer.size();
+	}
+
+	// === Helpers ===
+	// Folds the frame just sliced into `data` into the averaging/envelope accumulators.
+	// For the averaging modes `data` is replaced by the average.
+	void Accumulate()
+	{
+		if (acquire_mode == AcquireMode::Normal)
+		{
+			return;
+		}
+		const size_t len = data.size();
+		const TimeBase tb = { time_min, time_window, extended_data_sample_rate_hz, trigger_time_plot, len, trigger_on };
+		if (len == 0 || accumulated_frames == 0 || tb != accumulated_time_base)
+		{
+			ResetAccumulation();
+			accumulated_time_base = tb;
+		}
+		if (len == 0)
+		{
+			return;
+		}
+		switch (acquire_mode)
+		{
+		case AcquireMode::LinearAverage:
+		{
+			const size_t n = (size_t)acquire_count;
+			if (accumulated_frames == 0)
+			{
+				average_sum.assign(len, 0.0);
+				average_ring.assign(len * n, 0.0);
+			}
+			double* slot = average_ring.data() + average_ring_pos * len;
+			for (size_t i = 0; i < len; ++i)
+			{
+				average_sum[i] += data[i] - slot[i]; // slot is zero until the ring has filled
+				slot[i] = data[i];
+			}
+			average_ring_pos = (average_ring_pos + 1) % n;
+			accumulated_frames = std::min(accumulated_frames + 1, acquire_count);
+			if (average_ring_pos == 0)
 			{
-				int mini_buffer_idx = (mini_buffer_next_index + i) % mini_buffer.size();
-				mini_buffer[mini_buffer_idx]
-				    = buffer_update_ptr->at(buffer_update_size - 1 - i);
+				// re-sum once per lap so rounding in the running sum cannot build up
+				std::fill(average_sum.begin(), average_sum.end(), 0.0);
+				for (size_t k = 0; k < n; ++k)
+					for (size_t i = 0; i < len; ++i)
+						average_sum[i] += average_ring[k * len + i];
 			}
-			mini_buffer_next_index
-			    = (mini_buffer_next_index + buffer_update_size) % mini_buffer.size();
+			const double inv = 1.0 / accumulated_frames;
+			for (size_t i = 0; i < len; ++i)
+				data[i] = average_sum[i] * inv;
+			break;
+		}
+		case AcquireMode::ExpAverage:
+		{
+			if (accumulated_frames == 0)
+			{
+				average_sum = data;
+				accumulated_frames = 1;
+				break;
+			}
+			accumulated_frames = std::min(accumulated_frames + 1, acquire_count);
+			const double alpha = 1.0 / accumulated_frames;
+			for (size_t i = 0; i < len; ++i)
+			{
+				average_sum[i] += alpha * (data[i] - average_sum[i]);
+				data[i] = average_sum[i];
+			}
+			break;
+		}
+		case AcquireMode::Envelope:
+		{
+			if (accumulated_frames == 0)
+			{
+				envelope_min = data;
+				envelope_max = data;
+			}
+			else
+			{
+				for (size_t i = 0; i < len; ++i)
+				{
+					envelope_min[i] = std::min(envelope_min[i], data[i]);
+					envelope_max[i] = std::max(envelope_max[i], data[i]);
+				}
+			}
+			accumulated_frames++;
+			break;
+		}
+		default:
+			break;
+		}
+	}
+	// Vrms -> dBV and dBm helpers
+	// Fills dBV/dBm from per-bin Vrms. One log per bin: dBm is dBV shifted by the load, with the
+	// same floors as vrms_to_dBV/vrms_to_dBm.
+	void ComputeSpectrumLevels(const std::vector<double>& vrms, std::vector<double>& db_v, std::vector<double>& db_m) const
+	{
+		const size_t Nb = vrms.size();
+		db_v.resize(Nb);
+		db_m.resize(Nb);
+		const double dbm_offset = 10.0 * std::log10(std::max(spectrum_load_ohms, 1e-30));
+		for (size_t k = 0; k < Nb; ++k) {
+			const double v = vrms[k];
+			const double db = 10.0 * std::log10(std::max(v * v, 1e-60));
+			db_v[k] = db;
+			db_m[k] = std::max(db - dbm_offset, -300.0) + 30.0;
 		}
-			
+	}
+	void SetSpectrumLevels()
+	{
+		ComputeSpectrumLevels(spectrum_data, spectrum_data_db_v, spectrum_data_db_m);
+		spectrum_generation++;
 	}
 
-	// === Helpers ===
-	static inline bool valid(double x) {
-		return std::isfinite(x);
+	// Reads the spectrum record, oldest first, into data_for_spectrum. UI thread only.
+	void CaptureSpectrumRecord(double sample_rate, double time_window)
+	{
+		// ---- 0) Acquire one record (single-block FFT, DSO-style) ----
+		std::lock_guard<std::mutex> read_lock(LibradorReadMutex());
+		std::vector<double>* data_for_spectrum_ptr =
+			librador_get_analog_data(channel, time_window, sample_rate, delay_s, filter_mode);
+
+		if (data_for_spectrum_ptr) {
+			data_for_spectrum.assign(data_for_spectrum_ptr->rbegin(), data_for_spectrum_ptr->rend());
+		}
+		else {
+			data_for_spectrum.clear();
+		}
+	}
+
+	// FFT of data_for_spectrum into the staging vectors. Touches nothing the UI thread reads while
+	// a job is running, so it is safe on the spectrum worker.
+	void ComputeSpectrum(double sample_rate, int windowing_function)
+	{
+		const size_t L = data_for_spectrum.size();
+		if (L == 0) {
+			time_for_spectrum.clear();
+			staging_freq.clear();
+			staging_data.clear();
+			staging_db_v.clear();
+			staging_db_m.clear();
+			return;
+		}
+
+		// ---- 1) Time axis for whole capture ----
+		time_for_spectrum.resize(L);
+		for (size_t i = 0; i < L; ++i)
+			time_for_spectrum[i] = i / sample_rate;
+
+		// ---- 2) Window (Rect by default; Hann if requested), cached with the FFT buffers ----
+		spectrum_fft.Prepare(L, windowing_function);
+		staging_window = windowing_function;
+		const std::vector<double>& w = spectrum_fft.GetWindow();
+
+		// Coherent gain (sum of window) - used to correct tone amplitude
+		const double sumw = spectrum_fft.WindowSum();
+		const double inv_sumw = (sumw != 0.0) ? (1.0 / sumw) : 0.0;
+
+		// ---- 3) Detrend (remove mean) + apply window ----
+		double mean = 0.0;
+		for (double v : data_for_spectrum) mean += v;
+		mean /= double(L);
+
+		double* in = spectrum_fft.In();
+		for (size_t n = 0; n < L; ++n)
+			in[n] = (data_for_spectrum[n] - mean) * w[n];
+
+		// ---- 4) FFT (real->complex, one-sided) ----
+		const bool   even = (L % 2 == 0);
+		const size_t Nb = L / 2 + 1;                 // one-sided bins
+		const double df = sample_rate / double(L); // frequency step
+
+		staging_freq.resize(Nb);
+		for (size_t k = 0; k < Nb; ++k)
+			staging_freq[k] = k * df;
+
+		// plan comes from the shared cache (threaded for large records), buffers are reused; this
+		// runs on the spectrum worker, which may wait for a background plan measurement
+		if (!spectrum_fft.Execute(true))
+		{
+			staging_freq.clear();
+			staging_data.clear();
+			staging_db_v.clear();
+			staging_db_m.clear();
+			return;
+		}
+		const fftw_complex* out = spectrum_fft.Out();
+
+		// ---- 5) Scale to per-bin Vrms (DSO behaviour) ----
+	// For a bin-centered sine with peak amplitude A_pk:
+	//   |X[k]| ~ sum(w) * A_pk / 2  (FFTW forward is unscaled)
+	// Single-sided interior bins doubled (×2); DC/Nyquist are not.
+	// Vrms = A_pk / sqrt(2)  =>  Vrms = |X[k]| * (s / sum(w)) / sqrt(2)
+		const double root2 = std::sqrt(2.0);
+
+		staging_data.resize(Nb);         // per-bin Vrms (Volts)
+
+		for (size_t k = 0; k < Nb; ++k) {
+			const double re = out[k][0];
+			const double im = out[k][1];
+			const bool is_dc = (k == 0);
+			const bool is_nyq = (even && k == Nb - 1);
+			const double s = (is_dc || is_nyq) ? 1.0 : 2.0;  // single-sided factor
+
+			// |X[k]| stays far from overflow for ADC-range voltages, so skip std::hypot
+			staging_data[k] = std::sqrt(re * re + im * im) * ((s * inv_sumw) / root2); // per-bin Vrms
+		}
+		ComputeSpectrumLevels(staging_data, staging_db_v, staging_db_m);
 	}
-	static inline double NaN() {
-		return std::numeric_limits<double>::quiet_NaN();
+
+	// Band-limited spectrum of data_for_spectrum into the staging vectors (spectrum worker).
+	void ComputeZoomSpectrum(double sample_rate, const ZoomSpectrum::Config& config)
+	{
+		time_for_spectrum.clear();
+		zoom.Compute(data_for_spectrum.data(), data_for_spectrum.size(), sample_rate, config, staging_freq, staging_data);
+		staging_window = config.window;
+		ComputeSpectrumLevels(staging_data, staging_db_v, staging_db_m);
 	}
-	static inline double wrap_deg(double a) {
-		if (!std::isfinite(a)) return a;
-		a = std::fmod(a + 180.0, 360.0);
-		if (a < 0) a += 360.0;
-		return a - 180.0;
+
+	// Reads the record here, then runs `compute` (which fills the staging vectors) on the worker.
+	// Returns false, doing nothing, while the previous job is still computing; its result is
+	// collected as usual.
+	template <typename Compute>
+	bool StartSpectrumJob(double sample_rate, double time_window, Compute compute)
+	{
+		if (!WaitSpectrumJob()) return false;
+		const auto t0 = std::chrono::steady_clock::now();
+		CaptureSpectrumRecord(sample_rate, time_window);
+		spectrum_job_done = false;
+		spectrum_job = std::thread([this, compute, t0]()
+		{
+			compute();
+			spectrum_elapsed_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+			spectrum_job_done = true;
+		});
+		return true;
+	}
+
+	// Swaps the finished staging vectors in as the displayed spectrum. UI thread only.
+	void PublishSpectrum()
+	{
+		spectrum_freq.swap(staging_freq);
+		spectrum_data.swap(staging_data);
+		spectrum_data_db_v.swap(staging_db_v);
+		spectrum_data_db_m.swap(staging_db_m);
+		spectrum_window = staging_window;
+		spectrum_generation++;
+	}
+
+	// Publishes a finished job. False, without waiting, if one is still computing: it can be held
+	// up for as long as a background FFT plan measurement, which the UI thread must not wait for.
+	bool WaitSpectrumJob()
+	{
+		if (!spectrum_job.joinable())
+		{
+			return true;
+		}
+		if (!spectrum_job_done.load())
+		{
+			return false;
+		}
+		spectrum_job.join();
+		PublishSpectrum();
+		return true;
 	}
-	// Vrms -> dBV and dBm helpers
 	inline double vrms_to_dBV(double v) {
 		const double eps = 1e-30;
 		return 20.0 * std::log10(std::max(std::abs(v), eps)); // re 1 V
@@ -0,0 +1,179 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <chrono>
+#include <cstdint>
+#include "implot.h"
+
+/// <summary>
+/// Digital-phosphor style persistence map for one channel: a time x voltage grid of hit counts
+/// that every acquired waveform is rasterized into, drawn as an ImPlot heatmap.
+/// Decay is applied lazily: instead of scaling the whole grid every frame, new hits are added with
+/// an ever-growing gain (the grid is renormalised only when the gain gets large), so the cost of a
+/// frame is proportional to the waveform length, not the grid size. No allocation happens unless
+/// the grid geometry changes.
+/// </summary>
+class PersistenceMap
+{
+public:
+	/// <summary>
+	/// Sets the exponential decay time constant. Zero or negative means infinite persistence.
+	/// </summary>
+	void SetDecay(double seconds)
+	{
+		if (seconds != decay_s)
+		{
+			decay_s = seconds;
+			Clear();
+		}
+	}
+
+	void Clear()
+	{
+		std::fill(hits.begin(), hits.end(), 0.0f);
+		gain = 1.0f;
+		peak = 0.0f;
+		display_dirty = true;
+		have_last_time = false;
+		last_generation = UINT64_MAX;
+	}
+
+	/// <summary>
+	/// Matches the grid to the plot area. Any change of size or axis limits invalidates the
+	/// accumulated history, so the map is cleared. Returns true if that happened.
+	/// </summary>
+	bool Configure(int cols, int rows, double x_min, double x_max, double y_min, double y_max)
+	{
+		if (cols == this->cols && rows == this->rows && x_min == this->x_min && x_max == this->x_max
+			&& y_min == this->y_min && y_max == this->y_max)
+			return false;
+		this->cols = cols;
+		this->rows = rows;
+		this->x_min = x_min;
+		this->x_max = x_max;
+		this->y_min = y_min;
+		this->y_max = y_max;
+		hits.assign((size_t)cols * rows, 0.0f);
+		display.assign((size_t)cols * rows, 0.0f);
+		Clear();
+		return true;
+	}
+
+	/// <summary>
+	/// Rasterizes one waveform (consecutive samples joined by line segments). Calls with the same
+	/// data generation as the previous call are ignored, so this can be called every frame.
+	/// </summary>
+	void Accumulate(const std::vector<double>& time, const std::vector<double>& data, uint64_t generation)
+	{
+		if (generation == last_generation || hits.empty()) return;
+		last_generation = generation;
+
+		ApplyDecay();
+
+		const size_t N = std::min(time.size(), data.size());
+		if (N == 0) return;
+		const double sx = cols / (x_max - x_min);
+		const double sy = rows / (y_max - y_min);
+		// clamp to one cell outside the grid so off-screen excursions stay cheap and invisible
+		auto col_of = [&](double t) { return (int)std::clamp(std::floor((t - x_min) * sx), -1.0, (double)cols); };
+		auto row_of = [&](double v) { return (int)std::clamp(std::floor((y_max - v) * sy), -1.0, (double)rows); };
+
+		int pc = col_of(time[0]);
+		int pr = row_of(data[0]);
+		Span(pc, pr, pr);
+		for (size_t i = 1; i < N; ++i)
+		{
+			const int c = col_of(time[i]);
+			const int r = row_of(data[i]);
+			if (c == pc)
+			{
+				// same column: extend from the previous row, not counting the shared end point twice
+				if (r != pr) Span(c, pr + (r > pr ? 1 : -1), r);
+			}
+			else
+			{
+				// walk the columns in between, joining interpolated rows
+				const int step = (c > pc) ? 1 : -1;
+				int prev = pr;
+				for (int cc = pc + step; cc != c + step; cc += step)
+				{
+					const int rr = pr + (int)std::lround((double)(r - pr) * (cc - pc) / (double)(c - pc));
+					Span(cc, prev, rr);
+					prev = rr;
+				}
+			}
+			pc = c;
+			pr = r;
+		}
+		display_dirty = true;
+	}
+
+	/// <summary>
+	/// Draws the map over the configured plot limits with the given colormap. Intensities are
+	/// fourth-root compressed so a single stray waveform is still visible next to the dominant one.
+	/// </summary>
+	void Plot(const char* label_id, ImPlotColormap colormap)
+	{
+		if (hits.empty() || !(peak > 0.0f)) return;
+		if (display_dirty)
+		{
+			const float inv_peak = 1.0f / peak;
+			for (size_t i = 0; i < hits.size(); ++i)
+				display[i] = std::sqrt(std::sqrt(hits[i] * inv_peak));
+			display_dirty = false;
+		}
+		ImPlot::PushColormap(colormap);
+		ImPlot::PlotHeatmap(label_id, display.data(), rows, cols, 0.0, 1.0, nullptr,
+			ImPlotPoint(x_min, y_min), ImPlotPoint(x_max, y_max));
+		ImPlot::PopColormap();
+	}
+
+private:
+	std::vector<float> hits;    // row-major, row 0 = y_max (ImPlot heatmap order)
+	std::vector<float> display; // compressed 0..1 intensities handed to ImPlot
+	int cols = 0, rows = 0;
+	double x_min = 0, x_max = 0, y_min = 0, y_max = 0;
+
+	double decay_s = 0.0; // <= 0: infinite persistence
+	float gain = 1.0f;    // weight of a hit right now; true intensity = hits / gain
+	float peak = 0.0f;    // largest cell in hits (hits only grow, so this is exact)
+	bool display_dirty = true;
+	uint64_t last_generation = UINT64_MAX;
+	bool have_last_time = false;
+	std::chrono::steady_clock::time_point last_time;
+
+	void ApplyDecay()
+	{
+		const auto now = std::chrono::steady_clock::now();
+		if (decay_s > 0.0 && have_last_time)
+		{
+			const double dt = std::chrono::duration<double>(now - last_time).count();
+			gain *= (float)std::exp(dt / decay_s);
+			if (gain > 1e20f)
+			{
+				// renormalise before float range becomes a problem
+				const float inv = 1.0f / gain;
+				for (float& h : hits) h *= inv;
+				peak *= inv;
+				gain = 1.0f;
+			}
+		}
+		last_time = now;
+		have_last_time = true;
+	}
+
+	void Span(int c, int r0, int r1)
+	{
+		if (c < 0 || c >= cols) return;
+		if (r0 > r1) std::swap(r0, r1);
+		r0 = std::max(r0, 0);
+		r1 = std::min(r1, rows - 1);
+		for (int r = r0; r <= r1; ++r)
+		{
+			float& h = hits[(size_t)r * cols + c];
+			h += gain;
+			peak = std::max(peak, h);
+		}
+	}
+};
@@ -15,6 +15,9 @@
 #include "ControlWidget.hpp"
 #include "NetworkAnalyser.hpp"
 #include "AnalysisToolsWidget.hpp"
+#include "Persistence.hpp"
+#include "Decimation.hpp"
+#include "MathEngine.hpp"
 #include "implot_internal.h"
 #include <chrono>
 #include "util.h"
@@ -110,8 +113,10 @@ public:
 		// We assume phase table is shown if you want it included in the layout.
 		float signal_props_h = 0.0f;
 		if (osc_control->SignalPropertiesToggle) {
-			// how many signals you pass below (OSC1, OSC2, Math)
-			const int signal_count = 3;
+			// how many signals you pass below (OSC1, OSC2, Math channels in use)
+			int signal_count = 2;
+			for (int ch = 0; ch < MathEngine::MaxChannels; ++ch)
+				if (osc_control->GetMathControls(ch).On && !osc_control->GetMathControls(ch).Text.empty()) signal_count++;
 			const bool include_phase = true; // set false if you don't want to reserve for phase table
 			signal_props_h = EstimateSignalPropsHeight(signal_count, include_phase);
 		}
@@ -333,13 +338,36 @@ public:
 				}
 				next_autofitY = true;
 			}
+			// traces are reduced to one column per pixel of the plot area
+			plot_columns = std::max(2, (int)ImPlot::GetPlotSize().x);
+			const ImPlotRect time_limits = ImPlot::GetPlotLimits();
+			const DecimationMethod decimation = osc_control->GetDecimationMethod();
+			// Persistence maps go first so the live traces are drawn on top
+			if (osc_control->PersistenceToggle)
+			{
+				DrawPersistenceMaps();
+			}
+			else if (persistence_was_on)
+			{
+				osc1_persistence.Clear();
+				osc2_persistence.Clear();
+			}
+			persistence_was_on = osc_control->PersistenceToggle;
 			// Plot oscilloscope 1 signal
 			std::vector<double> time_osc1 = OSC1Data->GetTime();
 			if (osc_control->DisplayCheckOSC1)
 			{
+				PlotEnvelope("##Osc 1 Envelope", *OSC1Data, time_osc1, osc_control->OSC1Colour.Value);
 				ImPlot::SetNextLineStyle(osc_control->OSC1Colour.Value); // bugfixed: only set colour if line is being draw.
-				ImPlot::PlotLine("##Osc 1", time_osc1.data(), analog_data_osc1.data(),
-					analog_data_osc1.size());
+				if (OSC1Data->GetRollMode())
+					ImPlot::PlotLine("##Osc 1", OSC1Data->GetRollTraceTime().data(), OSC1Data->GetRollTraceData().data(),
+						(int)OSC1Data->GetRollTraceData().size());
+				else
+				{
+					const PlotTrace& trace = osc1_decimator.Update(time_osc1, analog_data_osc1, OSC1Data->GetDataGeneration(),
+						time_limits.X.Min, time_limits.X.Max, plot_columns, decimation);
+					ImPlot::PlotLine("##Osc 1", trace.x.data(), trace.y.data(), (int)trace.y.size());
+				}
 			}
 			// Set OscData Time Vector to match the current X-axis
 			OSC1Data->SetTime(ImPlot::GetPlotLimits().X.Min, ImPlot::GetPlotLimits().X.Max);
@@ -347,9 +375,17 @@ public:
 			std::vector<double> time_osc2 = OSC2Data->GetTime();
 			if (osc_control->DisplayCheckOSC2)
 			{
+				PlotEnvelope("##Osc 2 Envelope", *OSC2Data, time_osc2, osc_control->OSC2Colour.Value);
 				ImPlot::SetNextLineStyle(osc_control->OSC2Colour.Value);
-				ImPlot::PlotLine("##Osc 2", time_osc2.data(), analog_data_osc2.data(),
-					analog_data_osc2.size());
+				if (OSC2Data->GetRollMode())
+					ImPlot::PlotLine("##Osc 2", OSC2Data->GetRollTraceTime().data(), OSC2Data->GetRollTraceData().data(),
+						(int)OSC2Data->GetRollTraceData().size());
+				else
+				{
+					const PlotTrace& trace = osc2_decimator.Update(time_osc2, analog_data_osc2, OSC2Data->GetDataGeneration(),
+						time_limits.X.Min, time_limits.X.Max, plot_columns, decimation);
+					ImPlot::PlotLine("##Osc 2", trace.x.data(), trace.y.data(), (int)trace.y.size());
+				}
 			}
 			// Set OscData Time Vector to match the current X-axis
 			OSC2Data->SetTime(ImPlot::GetPlotLimits().X.Min, ImPlot::GetPlotLimits().X.Max);
@@ -369,38 +405,65 @@ public:
 					time_math[i] = x_min + (static_cast<double>(i) / static_cast<double>(num_points)) * (x_max - x_min);
 				}
 			}
-			std::string expr = osc_control->MathControls1.Text;
-			ParseStatus parse_status;
-
-			std::vector<double> math_data = EvalUserExpression(expr, analog_data_osc1, analog_data_osc2, time_math, parse_status);
-
-			if (parse_status.success) {
-				osc_control->MathControls1.Parsable = true;
-
-				if (osc_control->MathControls1.On) {
-					
+			math_texts.resize(MathEngine::MaxChannels);
+			for (int ch = 0; ch < MathEngine::MaxChannels; ++ch)
+				math_texts[ch] = osc_control->GetMathControls(ch).Text;
+
+			// all channels in one program, so the inputs are bound and copied once; skipped while
+			// the inputs are unchanged, so the results keep their generation
+			const MathInputs inputs = { OSC1Data->GetDataGeneration(), OSC2Data->GetDataGeneration(),
+				time_math.size(), time_math.empty() ? 0.0 : time_math.front(), time_math.empty() ? 0.0 : time_math.back() };
+			if (!(inputs == math_inputs) || math_texts != math_engine_texts)
+			{
+				math_engine.Evaluate(math_texts, analog_data_osc1, analog_data_osc2, time_math);
+				math_inputs = inputs;
+				math_engine_texts = math_texts;
+			}
 
-					// if result is empty or time base is empty, clear and bail
-					if (math_data.empty() || time_math.empty()) {
-						MathData->SetData({});                 // <<< clear stale MATH buffer
+			for (int ch = 0; ch < MathEngine::MaxChannels; ++ch)
+			{
+				OSCControl::MathControls& math = osc_control->GetMathControls(ch);
+				OscData& math_osc = MathData[ch];
+				const std::vector<double>& math_data = math_engine.Result(ch);
+				if (math_engine.Status(ch).success) {
+					math.Parsable = true;
+
+					if (math.On) {
+						// if result is empty or time base is empty, clear and bail
+						if (math_data.empty() || time_math.empty()) {
+							ClearMathData(ch);                    // <<< clear stale MATH buffer
+						}
+						else {
+							// update MathData only when the engine has a new result to show
+							if (math_shown[ch] != math_engine.Generation()) {
+								math_osc.SetTime(ImPlot::GetPlotLimits().X.Min, ImPlot::GetPlotLimits().X.Max, time_math);
+								math_osc.SetData(math_data);
+								math_shown[ch] = math_engine.Generation();
+							}
+							ImPlot::SetNextLineStyle(osc_control->MathColours[ch].Value);
+							const PlotTrace& trace = math_decimators[ch].Update(time_math, math_data, math_osc.GetDataGeneration(),
+								time_limits.X.Min, time_limits.X.Max, plot_columns, decimation);
+							char plot_label[16];
+							snprintf(plot_label, sizeof(plot_label), "##Math%d", ch + 1);
+							ImPlot::PlotLine(plot_label, trace.x.data(), trace.y.data(), (int)trace.y.size());
+						}
 					}
 					else {
-						// update MathData only when we actually have samples to show
-						MathData->SetTime(ImPlot::GetPlotLimits().X.Min, ImPlot::GetPlotLimits().X.Max, time_math);
-						MathData->SetData(math_data);
-						ImPlot::SetNextLineStyle(osc_control->MathColour.Value);
-						ImPlot::PlotLine("##Math", time_math.data(), math_data.data(), (int)math_data.size());
+						// toggle is OFF → clear any previous math samples
+						ClearMathData(ch);                        // <<< clear when OFF
 					}
 				}
 				else {
-					// toggle is OFF → clear any previous math samples
-					MathData->SetData({});                     // <<< clear when OFF
+					// parse failed → not parsable, clear any previous math samples
+					math.Parsable = false;
+					ClearMathData(ch);                            // <<< clear on parse failure
 				}
 			}
-			else {
-				// parse failed → not parsable, clear any previous math samples
-				osc_control->MathControls1.Parsable = false;
-				MathData->SetData({});                         // <<< clear on parse failure
+
+			// Segmented memory overlay / selected segment, aligned on the trigger marker
+			if (osc_control->GetSegmentView() != 0)
+			{
+				DrawSegments();
 			}
 
 			// Plot cursors
@@ -418,16 +481,93 @@ public:
 
 		// --- Spectrum Analyser ---
 		// Always-run acquisition (independent of visibility/tab)
+		bool spectrum_arrived = false;
 		if (analysis_tools_widget->SA.Acquire) {
-			const int   sr = analysis_tools_widget->SA.SampleRatesValues[analysis_tools_widget->SA.SampleRatesComboCurrentItem];
-			const float tw = analysis_tools_widget->SA.TimeWindow;
-			const int   widx = analysis_tools_widget->SA.WindowComboCurrentItem;
+			SpectrumRequest& r = spectrum_request;
+			r.sample_rate = analysis_tools_widget->SA.SampleRatesValues[analysis_tools_widget->SA.SampleRatesComboCurrentItem];
+			r.time_window = analysis_tools_widget->SA.TimeWindow;
+			r.window = analysis_tools_widget->SA.WindowComboCurrentItem;
+			r.zoom = analysis_tools_widget->IsZoom();
+			r.welch = analysis_tools_widget->IsWelch();
+			r.zoom_config = analysis_tools_widget->GetZoomConfig();
+			r.welch_config = analysis_tools_widget->GetWelchConfig();
+
+			FFTPlanCache::Instance().SetBackgroundMeasure(analysis_tools_widget->SA.OptimiseFFTPlans);
+
+			if (r.welch && OSC1Data->IsWelchStreaming()) {
+				// gated Welch: the average is already complete, just stop feeding it
+				OSC1Data->StopWelch();
+				OSC2Data->StopWelch();
+				OSC1Data->PublishWelch(true);
+				OSC2Data->PublishWelch(true);
+				spectrum_arrived = true;
+			}
+			else {
+				r.pending[0] = r.pending[1] = true;
+				analysis_tools_widget->SA.SpectrumBusy = true;
+			}
 
-			OSC1Data->PerformSpectrumAnalysis(sr, tw, widx);
-			OSC2Data->PerformSpectrumAnalysis(sr, tw, widx);
+			analysis_tools_widget->SA.OSC1_last_captured = r.time_window;
+			analysis_tools_widget->SA.OSC2_last_captured = r.time_window;
+		}
+		// A channel still computing the previous acquisition is retried every frame until its
+		// worker is free, rather than dropped; both channels transform concurrently
+		for (int ch = 0; ch < 2; ++ch) {
+			SpectrumRequest& r = spectrum_request;
+			if (!r.pending[ch]) continue;
+			OscData* osc = ch == 0 ? OSC1Data : OSC2Data;
+			const bool started = r.zoom ? osc->StartZoomAnalysis(r.sample_rate, r.time_window, r.zoom_config)
+				: r.welch ? osc->WelchFromRecord(r.welch_config, r.sample_rate, r.time_window)
+				: osc->StartSpectrumAnalysis(r.sample_rate, r.time_window, r.window);
+			r.pending[ch] = !started;
+		}
+		if (analysis_tools_widget->SA.SpectrumBusy) {
+			OSC1Data->CollectSpectrumAnalysis();
+			OSC2Data->CollectSpectrumAnalysis();
+			if (!spectrum_request.pending[0] && !spectrum_request.pending[1]
+				&& !OSC1Data->IsSpectrumBusy() && !OSC2Data->IsSpectrumBusy()) {
+				analysis_tools_widget->SA.SpectrumBusy = false;
+				spectrum_arrived = true;
+			}
+		}
+		if (spectrum_arrived) {
+			analysis_tools_widget->SA.OSC1ElapsedMs = OSC1Data->GetSpectrumElapsed() * 1e3;
+			analysis_tools_widget->SA.OSC2ElapsedMs = OSC2Data->GetSpectrumElapsed() * 1e3;
+		}
+		// Gated Welch: feed the stream into the average while acquiring and show it live
+		if (analysis_tools_widget->IsWelch() && analysis_tools_widget->SA.AcquisitionModeComboCurrentItem == 0
+			&& analysis_tools_widget->SA.AcquireState.acquiring) {
+			if (!OSC1Data->IsWelchStreaming()) {
+				const int sr = analysis_tools_widget->SA.SampleRatesValues[analysis_tools_widget->SA.SampleRatesComboCurrentItem];
+				const WelchSpectrum::Config cfg = analysis_tools_widget->GetWelchConfig();
+				OSC1Data->StartWelch(cfg, sr);
+				OSC2Data->StartWelch(cfg, sr);
+			}
+			OSC1Data->PublishWelch();
+			OSC2Data->PublishWelch();
+		}
+		else if (OSC1Data->IsWelchStreaming() && !analysis_tools_widget->SA.Acquire) {
+			// acquisition cancelled or method switched mid-way
+			OSC1Data->StopWelch();
+			OSC2Data->StopWelch();
+		}
+		if (analysis_tools_widget->IsWelch())
+			analysis_tools_widget->SA.WelchSegments = OSC1Data->GetWelchSegments();
+		if (analysis_tools_widget->SA.MetricsOn) {
+			// recomputed only when a spectrum is published
+			analysis_tools_widget->SA.OSC1Metrics = OSC1Data->GetSpectralMetrics();
+			analysis_tools_widget->SA.OSC2Metrics = OSC2Data->GetSpectralMetrics();
+		}
 
-			analysis_tools_widget->SA.OSC1_last_captured = tw;
-			analysis_tools_widget->SA.OSC2_last_captured = tw;
+		// Spectrogram of the selected channel runs only while its view is showing
+		{
+			const bool on = analysis_tools_widget->ToolsOn && analysis_tools_widget->CurrentTab == 0
+				&& analysis_tools_widget->SA.SpectrogramOn;
+			const int source = analysis_tools_widget->SA.SignalComboCurrentItem;
+			const int sr = analysis_tools_widget->SA.SampleRatesValues[analysis_tools_widget->SA.SampleRatesComboCurrentItem];
+			const Spectrogram::Config cfg = analysis_tools_widget->GetSpectrogramConfig();
+			OSC1Data->SetSpectrogram(on && source == 0, cfg, sr);
+			OSC2Data->SetSpectrogram(on && source == 1, cfg, sr);
 		}
 
 		// ---- Choose magnitude pointers by units (for both channels) ----
@@ -513,8 +653,11 @@ public:
 				else { constraint_mag_lower = magnitude_range.constraint_lower; constraint_mag_upper = magnitude_range.constraint_upper; }
 			}
 
+			if (analysis_tools_widget->SA.SpectrogramOn) {
+				DrawSpectrogram(plot_size_spectrum_magnitude, spectrum_base_plot_flags);
+			}
 			// Only do spectrum plotting if shared spectrum_plots has been wired up
-			if (spectrum_plots) {
+			else if (spectrum_plots) {
 				PlotTrace& spectrum_plot_data_osc1 = spectrum_plots->osc1;
 				PlotTrace& spectrum_plot_data_osc2 = spectrum_plots->osc2;
 
@@ -526,6 +669,7 @@ public:
 				static bool   prev_disp2 = analysis_tools_widget->SA.DisplayOSC2;
 				static size_t prev_n1 = 0, prev_n2 = 0;
 				static double prev_f1_last = 0.0, prev_f2_last = 0.0;
+				static uint64_t prev_gen1 = 0, prev_gen2 = 0;
 				static bool   first_plot = true;
 
 				// Data-change detector
@@ -534,6 +678,10 @@ public:
 					prev_n2 != (has2 ? f2->size() : 0) ||
 					prev_f1_last != (has1 ? f1->back() : 0.0) ||
 					prev_f2_last != (has2 ? f2->back() : 0.0);
+				// Same-shape rewrites (live Welch updates) re-decimate without refitting the axes
+				const bool data_updated =
+					prev_gen1 != OSC1Data->GetSpectrumGeneration() ||
+					prev_gen2 != OSC2Data->GetSpectrumGeneration();
 
 				if (ImPlot::BeginPlot("##SpectrumMagnitude", plot_size_spectrum_magnitude, spectrum_base_plot_flags)) {
 					ImPlot::SetupAxisFormat(ImAxis_X1, MetricFormatter, (void*)"Hz");
@@ -563,7 +711,7 @@ public:
 
 					if (first_plot ||
 						analysis_tools_widget->SA.Autofit ||
-						analysis_tools_widget->SA.Acquire ||
+						spectrum_arrived ||
 						data_changed ||
 						prev_units != analysis_tools_widget->SA.UnitsComboCurrentItem) {
 						ImPlot::SetupAxesLimits(combined_xmin, combined_xmax,
@@ -595,13 +743,13 @@ public:
 					// Re-decimate when needed (user zoom/pan or data change)
 					const bool must_redecimate =
 						analysis_tools_widget->SA.Autofit ||
-						analysis_tools_widget->SA.Acquire ||
+						spectrum_arrived ||
 						(prev_units != analysis_tools_widget->SA.UnitsComboCurrentItem) ||
 						(prev_disp1 != analysis_tools_widget->SA.DisplayOSC1) ||
 						(prev_disp2 != analysis_tools_widget->SA.DisplayOSC2) ||
 						(last_x_min != ImPlot::GetPlotLimits().X.Min) ||
 						(last_x_max != ImPlot::GetPlotLimits().X.Max) ||
-						data_changed;
+						data_changed || data_updated;
 
 					if (must_redecimate) {
 						if (has1)
@@ -623,6 +771,8 @@ public:
 						prev_n2 = has2 ? f2->size() : 0;
 						prev_f1_last = has1 ? f1->back() : 0.0;
 						prev_f2_last = has2 ? f2->back() : 0.0;
+						prev_gen1 = OSC1Data->GetSpectrumGeneration();
+						prev_gen2 = OSC2Data->GetSpectrumGeneration();
 					}
 
 					// Plot enabled channels
@@ -666,9 +816,13 @@ public:
 		
 		// Network Analyser
 		ImPlotFlags network_base_plot_flags = ImPlotFlags_NoFrame | ImPlotFlags_NoLegend | ImPlotFlags_NoMenus;
-		std::vector<double> na_freq;
-		std::vector<double> na_mag;
-		std::vector<double> na_phase;
+		// References into the analyser's own sorted results (or an empty stand-in), not copies
+		static const std::vector<double> na_none;
+		const std::vector<double>* na_freq_p = &na_none;
+		const std::vector<double>* na_mag_p = &na_none;
+		const std::vector<double>* na_phase_p = &na_none;
+		NetworkAnalyser::Extent na_mag_extent, na_phase_extent;
+		uint64_t na_generation = 0;
 		AxisLimitRanges network_magnitude_range = magnitude_db_range;
 		static double network_constraint_mag_lower = magnitude_db_range.constraint_lower;
 		static double network_constraint_mag_upper = magnitude_db_range.constraint_upper;
@@ -677,25 +831,27 @@ public:
 		static int Previous_NAC_UnitsComboCurrentItem = analysis_tools_widget->NA.UnitsComboCurrentItem;
 
 		if (na != nullptr) {
-			na_freq = na->freqs();      // Hz, must be > 0 for log scale
+			na_freq_p = &na->freqs();      // Hz, must be > 0 for log scale
 			switch (analysis_tools_widget->NA.UnitsComboCurrentItem)
 			{
 			case 0:
-				na_mag = na->mag_dB();
+				na_mag_p = &na->mag_dB();
+				na_mag_extent = na->mag_dB_extent();
 				network_magnitude_range = magnitude_db_range;
 				break;
 			case 1:
-				na_mag = na->mag_linear();
+				na_mag_p = &na->mag_linear();
+				na_mag_extent = na->mag_linear_extent();
 				network_magnitude_range = magnitude_VRMS_range;
 				break;
 			}
-			na_phase = na->phase_rad();  // radians
-		}
-		else {
-			na_freq.clear();
-			na_mag.clear();
-			na_phase.clear();
+			na_phase_p = &na->phase_rad();  // radians
+			na_phase_extent = na->phase_extent();
+			na_generation = na->generation();
 		}
+		const std::vector<double>& na_freq = *na_freq_p;
+		const std::vector<double>& na_mag = *na_mag_p;
+		const std::vector<double>& na_phase = *na_phase_p;
 
 		struct XTickBuf { std::vector<double> ticks; };
 		static XTickBuf g_na_xticks;
@@ -715,17 +871,17 @@ public:
 				if (analysis_tools_widget->NA.Autofit || na->running() || network_was_off ||
 					(Previous_NAC_UnitsComboCurrentItem != analysis_tools_widget->NA.UnitsComboCurrentItem))
 				{
-					if (!na_freq.empty() && !na_mag.empty()) {
-						double mag_max = *std::max_element(na_mag.begin(), na_mag.end());
-						double mag_min = *std::min_element(na_mag.begin(), na_mag.end());
+					if (!na_freq.empty() && !na_mag_extent.empty()) {
+						double mag_max = na_mag_extent.max;
+						double mag_min = na_mag_extent.min;
 						double mag_range = mag_max - mag_min;
 						double mag_frac = 0.9;
 						double pad = 0.5 * mag_range * (1 / mag_frac - 1);
 						pad = pad == 0 ? 1 : pad; // if flat line, add padding of 1
 						ImPlot::SetupAxesLimits(na_freq[0], na_freq.back(),
 							mag_min - pad, mag_max + pad, ImPlotCond_Always);
-						network_constraint_mag_lower = *std::min_element(na_mag.begin(), na_mag.end()) - 10;
-						network_constraint_mag_upper = *std::max_element(na_mag.begin(), na_mag.end()) + 10;
+						network_constraint_mag_lower = mag_min - 10;
+						network_constraint_mag_upper = mag_max + 10;
 					}
 					else
 					{
@@ -767,8 +923,8 @@ public:
 				ImPlot::SetNextLineStyle(GetPlotColour(Plot_Blue));
 
 				if (!na_freq.empty()) {
-					// Guard: log scale requires strictly positive x
-					bool x_ok = std::all_of(na_freq.begin(), na_freq.end(), [](double f) { return f > 0; });
+					// Guard: log scale requires strictly positive x (sorted, so the first decides)
+					bool x_ok = na_freq.front() > 0;
 					if (x_ok) {
 						ImPlot::PlotLine("S-Param |Mag| (dB)", na_freq.data(), na_mag.data(), (int)na_freq.size());
 					}
@@ -801,9 +957,9 @@ public:
 					if (analysis_tools_widget->NA.Autofit || na->running() || network_was_off ||
 						(Previous_NAC_UnitsComboCurrentItem != analysis_tools_widget->NA.UnitsComboCurrentItem))
 					{
-						if (!na_freq.empty() && !na_phase.empty()) {
-							double phase_max = *std::max_element(na_phase.begin(), na_phase.end());
-							double phase_min = *std::min_element(na_phase.begin(), na_phase.end());
+						if (!na_freq.empty() && !na_phase_extent.empty()) {
+							double phase_max = na_phase_extent.max;
+							double phase_min = na_phase_extent.min;
 							double phase_range = phase_max - phase_min;
 							double phase_frac = 0.9;
 							double pad = 0.5 * phase_range * (1 / phase_frac - 1);
@@ -843,7 +999,7 @@ public:
 					ImPlot::SetNextLineStyle(GetPlotColour(Plot_Red));
 
 					if (!na_freq.empty()) {
-						bool x_ok = std::all_of(na_freq.begin(), na_freq.end(), [](double f) { return f > 0; });
+						bool x_ok = na_freq.front() > 0;
 						if (x_ok) {
 							ImPlot::PlotLine("angle(S) (rad)", na_freq.data(), na_phase.data(), (int)na_freq.size());
 						}
@@ -872,9 +1028,16 @@ public:
 		{
 			network_was_off = true;
 		}
-		network_plots->freq = na_freq;
-		network_plots->mag = na_mag;
-		network_plots->phase = na_phase;
+		// Export copy, refreshed only when the results or the units change
+		if (network_plots->generation != na_generation ||
+			network_plots->units != analysis_tools_widget->NA.UnitsComboCurrentItem)
+		{
+			network_plots->freq = na_freq;
+			network_plots->mag = na_mag;
+			network_plots->phase = na_phase;
+			network_plots->generation = na_generation;
+			network_plots->units = analysis_tools_widget->NA.UnitsComboCurrentItem;
+		}
 
 
 		
@@ -910,18 +1073,18 @@ public:
 		if (osc_control->SignalPropertiesToggle)
 		{
 			DrawSignalPropertiesPanel(
-				std::vector<OscData>{ *OSC1Data, *OSC2Data, *MathData },
+				std::vector<const OscData*>{ OSC1Data, OSC2Data, &MathData[0], &MathData[1], &MathData[2], &MathData[3] },
 				std::vector<ImVec4>{
 				osc_control->OSC1Colour.Value,
 					osc_control->OSC2Colour.Value,
-					osc_control->MathColour.Value
+					osc_control->MathColours[0].Value,
+					osc_control->MathColours[1].Value,
+					osc_control->MathColours[2].Value,
+					osc_control->MathColours[3].Value
 			}
 			);
 		}
 		ImGui::PopStyleColor();
-
-		OSC1Data->GetPeriod();
-
 	}
 	// ===== Helpers =====
 	static inline bool valid_num(double x) { return std::isfinite(x); }
@@ -946,14 +1109,14 @@ public:
 	}
 
 	// ===== Panel =====
-	void DrawSignalPropertiesPanel(const std::vector<OscData>& signals_in,
+	void DrawSignalPropertiesPanel(const std::vector<const OscData*>& signals_in,
 		const std::vector<ImVec4>& colors_in)
 	{
 		ImGui::PushID(&signals_in);
 
 		// -------------------- 0) Build filtered rows (OSC1/OSC2 by toggles, MATH only if valid) --------------------
 		struct Row { const OscData* s; ImVec4 color; std::string name; };
-		std::vector<Row> rows; rows.reserve(3);
+		std::vector<Row> rows; rows.reserve(signals_in.size());
 
 		auto has_nonempty_signal = [](const OscData& s)->bool {
 			// Heuristic “has data” check; swap for s.HasSamples() if you have it.
@@ -961,22 +1124,24 @@ public:
 				std::isfinite(s.GetVmax()) || std::isfinite(s.GetVmin());
 		};
 
-		// Expecting signals_in = { OSC1, OSC2, MATH } in this order
+		// Expecting signals_in = { OSC1, OSC2, MATH1, MATH2, ... } in this order
 		// Guard for size but handle gracefully
-		const OscData* s1 = (signals_in.size() > 0) ? &signals_in[0] : nullptr;
-		const OscData* s2 = (signals_in.size() > 1) ? &signals_in[1] : nullptr;
-		const OscData* sm = (signals_in.size() > 2) ? &signals_in[2] : nullptr;
+		const OscData* s1 = (signals_in.size() > 0) ? signals_in[0] : nullptr;
+		const OscData* s2 = (signals_in.size() > 1) ? signals_in[1] : nullptr;
 
 		ImVec4 c1 = (colors_in.size() > 0) ? colors_in[0] : ImGui::GetStyleColorVec4(ImGuiCol_Text);
 		ImVec4 c2 = (colors_in.size() > 1) ? colors_in[1] : ImGui::GetStyleColorVec4(ImGuiCol_Text);
-		ImVec4 cm = (colors_in.size() > 2) ? colors_in[2] : ImGui::GetStyleColorVec4(ImGuiCol_Text);
 
 		// Include OSC1/OSC2 only if their display toggles are on
 		if (s1 && osc_control->DisplayCheckOSC1) rows.push_back(Row{ s1, c1, "OSC1" });
 		if (s2 && osc_control->DisplayCheckOSC2) rows.push_back(Row{ s2, c2, "OSC2" });
 
-		// Include MATH only if it has a valid/non-empty signal
-		if (sm && has_nonempty_signal(*sm))      rows.push_back(Row{ sm, cm, "MATH" });
+		// Include MATH channels only if they have a valid/non-empty signal
+		for (size_t i = 2; i < signals_in.size(); ++i) {
+			const OscData* sm = signals_in[i];
+			ImVec4 cm = (colors_in.size() > i) ? colors_in[i] : ImGui::GetStyleColorVec4(ImGuiCol_Text);
+			if (sm && has_nonempty_signal(*sm)) rows.push_back(Row{ sm, cm, "MATH" + std::to_string(i - 1) });
+		}
 
 		const int ROWS = (int)rows.size();
 		const ImGuiStyle& st = ImGui::GetStyle();
@@ -994,14 +1159,15 @@ public:
 			ImGui::SetNextItemOpen(true, ImGuiCond_Once);
 			if (ImGui::CollapsingHeader("Signal Properties##sigprops", ImGuiTreeNodeFlags_DefaultOpen)) {
 
-				enum ColID { C_CH = 0, C_T, C_F, C_VPP, C_VMAX, C_VMIN, C_VAVG, C_VRMS, C__COUNT };
-				const char* L[C__COUNT] = { "Ch","Period (ms)","Freq (Hz)","Vpp (V)","Vmax (V)","Vmin (V)","Vavg (V)","Vrms (V)" };
-				const float W_FULL[C__COUNT] = { 44, 88, 88, 78, 78, 78, 78, 78 };
-				const float W_MIN[C__COUNT] = { 44, 12, 12, 12, 12, 12, 12, 12 }; // tight collapsed widths
+				enum ColID { C_CH = 0, C_T, C_F, C_VPP, C_VMAX, C_VMIN, C_VAVG, C_VRMS, C_DUTY, C_RISE, C_FALL, C__COUNT };
+				const char* L[C__COUNT] = { "Ch","Period (ms)","Freq (Hz)","Vpp (V)","Vmax (V)","Vmin (V)","Vavg (V)","Vrms (V)",
+					"Duty (%)",u8"Rise (\u00B5s)",u8"Fall (\u00B5s)" };
+				const float W_FULL[C__COUNT] = { 44, 88, 88, 78, 78, 78, 78, 78, 78, 78, 78 };
+				const float W_MIN[C__COUNT] = { 44, 12, 12, 12, 12, 12, 12, 12, 12, 12, 12 }; // tight collapsed widths
 
-				static bool userCollapsed[C__COUNT] = { false,false,false,false,false,false,false,false };
+				static bool userCollapsed[C__COUNT] = { false,false,false,false,false,false,false,false,false,false,false };
 				userCollapsed[C_CH] = false; // Channel never collapses
-				bool autoCollapsed[C__COUNT] = { false,false,false,false,false,false,false,false };
+				bool autoCollapsed[C__COUNT] = { false,false,false,false,false,false,false,false,false,false,false };
 
 				std::vector<float> colW(C__COUNT);
 				for (int c = 0; c < C__COUNT; ++c)
@@ -1055,22 +1221,23 @@ public:
 					}
 					else {
 						for (int r = 0; r < ROWS; ++r) {
-							const OscData& s = *rows[r].s;
+							const SignalMeasurements& m = rows[r].s->GetMeasurements();
 							ImGui::TableNextRow();
 
 							ImGui::TableSetColumnIndex(C_CH);
 							ImGui::TextColored(rows[r].color, "%s", rows[r].name.c_str());
 
-							double T = s.GetPeriod();
-							double f = (std::isfinite(T) && T > 0.0) ? 1.0 / T : std::numeric_limits<double>::quiet_NaN();
-							ImGui::TableSetColumnIndex(C_T);   ValueCellOrDash(std::isfinite(T) ? (1000.0 * T) : T, "%.1f");
-							ImGui::TableSetColumnIndex(C_F);   ValueCellOrDash(f, "%.1f");
-
-							ImGui::TableSetColumnIndex(C_VPP);  ValueCellOrDash(s.GetVpp(), "%.2f");
-							ImGui::TableSetColumnIndex(C_VMAX); ValueCellOrDash(s.GetVmax(), "%.2f");
-							ImGui::TableSetColumnIndex(C_VMIN); ValueCellOrDash(s.GetVmin(), "%.2f");
-							ImGui::TableSetColumnIndex(C_VAVG); ValueCellOrDash(s.GetVavg(), "%.2f");
-							ImGui::TableSetColumnIndex(C_VRMS); ValueCellOrDash(s.GetVrms(), "%.2f");
+							ImGui::TableSetColumnIndex(C_T);   ValueCellOrDash(1000.0 * m.period, "%.1f");
+							ImGui::TableSetColumnIndex(C_F);   ValueCellOrDash(m.frequency, "%.1f");
+
+							ImGui::TableSetColumnIndex(C_VPP);  ValueCellOrDash(m.vpp, "%.2f");
+							ImGui::TableSetColumnIndex(C_VMAX); ValueCellOrDash(m.vmax, "%.2f");
+							ImGui::TableSetColumnIndex(C_VMIN); ValueCellOrDash(m.vmin, "%.2f");
+							ImGui::TableSetColumnIndex(C_VAVG); ValueCellOrDash(m.vavg, "%.2f");
+							ImGui::TableSetColumnIndex(C_VRMS); ValueCellOrDash(m.vrms, "%.2f");
+							ImGui::TableSetColumnIndex(C_DUTY); ValueCellOrDash(100.0 * m.duty, "%.1f");
+							ImGui::TableSetColumnIndex(C_RISE); ValueCellOrDash(1e6 * m.rise_time, "%.1f");
+							ImGui::TableSetColumnIndex(C_FALL); ValueCellOrDash(1e6 * m.fall_time, "%.1f");
 						}
 					}
 
@@ -1090,6 +1257,20 @@ public:
 			for (int i = 0; i < ROWS; ++i)
 				phi[i] = rows[i].s->GetPhaseDeg();
 
+			// Pairwise phase from a joint projection at a common frequency (ref row's), falling back
+			// to the other channel as reference, then to the difference of absolute phases.
+			std::vector<double> rel(ROWS * ROWS, std::numeric_limits<double>::quiet_NaN());
+			for (int i = 0; i < ROWS; ++i) {
+				rel[i * ROWS + i] = 0.0;
+				for (int j = i + 1; j < ROWS; ++j) {
+					double d = rows[i].s->GetRelativePhaseDeg(*rows[j].s);
+					if (!std::isfinite(d)) d = -rows[j].s->GetRelativePhaseDeg(*rows[i].s);
+					if (!std::isfinite(d) && std::isfinite(phi[i]) && std::isfinite(phi[j])) d = wrap_deg(phi[j] - phi[i]);
+					rel[i * ROWS + j] = d;
+					rel[j * ROWS + i] = std::isfinite(d) ? wrap_deg(-d) : d;
+				}
+			}
+
 			bool any_pair = false;
 			for (int i = 0; i < ROWS && !any_pair; ++i)
 				for (int j = 0; j < ROWS && !any_pair; ++j)
@@ -1162,13 +1343,6 @@ public:
 							ImGui::SetTooltip((effCollapsed || autoCollapsed[c]) ? "Click to expand" : "Click to collapse");
 					}
 
-					auto wrap_deg = [](double a)->double {
-						if (!std::isfinite(a)) return a;
-						a = std::fmod(a + 180.0, 360.0);
-						if (a < 0) a += 360.0;
-						return a - 180.0;
-					};
-
 					for (int i = 0; i < ROWS; ++i) {
 						ImGui::TableNextRow();
 						ImGui::TableSetColumnIndex(0);
@@ -1176,13 +1350,7 @@ public:
 
 						for (int j = 0; j < ROWS; ++j) {
 							ImGui::TableSetColumnIndex(j + 1);
-							double val;
-							if (i == j) val = 0.0;
-							else if (std::isfinite(phi[i]) && std::isfinite(phi[j]))
-								val = wrap_deg(phi[j] - phi[i]);
-							else
-								val = std::numeric_limits<double>::quiet_NaN();
-							ValueCellOrDash(val, "%.1f");
+							ValueCellOrDash(rel[i * ROWS + j], "%.1f");
 						}
 					}
 
@@ -1236,32 +1404,50 @@ public:
 		// sets the time that the trigger on the plot will trigger (basically the time where the trigger marker on the plot is; defaults at 0)
 		OSC1Data->SetTriggerTimePlot(trigger_time_plot);
 		OSC2Data->SetTriggerTimePlot(trigger_time_plot);
-		// sets the entire vector which will be used to plot (including part cut off due to trigger)
-		OSC1Data->SetExtendedData();
-		OSC2Data->SetExtendedData();
+		// feeds the continuous stream consumers (auto gain mini buffer, segmented memory, Welch,
+		// spectrogram); pausing only freezes the scope display
+		OSC1Data->PumpStream();
+		OSC2Data->PumpStream();
+		// roll mode builds the display from the stream pump alone, skipping the full-window re-read
+		OSC1Data->SetRollMode(osc_control->RollModeToggle);
+		OSC2Data->SetRollMode(osc_control->RollModeToggle);
 		constants::Channel trigger_channel = maps::ComboItemToChannelTriggerPair.at(osc_control->TriggerTypeComboCurrentItem).channel;
 		constants::TriggerType trigger_type = maps::ComboItemToChannelTriggerPair.at(osc_control->TriggerTypeComboCurrentItem).trigger_type;
-		// calculates the time that the trigger occurs in the extended_data vector depending on which channel is triggering
-		double trigger_time = 0;
-		// sets trigger variable for each osc (this is a bit hacky but whatever)
-		OSC1Data->SetTriggerOn(osc_control->Trigger);
-		OSC2Data->SetTriggerOn(osc_control->Trigger);
-		if (trigger_channel == constants::Channel::OSC1)
+		if (osc_control->RollModeToggle)
 		{
-			trigger_time = OSC1Data->GetTriggerTime(osc_control->Trigger, trigger_type,
-				osc_control->TriggerLevel.getValue(), osc_control->TriggerHysteresis);
+			OSC1Data->UpdateRoll(plot_columns);
+			OSC2Data->UpdateRoll(plot_columns);
 		}
-		if (trigger_channel == constants::Channel::OSC2)
+		else
 		{
-			trigger_time = OSC2Data->GetTriggerTime(osc_control->Trigger, trigger_type,
-				osc_control->TriggerLevel.getValue(), osc_control->TriggerHysteresis);
-		}
-		// sets the trigger time for both oscs
-		OSC1Data->SetTriggerTime(trigger_time);
-		OSC2Data->SetTriggerTime(trigger_time);
-		// sets the data vector that will be plotted
-		OSC1Data->SetData();
-		OSC2Data->SetData();
+			// sets the entire vector which will be used to plot (including part cut off due to trigger)
+			OSC1Data->SetExtendedData();
+			OSC2Data->SetExtendedData();
+			// calculates the time that the trigger occurs in the extended_data vector depending on which channel is triggering
+			double trigger_time = 0;
+			// sets trigger variable for each osc (this is a bit hacky but whatever)
+			OSC1Data->SetTriggerOn(osc_control->Trigger);
+			OSC2Data->SetTriggerOn(osc_control->Trigger);
+			if (trigger_channel == constants::Channel::OSC1)
+			{
+				trigger_time = OSC1Data->GetTriggerTime(osc_control->Trigger, trigger_type,
+					osc_control->TriggerLevel.getValue(), osc_control->TriggerHysteresis);
+			}
+			if (trigger_channel == constants::Channel::OSC2)
+			{
+				trigger_time = OSC2Data->GetTriggerTime(osc_control->Trigger, trigger_type,
+					osc_control->TriggerLevel.getValue(), osc_control->TriggerHysteresis);
+			}
+			// sets the trigger time for both oscs
+			OSC1Data->SetTriggerTime(trigger_time);
+			OSC2Data->SetTriggerTime(trigger_time);
+			// combines successive triggered frames (averaging / envelope) inside SetData
+			OSC1Data->SetAcquireMode(osc_control->GetAcquireMode(), osc_control->GetAverageCount());
+			OSC2Data->SetAcquireMode(osc_control->GetAcquireMode(), osc_control->GetAverageCount());
+			// sets the data vector that will be plotted
+			OSC1Data->SetData();
+			OSC2Data->SetData();
+		}
 		// sets the data vector used for analysis (FFT, period, Vpp etc; quite large)
 		OSC1Data->SetRawData();
 		OSC2Data->SetRawData();
@@ -1591,6 +1777,9 @@ public:
 		{
 			librador_set_oscilloscope_gain(1 << currentLabOscGain);
 			last_update_frame = frame;
+			// frames taken at the old gain (possibly clipped) must not leak into averages
+			OSC1Data->ResetAccumulation();
+			OSC2Data->ResetAccumulation();
 #ifndef NDEBUG
 			printf("Frame: %03d, gain: %02d\n", frame, 1 << currentLabOscGain);
 #endif
@@ -1698,6 +1887,197 @@ protected:
 	bool spectrum_was_off = true;
 	bool network_was_off = true;
 	
+	/// <summary>
+	/// Shades the min/max envelope of a channel when it is in Envelope acquire mode.
+	/// </summary>
+	static void PlotEnvelope(const char* label_id, const OscData& osc, const std::vector<double>& time, ImVec4 colour)
+	{
+		if (osc.GetAcquireMode() != OscData::AcquireMode::Envelope)
+			return;
+		const std::vector<double>& lo = osc.GetEnvelopeMin();
+		const std::vector<double>& hi = osc.GetEnvelopeMax();
+		if (lo.size() != time.size() || hi.size() != time.size() || time.empty())
+			return;
+		ImPlot::SetNextFillStyle(colour, 0.3f);
+		ImPlot::PlotShaded(label_id, time.data(), lo.data(), hi.data(), (int)time.size());
+	}
+
+	// Width of the time plot in pixels (roll mode uses the previous frame's value)
+	int plot_columns = 1000;
+	// Decimated copies of the time-domain traces
+	TraceDecimator osc1_decimator;
+	TraceDecimator osc2_decimator;
+	TraceDecimator math_decimators[MathEngine::MaxChannels];
+	// Spectrum acquisition as requested, and the channels that have yet to start it
+	struct SpectrumRequest
+	{
+		int sample_rate = 375000;
+		double time_window = 1;
+		int window = 0;
+		bool zoom = false;
+		bool welch = false;
+		ZoomSpectrum::Config zoom_config;
+		WelchSpectrum::Config welch_config;
+		bool pending[2] = { false, false };
+	};
+	SpectrumRequest spectrum_request;
+	// Compiled math channel expression, rebuilt only when its text changes or its length grows
+	MathEngine math_engine;
+	std::vector<std::string> math_texts;
+	// What the engine last evaluated, and the engine generation each MathData holds
+	struct MathInputs
+	{
+		uint64_t osc1_generation = UINT64_MAX, osc2_generation = UINT64_MAX;
+		size_t samples = 0;
+		double t_first = 0, t_last = 0;
+		bool operator==(const MathInputs& o) const
+		{
+			return osc1_generation == o.osc1_generation && osc2_generation == o.osc2_generation
+				&& samples == o.samples && t_first == o.t_first && t_last == o.t_last;
+		}
+	};
+	MathInputs math_inputs;
+	std::vector<std::string> math_engine_texts;
+	uint64_t math_shown[MathEngine::MaxChannels] = {};
+
+	// Empties a math channel's data, only if it holds any, so its generation stays put
+	void ClearMathData(int ch)
+	{
+		if (!MathData[ch].GetDataRef().empty())
+			MathData[ch].SetData({});
+		math_shown[ch] = 0;
+	}
+
+	// Persistence (digital phosphor) display
+	PersistenceMap osc1_persistence;
+	PersistenceMap osc2_persistence;
+	bool persistence_was_on = false;
+
+	/// <summary>
+	/// Rasterizes any new OSC1/OSC2 waveforms into their persistence maps and draws them as
+	/// heatmaps. Must be called between BeginPlot and EndPlot.
+	/// </summary>
+	void DrawPersistenceMaps()
+	{
+		const ImPlotRect lim = ImPlot::GetPlotLimits();
+		const ImVec2 px = ImPlot::GetPlotSize();
+		// roughly 2 px per cell, capped to keep the heatmap draw cheap
+		const int cols = std::clamp((int)(px.x / 2), 16, 512);
+		const int rows = std::clamp((int)(px.y / 2), 16, 256);
+		const double decay_s = osc_control->GetPersistenceDecaySeconds();
+
+		struct Channel { PersistenceMap* map; OscData* data; bool visible; ImVec4 colour; const char* id; };
+		const Channel channels[2] = {
+			{ &osc1_persistence, OSC1Data, osc_control->DisplayCheckOSC1, osc_control->OSC1Colour.Value, "##Persistence1" },
+			{ &osc2_persistence, OSC2Data, osc_control->DisplayCheckOSC2, osc_control->OSC2Colour.Value, "##Persistence2" },
+		};
+		for (const Channel& ch : channels)
+		{
+			ch.map->SetDecay(decay_s);
+			ch.map->Configure(cols, rows, lim.X.Min, lim.X.Max, lim.Y.Min, lim.Y.Max);
+			if (!ch.visible)
+				continue;
+			ch.map->Accumulate(ch.data->GetTimeRef(), ch.data->GetDataRef(), ch.data->GetDataGeneration());
+			ch.map->Plot(ch.id, PersistenceColormap(ch.id, ch.colour));
+		}
+	}
+
+	// Segmented memory display
+	PersistenceMap segment_overlay;
+	const SegmentedMemory* segment_overlay_source = nullptr;
+	size_t segment_overlay_count = 0;
+	std::vector<double> segment_time, segment_volts;
+
+	/// <summary>
+	/// Draws captured segments of the segmented memory source channel. Overlay mode rasterizes
+	/// every segment into a persistence map (incrementally, a bounded number per frame); the
+	/// selected segment is drawn on top as a line.
+	/// </summary>
+	void DrawSegments()
+	{
+		const SegmentedMemory& seg = osc_control->GetSegmentSource()->GetSegments();
+		const size_t count = seg.Count();
+		if (count == 0)
+			return;
+		const ImVec4 colour = osc_control->GetSegmentSourceColour().Value;
+		// one colormap per source: PersistenceColormap keeps the colour a name was first registered with
+		const char* overlay_id = (osc_control->GetSegmentSource() == OSC1Data) ? "##SegmentOverlay1" : "##SegmentOverlay2";
+
+		if (osc_control->GetSegmentView() == 2)
+		{
+			const ImPlotRect lim = ImPlot::GetPlotLimits();
+			const ImVec2 px = ImPlot::GetPlotSize();
+			segment_overlay.SetDecay(0.0);
+			const bool cleared = segment_overlay.Configure(std::clamp((int)(px.x / 2), 16, 512), std::clamp((int)(px.y / 2), 16, 256),
+				lim.X.Min, lim.X.Max, lim.Y.Min, lim.Y.Max);
+			if (cleared || &seg != segment_overlay_source || count < segment_overlay_count)
+			{
+				if (!cleared) segment_overlay.Clear();
+				segment_overlay_source = &seg;
+				segment_overlay_count = 0;
+			}
+			// bounded work per frame so a large capture fills in over a few frames
+			const size_t budget = 2000;
+			const size_t end = std::min(count, segment_overlay_count + budget);
+			for (size_t i = segment_overlay_count; i < end; ++i)
+			{
+				seg.Decode(i, segment_time, segment_volts);
+				for (double& t : segment_time) t += trigger_time_plot;
+				segment_overlay.Accumulate(segment_time, segment_volts, (uint64_t)i);
+			}
+			segment_overlay_count = end;
+			segment_overlay.Plot(overlay_id, PersistenceColormap(overlay_id, colour));
+		}
+
+		const size_t sel = (size_t)std::clamp(osc_control->SegmentSelected, 0, (int)count - 1);
+		seg.Decode(sel, segment_time, segment_volts);
+		for (double& t : segment_time) t += trigger_time_plot;
+		ImPlot::SetNextLineStyle(ImVec4(1, 1, 1, 0.9f));
+		ImPlot::PlotLine("##SegmentSelected", segment_time.data(), segment_volts.data(), (int)segment_time.size());
+	}
+
+	/// <summary>
+	/// Transparent -> channel colour -> white colormap, registered with ImPlot on first use.
+	/// </summary>
+	static ImPlotColormap PersistenceColormap(const char* name, ImVec4 colour)
+	{
+		ImPlotColormap cmap = ImPlot::GetColormapIndex(name);
+		if (cmap != -1)
+			return cmap;
+		const ImVec4 keys[5] = {
+			ImVec4(colour.x, colour.y, colour.z, 0.0f),
+			ImVec4(colour.x, colour.y, colour.z, 0.35f),
+			ImVec4(colour.x, colour.y, colour.z, 0.7f),
+			ImVec4(colour.x, colour.y, colour.z, 1.0f),
+			ImVec4(1.0f, 1.0f, 1.0f, 1.0f),
+		};
+		return ImPlot::AddColormap(name, keys, 5, false);
+	}
+
+	// Waterfall of the selected channel: frequency across, time (seconds ago) down
+	void DrawSpectrogram(const ImVec2& size, ImPlotFlags flags)
+	{
+		OscData* source = (analysis_tools_widget->SA.SignalComboCurrentItem == 0) ? OSC1Data : OSC2Data;
+		Spectrogram& sg = source->GetSpectrogram();
+		if (!sg.IsRunning()) return;
+		const double history = sg.GetConfig().rows * sg.RowSeconds();
+		// refit when the geometry changes or on Auto Fit
+		const bool refit = analysis_tools_widget->SA.Autofit || sg.MaxFrequency() != spectrogram_fit_f
+			|| history != spectrogram_fit_t;
+		spectrogram_fit_f = sg.MaxFrequency();
+		spectrogram_fit_t = history;
+		if (ImPlot::BeginPlot("##Spectrogram", size, flags)) {
+			ImPlot::SetupAxes("Frequency (Hz)", "Time (s)", ImPlotAxisFlags_NoLabel, ImPlotAxisFlags_NoLabel);
+			ImPlot::SetupAxisFormat(ImAxis_X1, MetricFormatter, (void*)"Hz");
+			ImPlot::SetupAxisFormat(ImAxis_Y1, MetricFormatter, (void*)"s");
+			ImPlot::SetupAxesLimits(0.0, spectrogram_fit_f, -history, 0.0, refit ? ImGuiCond_Always : ImGuiCond_Once);
+			sg.Plot("##SpectrogramImage", analysis_tools_widget->SA.SpectrogramMinDb, analysis_tools_widget->SA.SpectrogramMaxDb);
+			ImPlot::EndPlot();
+		}
+	}
+	double spectrogram_fit_f = 0.0;
+	double spectrogram_fit_t = 0.0;
+
 	PlotTrace DecimateLogPlotTrace(const std::vector<double>& x,
 		const std::vector<double>& y)
 	{
@@ -0,0 +1,128 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+/// <summary>
+/// Strip-chart display buffer for roll mode. Incoming samples are folded straight into a ring of
+/// fixed-width columns (one per plot pixel column) keeping min, max and mean, so the per-frame cost
+/// is proportional to the number of new samples plus the number of columns, independent of how
+/// long the displayed window is.
+/// </summary>
+class RollBuffer
+{
+public:
+	/// <summary>
+	/// Sizes the ring for `window_s` seconds shown over `columns` columns. Returns true (and clears
+	/// the ring) if the geometry changed.
+	/// </summary>
+	bool Configure(double window_s, int columns, double sample_rate)
+	{
+		columns = std::max(columns, 2);
+		const int64_t spc = std::max<int64_t>(1, (int64_t)std::llround(window_s * sample_rate / columns));
+		if (columns == (int)col_min.size() && spc == samples_per_column && sample_rate == fs)
+			return false;
+		fs = sample_rate;
+		samples_per_column = spc;
+		col_min.assign(columns, 0.0f);
+		col_max.assign(columns, 0.0f);
+		col_sum.assign(columns, 0.0);
+		col_count.assign(columns, 0);
+		Clear();
+		return true;
+	}
+
+	void Clear()
+	{
+		head = 0;
+		filled = 0;
+		in_column = 0;
+	}
+
+	/// <summary>
+	/// Appends samples, oldest first. `weight` is the number of full-rate samples each one stands
+	/// for (greater than 1 when refilling from a decimated read).
+	/// </summary>
+	void Append(const double* x, size_t n, int64_t weight = 1)
+	{
+		if (col_min.empty()) return;
+		const size_t C = col_min.size();
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (in_column >= samples_per_column)
+			{
+				// current column complete: move on to a fresh one, dropping the oldest if full
+				head = (head + 1) % C;
+				filled = std::min(filled + 1, C - 1);
+				in_column = 0;
+			}
+			const float v = (float)x[i];
+			if (in_column == 0)
+			{
+				col_min[head] = v;
+				col_max[head] = v;
+				col_sum[head] = 0.0;
+				col_count[head] = 0;
+			}
+			else
+			{
+				col_min[head] = std::min(col_min[head], v);
+				col_max[head] = std::max(col_max[head], v);
+			}
+			col_sum[head] += x[i];
+			col_count[head]++;
+			in_column += weight;
+		}
+	}
+
+	/// <summary>
+	/// Seconds covered by one column.
+	/// </summary>
+	double ColumnSeconds() const { return samples_per_column / fs; }
+
+	/// <summary>
+	/// Writes the display trace with the newest sample at t_end: an interleaved min/max polyline
+	/// (two points per column) for drawing, and the column means with their centre times for
+	/// measurements. Oldest column first.
+	/// </summary>
+	void Build(double t_end, std::vector<double>& trace_time, std::vector<double>& trace_volts,
+		std::vector<double>& mean_time, std::vector<double>& mean_volts) const
+	{
+		const size_t C = col_min.size();
+		const size_t n = (in_column > 0) ? filled + 1 : filled; // include the column being filled
+		trace_time.resize(2 * n);
+		trace_volts.resize(2 * n);
+		mean_time.resize(n);
+		mean_volts.resize(n);
+		if (n == 0) return;
+		const double dt_col = ColumnSeconds();
+		const double t_head_end = t_end; // right edge of the newest (possibly partial) column
+		const double t_head_start = t_end - (double)std::min(in_column, samples_per_column) / fs;
+		size_t idx = (head + C - (n - 1)) % C;
+		for (size_t k = 0; k < n; ++k, idx = (idx + 1) % C)
+		{
+			const size_t age = n - 1 - k; // 0 for the newest column
+			const double t0 = (age == 0) ? t_head_start : t_head_start - age * dt_col;
+			const double t1 = (age == 0) ? t_head_end : t0 + dt_col;
+			// alternate the order so the polyline zig-zags instead of drawing diagonals
+			const bool flip = (k & 1) != 0;
+			trace_time[2 * k] = t0;
+			trace_time[2 * k + 1] = t1;
+			trace_volts[2 * k] = flip ? col_max[idx] : col_min[idx];
+			trace_volts[2 * k + 1] = flip ? col_min[idx] : col_max[idx];
+			mean_time[k] = 0.5 * (t0 + t1);
+			mean_volts[k] = col_sum[idx] / (double)std::max<int64_t>(col_count[idx], 1);
+		}
+	}
+
+private:
+	std::vector<float> col_min, col_max;
+	std::vector<double> col_sum;
+	std::vector<int64_t> col_count;
+	int64_t samples_per_column = 1;
+	double fs = 375000;
+	size_t head = 0;      // column currently being filled
+	size_t filled = 0;    // complete columns behind head
+	int64_t in_column = 0; // samples in the head column
+};
@@ -4,6 +4,7 @@
 #include "implot.h"
 #include "util.h"
 #include "SignalType.hpp"
+#include "LibradorRead.hpp"
 
 /// <summary>Signal Generator Widget
 /// </summary>
@@ -43,12 +44,17 @@ public:
 	void renderControl() override
 	{
 		ImGui::Dummy(ImVec2(0.0f, 5.0f)); // add space
+		if (held)
+		{
+			ImGui::TextDisabled("In use by the network analyser sweep");
+			ImGui::BeginDisabled();
+		}
 		ImGui::Text("Power");
 		ImGui::SameLine();
 		ImGui::Text("   OFF");
 		ImGui::SameLine();
 		switched
-		    = ToggleSwitch((label + "_toggle").c_str(), &active, colourConvert(accentColour));
+		    |= ToggleSwitch((label + "_toggle").c_str(), &active, colourConvert(accentColour));
 		ImGui::SameLine();
 		ImGui::Text("ON");
 		
@@ -68,6 +74,18 @@ public:
 			ImGui::SetTooltip(
 			    "Increase Power Supply voltage to\nprevent clipping on signal generator.");
 		}
+		if (held) ImGui::EndDisabled();
+	}
+
+	/// <summary>
+	/// Hands the generator to the network analyser while its sweep drives this channel. Nothing
+	/// is sent while held; on release the widget's settings are sent again, since the sweep left
+	/// its last stimulus on the output.
+	/// </summary>
+	void setHeld(bool hold)
+	{
+		if (held && !hold) switched = true;
+		held = hold;
 	}
 
 	/// <summary>
@@ -75,8 +93,10 @@ public:
 	/// </summary>
 	bool controlLab() override
 	{
-		if (switched)
+		if (switched && !held)
 		{
+			std::lock_guard<std::mutex> gen_lock(LibradorGeneratorMutex());
+			switched = false;
 			if (!active)
 			{
 				signals[signal_idx]->turnOff(channel);
@@ -94,6 +114,7 @@ public:
 
 	void reset()
 	{
+		std::lock_guard<std::mutex> gen_lock(LibradorGeneratorMutex());
 		signals[0]->turnOff(channel);
 	}
 
@@ -102,6 +123,7 @@ private:
 	int channel;
 	bool active;
 	bool switched;
+	bool held = false;
 	int signal_idx = 0;
 	GenericSignal* signals[4];
 	float* pPSUVoltage;
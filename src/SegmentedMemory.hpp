@@ -0,0 +1,250 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include "Measurements.hpp"
+
+/// <summary>
+/// Segmented acquisition: finds every trigger event in the continuous sample stream of one channel
+/// and stores a pre/post-trigger window around each one in a pre-allocated arena.
+/// Samples are stored as 16-bit codes (about 0.6 mV per code over the +/-20 V input range, finer than
+/// the ADC step at any gain), so tens of thousands of segments fit in memory.
+/// Feed it with Process() from the stream pump; capture stops once the arena is full.
+/// </summary>
+class SegmentedMemory
+{
+public:
+	struct Config
+	{
+		int segments = 1000;     // arena size in segments
+		int pre_samples = 256;   // samples kept before the trigger point
+		int post_samples = 768;  // samples kept from the trigger point onwards
+		bool rising = true;      // trigger slope
+		double level = 1.65;     // trigger level (V)
+		double hysteresis = 0.05; // re-arm distance from the level (V)
+		double sample_rate = 375000;
+	};
+
+	struct Segment
+	{
+		uint64_t trigger_index; // stream sample index of the trigger point
+		double time_s;          // trigger time since Arm()
+	};
+
+	static constexpr double volts_per_code = 40.0 / 65535.0;
+
+	~SegmentedMemory()
+	{
+		JoinMeasurement();
+	}
+
+	/// <summary>
+	/// Allocates the arena for the given config and starts looking for triggers in the stream.
+	/// Ignored while a measurement run is in progress.
+	/// </summary>
+	void Arm(const Config& config)
+	{
+		if (IsMeasuring()) return;
+		JoinMeasurement();
+		cfg = config;
+		cfg.segments = std::max(cfg.segments, 1);
+		cfg.pre_samples = std::max(cfg.pre_samples, 0);
+		cfg.post_samples = std::max(cfg.post_samples, 1);
+		seg_len = (size_t)cfg.pre_samples + (size_t)cfg.post_samples;
+		arena.assign(seg_len * (size_t)cfg.segments, 0);
+		info.assign((size_t)cfg.segments, Segment{ 0, 0.0 });
+		measurements.assign((size_t)cfg.segments, SignalMeasurements{});
+		measured_count = 0;
+		count.store(0);
+
+		size_t hist = 1;
+		while (hist < seg_len + 1) hist <<= 1;
+		history.assign(hist, 0);
+		history_mask = hist - 1;
+
+		stream_index = 0;
+		pending = false;
+		trig_armed = false;
+		have_prev = false;
+		armed = true;
+	}
+
+	void Stop() { armed = false; }
+	bool IsArmed() const { return armed; }
+	bool IsFull() const { return count.load() >= (size_t)cfg.segments; }
+	size_t Count() const { return count.load(); }
+	size_t Capacity() const { return info.size(); }
+	size_t SegmentLength() const { return seg_len; }
+	const Config& GetConfig() const { return cfg; }
+	const Segment& Info(size_t i) const { return info[i]; }
+
+	/// <summary>
+	/// Consumes a chunk of the stream, oldest sample first.
+	/// </summary>
+	void Process(const double* samples, size_t n)
+	{
+		if (!armed) return;
+		const double lo = cfg.rising ? cfg.level - cfg.hysteresis : cfg.level + cfg.hysteresis;
+		for (size_t k = 0; k < n; ++k, ++stream_index)
+		{
+			const double v = samples[k];
+			history[stream_index & history_mask] = Encode(v);
+
+			if (pending)
+			{
+				if (stream_index + 1 == pending_trigger + (uint64_t)cfg.post_samples)
+				{
+					Store();
+					pending = false;
+					if (IsFull())
+					{
+						armed = false;
+						return;
+					}
+				}
+			}
+			else
+			{
+				// hysteresis: the signal must first return past lo before the next edge counts
+				if (cfg.rising ? (v < lo) : (v > lo)) trig_armed = true;
+				const bool edge = have_prev && (cfg.rising ? (prev < cfg.level && v >= cfg.level)
+					: (prev > cfg.level && v <= cfg.level));
+				if (edge && trig_armed && stream_index >= (uint64_t)cfg.pre_samples)
+				{
+					pending = true;
+					pending_trigger = stream_index;
+					trig_armed = false;
+				}
+			}
+			prev = v;
+			have_prev = true;
+		}
+	}
+
+	/// <summary>
+	/// Decodes segment i to volts and a time axis relative to its trigger point.
+	/// </summary>
+	void Decode(size_t i, std::vector<double>& time, std::vector<double>& volts) const
+	{
+		time.resize(seg_len);
+		volts.resize(seg_len);
+		const int16_t* src = arena.data() + i * seg_len;
+		const double dt = 1.0 / cfg.sample_rate;
+		for (size_t k = 0; k < seg_len; ++k)
+		{
+			time[k] = ((double)k - cfg.pre_samples) * dt;
+			volts[k] = Decode(src[k]);
+		}
+	}
+
+	// --------------------- Per-segment measurements ---------------------
+
+	/// <summary>
+	/// Measures every captured segment on worker threads (one MeasurementEngine each).
+	/// Segments captured while this runs are picked up by the next call.
+	/// </summary>
+	void StartMeasureAll()
+	{
+		if (IsMeasuring()) return;
+		JoinMeasurement();
+		const size_t n = Count();
+		if (n == 0) return;
+		measure_total = n;
+		measure_next.store(0);
+		measure_done.store(0);
+		measuring.store(true);
+		measure_thread = std::thread([this, n]()
+		{
+			const unsigned workers = std::max(1u, std::min(std::thread::hardware_concurrency(), 16u));
+			std::vector<std::thread> pool;
+			for (unsigned w = 0; w < workers; ++w)
+			{
+				pool.emplace_back([this, n]()
+				{
+					MeasurementEngine engine;
+					std::vector<double> t, v;
+					for (size_t i = measure_next.fetch_add(1); i < n; i = measure_next.fetch_add(1))
+					{
+						Decode(i, t, v);
+						measurements[i] = engine.Measure(t, v);
+						measure_done.fetch_add(1);
+					}
+				});
+			}
+			for (std::thread& th : pool) th.join();
+			measured_count = n;
+			measuring.store(false);
+		});
+	}
+	bool IsMeasuring() const { return measuring.load(); }
+	/// <summary>
+	/// Fraction of the current measurement run completed (1 when idle).
+	/// </summary>
+	float MeasureProgress() const
+	{
+		if (!IsMeasuring() || measure_total == 0) return 1.0f;
+		return (float)measure_done.load() / (float)measure_total;
+	}
+	/// <summary>
+	/// Number of segments with valid results in Measurement(); only read while not measuring.
+	/// </summary>
+	size_t MeasuredCount() const { return IsMeasuring() ? 0 : measured_count; }
+	const SignalMeasurements& Measurement(size_t i) const { return measurements[i]; }
+
+private:
+	Config cfg;
+	size_t seg_len = 0;
+	std::vector<int16_t> arena;
+	std::vector<Segment> info;
+	std::atomic<size_t> count{ 0 };
+	bool armed = false;
+
+	// stream state
+	std::vector<int16_t> history; // last seg_len samples, indexed by stream_index & history_mask
+	size_t history_mask = 0;
+	uint64_t stream_index = 0;
+	bool have_prev = false;
+	double prev = 0.0;
+	bool trig_armed = false;
+	bool pending = false;
+	uint64_t pending_trigger = 0;
+
+	// measurement state
+	std::vector<SignalMeasurements> measurements;
+	size_t measured_count = 0;
+	size_t measure_total = 0;
+	std::atomic<size_t> measure_next{ 0 };
+	std::atomic<size_t> measure_done{ 0 };
+	std::atomic<bool> measuring{ false };
+	std::thread measure_thread;
+
+	static int16_t Encode(double v)
+	{
+		const double c = std::round(v / volts_per_code);
+		return (int16_t)std::clamp(c, -32767.0, 32767.0);
+	}
+	static double Decode(int16_t c)
+	{
+		return c * volts_per_code;
+	}
+
+	// Copies the window around pending_trigger out of the history ring into the next arena slot.
+	void Store()
+	{
+		const size_t slot = count.load();
+		int16_t* dst = arena.data() + slot * seg_len;
+		const uint64_t first = pending_trigger - (uint64_t)cfg.pre_samples;
+		for (size_t k = 0; k < seg_len; ++k)
+			dst[k] = history[(first + k) & history_mask];
+		info[slot] = Segment{ pending_trigger, (double)pending_trigger / cfg.sample_rate };
+		count.store(slot + 1); // publish after the data is written
+	}
+
+	void JoinMeasurement()
+	{
+		if (measure_thread.joinable()) measure_thread.join();
+	}
+};
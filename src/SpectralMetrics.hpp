@@ -0,0 +1,190 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "FFTPlanCache.hpp"
+
+/// <summary>
+/// Distortion and noise figures of a single-tone spectrum. NaN marks a figure that could not be
+/// computed (no spectrum, no harmonic inside the band, etc).
+/// </summary>
+struct SpectralMetrics
+{
+	double fundamental_hz = std::numeric_limits<double>::quiet_NaN();   // sub-bin interpolated
+	double fundamental_vrms = std::numeric_limits<double>::quiet_NaN();
+	double thd_db = std::numeric_limits<double>::quiet_NaN();           // harmonics / fundamental
+	double thd_percent = std::numeric_limits<double>::quiet_NaN();
+	double thdn_db = std::numeric_limits<double>::quiet_NaN();          // everything else / fundamental
+	double sinad_db = std::numeric_limits<double>::quiet_NaN();
+	double snr_db = std::numeric_limits<double>::quiet_NaN();           // excludes harmonics
+	double sfdr_dbc = std::numeric_limits<double>::quiet_NaN();         // fundamental / largest spur
+	double enob_bits = std::numeric_limits<double>::quiet_NaN();
+	double noise_vrms = std::numeric_limits<double>::quiet_NaN();
+	int harmonics = 0;                                                  // harmonics found in band
+
+	static constexpr int Count = 10;
+	static const char* Name(int i)
+	{
+		static const char* names[Count] = { "Fundamental (Hz)", "Fundamental (Vrms)", "THD (dB)", "THD (%)",
+			"THD+N (dB)", "SINAD (dB)", "SNR (dB)", "SFDR (dBc)", "ENOB (bits)", "Noise (Vrms)" };
+		return (i >= 0 && i < Count) ? names[i] : "";
+	}
+	double Value(int i) const
+	{
+		switch (i)
+		{
+		case 0: return fundamental_hz;
+		case 1: return fundamental_vrms;
+		case 2: return thd_db;
+		case 3: return thd_percent;
+		case 4: return thdn_db;
+		case 5: return sinad_db;
+		case 6: return snr_db;
+		case 7: return sfdr_dbc;
+		case 8: return enob_bits;
+		case 9: return noise_vrms;
+		}
+		return std::numeric_limits<double>::quiet_NaN();
+	}
+};
+
+/// <summary>
+/// Computes SpectralMetrics from a one-sided per-bin Vrms spectrum (as OscData publishes it, bin 0
+/// at DC) taken with the given SpectrumWorkspace window. A single pass over the bins accumulates
+/// the total power, finds the fundamental and tracks the largest spur clear of it: a running
+/// maximum lagging the scan by the exclusion width gives the best spur left of wherever the peak
+/// ends up, and a second maximum restarted at each new peak covers the right. Tone powers are then
+/// summed over a window-dependent number of bins either side of the fundamental, each harmonic
+/// (folded back into the band if it aliases) and the spur, so leakage is counted with its tone.
+/// Powers are divided by the window's equivalent noise bandwidth for the absolute Vrms figures;
+/// the ratios do not depend on it. Bins next to DC are ignored.
+/// </summary>
+inline bool ComputeSpectralMetrics(const std::vector<double>& freq, const std::vector<double>& vrms,
+	int window, SpectralMetrics& m, int max_harmonic = 10)
+{
+	m = SpectralMetrics{};
+	const size_t Nb = std::min(freq.size(), vrms.size());
+	const bool hann = (window == SpectrumWorkspace::Hann);
+	// Hann leakage falls off at 18 dB/octave, so 12 bins either side leaves under -65 dBc outside
+	// even half-way between bins. Rectangular leakage falls off at 6 dB/octave and no sum is wide
+	// enough unless the tone sits on a bin.
+	const size_t half = hann ? 12 : 10;
+	const double enbw = hann ? 1.5 : 1.0; // bins
+	const size_t excl = 2 * half;         // spur lobes never overlap the fundamental's
+	// an acquisition without a record (no device, or an empty Welch average) publishes no bins
+	if (Nb < 2) return false;
+	// a full-band spectrum starts at DC: skip it and its leakage. A zoomed band starts above it.
+	const bool full_band = (freq[0] <= 0.0);
+	const size_t first = full_band ? half + 1 : 0;
+	if (Nb < first + 2 * excl + 2) return false;
+	const double df = freq[1] - freq[0];
+	if (!(df > 0.0)) return false;
+
+	double total = 0.0;
+	size_t peak = 0;
+	double peak_p = 0.0;
+	double lag_p = 0.0, left_p = 0.0, right_p = 0.0;
+	size_t lag_k = 0, left_k = 0, right_k = 0;
+	for (size_t k = first; k < Nb; ++k)
+	{
+		if (k >= first + excl + 1)
+		{
+			const size_t j = k - excl - 1;
+			const double pj = vrms[j] * vrms[j];
+			if (pj > lag_p) { lag_p = pj; lag_k = j; }
+		}
+		const double p = vrms[k] * vrms[k];
+		total += p;
+		if (p > peak_p)
+		{
+			peak_p = p;
+			peak = k;
+			left_p = lag_p;
+			left_k = lag_k;
+			right_p = 0.0;
+			right_k = 0;
+		}
+		else if (k > peak + excl && p > right_p)
+		{
+			right_p = p;
+			right_k = k;
+		}
+	}
+	// bin 0 of a full band is DC and never scanned; bin 0 of a zoomed band is a real candidate
+	if ((full_band && peak == 0) || !(peak_p > 0.0)) return false;
+
+	auto lobe = [&](size_t c)
+	{
+		const size_t a = std::max(first, c > half ? c - half : 0);
+		const size_t b = std::min(Nb - 1, c + half);
+		double s = 0.0;
+		for (size_t k = a; k <= b; ++k) s += vrms[k] * vrms[k];
+		return s;
+	};
+
+	// sub-bin position from the larger neighbour: exact for a lone tone under either window
+	// (a peak on the band edge only has the one neighbour)
+	double delta = 0.0;
+	if (peak > 0 || peak + 1 < Nb)
+	{
+		const double a0 = vrms[peak];
+		const double lo = peak > 0 ? vrms[peak - 1] : 0.0;
+		const double hi = peak + 1 < Nb ? vrms[peak + 1] : 0.0;
+		const double side = (hi >= lo) ? 1.0 : -1.0;
+		const double r = std::max(hi, lo) / a0;
+		delta = side * (hann ? (2.0 * r - 1.0) / (r + 1.0) : r / (1.0 + r));
+		delta = std::clamp(delta, -0.5, 0.5);
+	}
+	const double f0 = (peak + delta) * df + freq[0];
+	const double p_fund = lobe(peak);
+
+	// harmonics, folded about Nyquist (full band only, a zoomed band's top is not Nyquist); skipped
+	// where they land on the fundamental, DC, each other or outside the band
+	const double f_nyq = freq[Nb - 1];
+	const double fs = 2.0 * f_nyq;
+	std::vector<size_t> used;
+	used.reserve((size_t)std::max(0, max_harmonic));
+	used.push_back(peak);
+	double p_harm = 0.0;
+	for (int h = 2; h <= max_harmonic; ++h)
+	{
+		double fh = h * f0;
+		if (full_band)
+		{
+			fh = std::fmod(fh, fs);
+			if (fh > f_nyq) fh = fs - fh;
+		}
+		const double pos = (fh - freq[0]) / df;
+		if (pos < 0.0) continue;
+		const size_t c = (size_t)std::lround(pos);
+		if (c < first + half || c >= Nb) continue;
+		bool clash = false;
+		for (size_t u : used)
+			if ((c > u ? c - u : u - c) <= excl) { clash = true; break; }
+		if (clash) continue;
+		used.push_back(c);
+		p_harm += lobe(c);
+		m.harmonics++;
+	}
+
+	const size_t spur = (left_p >= right_p) ? left_k : right_k;
+	const double p_spur = (left_p > 0.0 || right_p > 0.0) ? lobe(spur) : 0.0;
+	const double p_rest = std::max(total - p_fund, 1e-300);
+	const double p_noise = std::max(total - p_fund - p_harm, 1e-300);
+
+	m.fundamental_hz = f0;
+	m.fundamental_vrms = std::sqrt(p_fund / enbw);
+	if (m.harmonics > 0 && p_harm > 0.0)
+	{
+		m.thd_db = 10.0 * std::log10(p_harm / p_fund);
+		m.thd_percent = 100.0 * std::sqrt(p_harm / p_fund);
+	}
+	m.thdn_db = 10.0 * std::log10(p_rest / p_fund);
+	m.sinad_db = -m.thdn_db;
+	m.snr_db = 10.0 * std::log10(p_fund / p_noise);
+	if (p_spur > 0.0) m.sfdr_dbc = 10.0 * std::log10(p_fund / p_spur);
+	m.enob_bits = (m.sinad_db - 1.76) / 6.02;
+	m.noise_vrms = std::sqrt(p_noise / enbw);
+	return true;
+}
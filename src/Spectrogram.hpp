@@ -0,0 +1,236 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include "implot.h"
+#include "FFTPlanCache.hpp"
+
+/// <summary>
+/// Scrolling spectrogram (waterfall) of one channel. The stream pump pushes samples from the render
+/// thread; a worker thread runs the short-time FFT at the configured hop and writes each spectrum,
+/// in dBV, as one row of a fixed-size circular image. Input is queued without limit, so rows are
+/// never dropped: if the worker falls behind it catches up on the backlog. Plot() draws the image
+/// straight from the ring as two heatmap slices, so scrolling never copies or reallocates it.
+/// </summary>
+class Spectrogram
+{
+public:
+	struct Config
+	{
+		int fft_length = 1024;
+		int hop = 256;                 // analysed samples between rows
+		int window = SpectrumWorkspace::Hann;
+		int rows = 400;                // history depth
+		double input_rate = 375000;    // rate of the pushed samples
+		int decimation = 1;            // pushed samples averaged into one analysed sample
+
+		bool operator==(const Config& o) const
+		{
+			return fft_length == o.fft_length && hop == o.hop && window == o.window && rows == o.rows
+				&& input_rate == o.input_rate && decimation == o.decimation;
+		}
+		bool operator!=(const Config& o) const { return !(*this == o); }
+	};
+
+	static constexpr int MaxColumns = 512; // wider spectra are max-pooled down to this
+	static constexpr float FloorDb = -200.0f;
+
+	~Spectrogram()
+	{
+		Stop();
+	}
+
+	void Start(const Config& config)
+	{
+		Stop();
+		cfg = config;
+		cfg.fft_length = std::max(cfg.fft_length, 16);
+		cfg.hop = std::max(cfg.hop, 1);
+		cfg.rows = std::max(cfg.rows, 2);
+		cfg.decimation = std::max(cfg.decimation, 1);
+		const int bins = cfg.fft_length / 2 + 1;
+		pool = (bins + MaxColumns - 1) / MaxColumns;
+		columns = (bins + pool - 1) / pool;
+		{
+			std::lock_guard<std::mutex> lock(image_mutex);
+			image.assign((size_t)cfg.rows * columns, FloorDb);
+			newest = 0;
+			next_row = cfg.rows - 1;
+		}
+		rows_written = 0;
+		{
+			std::lock_guard<std::mutex> lock(input_mutex);
+			input.clear();
+			stop = false;
+		}
+		running = true;
+		worker = std::thread([this]() { WorkerLoop(); });
+	}
+
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(input_mutex);
+			stop = true;
+		}
+		input_cv.notify_all();
+		if (worker.joinable()) worker.join();
+		running = false;
+	}
+
+	bool IsRunning() const { return running; }
+	const Config& GetConfig() const { return cfg; }
+	uint64_t RowsWritten() const { return rows_written.load(); }
+	/// <summary>
+	/// Samples queued for the worker; stays small when it keeps up with the input.
+	/// </summary>
+	size_t Backlog()
+	{
+		std::lock_guard<std::mutex> lock(input_mutex);
+		return input.size();
+	}
+	double SampleRate() const { return cfg.input_rate / cfg.decimation; }
+	double RowSeconds() const { return cfg.hop / SampleRate(); }
+	double MaxFrequency() const { return (double)columns * pool * SampleRate() / cfg.fft_length; }
+
+	/// <summary>
+	/// Queues samples, oldest first. Called from the render thread.
+	/// </summary>
+	void Push(const double* x, size_t n)
+	{
+		if (!running || n == 0) return;
+		{
+			std::lock_guard<std::mutex> lock(input_mutex);
+			input.insert(input.end(), x, x + n);
+		}
+		input_cv.notify_one();
+	}
+
+	/// <summary>
+	/// Draws the history with the newest row at time 0 and older rows below it (negative seconds).
+	/// Must be called between ImPlot::BeginPlot and EndPlot.
+	/// </summary>
+	void Plot(const char* label_id, double db_min, double db_max, ImPlotColormap colormap = ImPlotColormap_Viridis)
+	{
+		if (!running) return;
+		std::lock_guard<std::mutex> lock(image_mutex);
+		const int rows = cfg.rows;
+		const double dt = RowSeconds();
+		const double f_max = MaxFrequency();
+		// memory rows [newest, rows) run newest to oldest, then [0, newest) continues further back
+		const int rows_a = rows - newest;
+		ImPlot::PushColormap(colormap);
+		ImPlot::PlotHeatmap(label_id, image.data() + (size_t)newest * columns, rows_a, columns, db_min, db_max,
+			nullptr, ImPlotPoint(0.0, -rows_a * dt), ImPlotPoint(f_max, 0.0));
+		if (newest > 0)
+			ImPlot::PlotHeatmap(label_id, image.data(), newest, columns, db_min, db_max,
+				nullptr, ImPlotPoint(0.0, -rows * dt), ImPlotPoint(f_max, -rows_a * dt));
+		ImPlot::PopColormap();
+	}
+
+private:
+	Config cfg;
+	int pool = 1;
+	int columns = 1;
+	bool running = false;
+	std::thread worker;
+
+	std::mutex input_mutex; // guards input and stop
+	std::condition_variable input_cv;
+	std::vector<double> input;
+	bool stop = false;
+
+	std::mutex image_mutex; // guards image, newest and next_row
+	std::vector<float> image; // rows x columns, row-major
+	int newest = 0;
+	int next_row = 0;
+	std::atomic<uint64_t> rows_written{ 0 };
+
+	void WorkerLoop()
+	{
+		SpectrumWorkspace workspace;
+		workspace.Prepare((size_t)cfg.fft_length, cfg.window);
+		const size_t L = (size_t)cfg.fft_length;
+		const size_t bins = L / 2 + 1;
+		const double sumw = workspace.WindowSum();
+		// per-bin Vrms^2 scale, matching the single-FFT spectrum (interior bins doubled)
+		const double scale = (sumw != 0.0) ? 2.0 / (sumw * std::sqrt(2.0)) : 0.0;
+		const double scale2 = scale * scale;
+		std::vector<double> batch, samples;
+		std::vector<float> row((size_t)columns);
+		size_t pos = 0;
+		double dec_sum = 0.0;
+		int dec_count = 0;
+
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(input_mutex);
+				input_cv.wait(lock, [this]() { return stop || !input.empty(); });
+				if (stop) return;
+				batch.swap(input); // input keeps batch's old capacity, so no reallocation in steady state
+			}
+			if (cfg.decimation == 1)
+			{
+				samples.insert(samples.end(), batch.begin(), batch.end());
+			}
+			else
+			{
+				for (double v : batch)
+				{
+					dec_sum += v;
+					if (++dec_count < cfg.decimation) continue;
+					samples.push_back(dec_sum / cfg.decimation);
+					dec_sum = 0.0;
+					dec_count = 0;
+				}
+			}
+			batch.clear();
+
+			const std::vector<double>& w = workspace.GetWindow();
+			while (samples.size() - pos >= L)
+			{
+				const double* x = samples.data() + pos;
+				double mean = 0.0;
+				for (size_t n = 0; n < L; ++n) mean += x[n];
+				mean /= (double)L;
+				double* in = workspace.In();
+				for (size_t n = 0; n < L; ++n) in[n] = (x[n] - mean) * w[n];
+				// Stop() joins this thread from the UI, so a row is skipped rather than wait for the planner
+				if (!workspace.Execute())
+				{
+					pos += (size_t)cfg.hop;
+					continue;
+				}
+				const fftw_complex* out = workspace.Out();
+				// max-pool power into display columns, one log per column
+				for (int c = 0; c < columns; ++c)
+				{
+					const size_t k0 = (size_t)c * pool;
+					const size_t k1 = std::min(bins, k0 + pool);
+					double p = 0.0;
+					for (size_t k = k0; k < k1; ++k)
+						p = std::max(p, out[k][0] * out[k][0] + out[k][1] * out[k][1]);
+					row[c] = (float)std::max(10.0 * std::log10(std::max(p * scale2, 1e-60)), (double)FloorDb);
+				}
+				{
+					std::lock_guard<std::mutex> lock(image_mutex);
+					std::copy(row.begin(), row.end(), image.begin() + (size_t)next_row * columns);
+					newest = next_row;
+					next_row = (next_row == 0) ? cfg.rows - 1 : next_row - 1;
+				}
+				rows_written.fetch_add(1);
+				pos += (size_t)cfg.hop;
+			}
+			// drop consumed samples
+			const size_t consumed = std::min(pos, samples.size());
+			samples.erase(samples.begin(), samples.begin() + (std::ptrdiff_t)consumed);
+			pos -= consumed;
+		}
+	}
+};
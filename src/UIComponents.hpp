@@ -8,6 +8,7 @@
 #include "AcquireState.hpp"
 #include "NetworkAnalyser.hpp"
 #include <chrono>
+#include <functional>
 #include "nfd.h"
 
 /// <summary>
@@ -669,12 +670,14 @@ static bool DrawNetworkAcquireButton(
 
 	return clicked;
 }
-void DrawExportRow2Col(const char* whichLabel,    // "OSC1", "Spectrum", etc.
+/// <summary>
+/// "Export [label] to [clipboard|csv]" row. The callbacks do the export; toFile receives the path
+/// chosen in the save dialog.
+/// </summary>
+void inline DrawExportRow(const char* whichLabel,    // "OSC1", "Spectrum", etc.
 	ExportRowState& state,
-	const std::vector<double>& x,
-	const std::vector<double>& y,
-	const char* xHeader,       // e.g. "Time" or "Frequency"
-	const char* yHeader,       // e.g. "Voltage" or "Magnitude"
+	const std::function<bool()>& toClipboard,
+	const std::function<bool(const char*)>& toFile,
 	const char* fileExtension, // e.g. "csv"
 	float comboWidth = 100.f,
 	float buttonWidth = 100.f)
@@ -700,7 +703,7 @@ void DrawExportRow2Col(const char* whichLabel,    // "OSC1", "Spectrum", etc.
 	{
 		if (state.destComboIdx == 0) {
 			// Clipboard
-			if (Export2ColToClipboard(x, y, xHeader, yHeader)) {
+			if (toClipboard()) {
 				state.lastWasClipboard = true;
 				state.copiedFlag = true;
 			}
@@ -715,7 +718,7 @@ void DrawExportRow2Col(const char* whichLabel,    // "OSC1", "Spectrum", etc.
 			else { printf("Error: %s\n", NFD_GetError()); }
 #endif
 			if (result == NFD_OKAY && path) {
-				if (Export2ColToCsvFile(path, fileExtension, x, y, xHeader, yHeader)) {
+				if (toFile(path)) {
 					state.lastWasClipboard = false;
 					state.copiedFlag = true;
 				}
@@ -735,6 +738,21 @@ void DrawExportRow2Col(const char* whichLabel,    // "OSC1", "Spectrum", etc.
 		destList,
 		IM_ARRAYSIZE(destList));
 }
+void DrawExportRow2Col(const char* whichLabel,    // "OSC1", "Spectrum", etc.
+	ExportRowState& state,
+	const std::vector<double>& x,
+	const std::vector<double>& y,
+	const char* xHeader,       // e.g. "Time" or "Frequency"
+	const char* yHeader,       // e.g. "Voltage" or "Magnitude"
+	const char* fileExtension, // e.g. "csv"
+	float comboWidth = 100.f,
+	float buttonWidth = 100.f)
+{
+	DrawExportRow(whichLabel, state,
+		[&]() { return Export2ColToClipboard(x, y, xHeader, yHeader); },
+		[&](const char* path) { return Export2ColToCsvFile(path, fileExtension, x, y, xHeader, yHeader); },
+		fileExtension, comboWidth, buttonWidth);
+}
 
 
 #endif
\ No newline at end of file
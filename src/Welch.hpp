@@ -0,0 +1,165 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include "FFTPlanCache.hpp"
+
+/// <summary>
+/// Streaming Welch (averaged periodogram) spectrum. Samples are pushed as they arrive, optionally
+/// boxcar-decimated to the analysis rate, cut into overlapping windowed segments, and each
+/// segment's spectrum is folded into a running linear, RMS or max-hold average. The current average
+/// can be read at any time, so the display updates while acquiring and is final the moment
+/// acquisition stops. Memory is one segment plus the accumulator, however long the acquisition.
+/// </summary>
+class WelchSpectrum
+{
+public:
+	enum class Averaging
+	{
+		Linear = 0, // mean of bin magnitudes
+		RMS,        // mean of bin powers (classic Welch)
+		MaxHold     // largest magnitude seen per bin
+	};
+
+	struct Config
+	{
+		int segment_length = 4096;
+		double overlap = 0.5;          // fraction of a segment shared with the next one
+		int window = SpectrumWorkspace::Hann;
+		Averaging averaging = Averaging::RMS;
+		double input_rate = 375000;    // rate of the pushed samples
+		int decimation = 1;            // pushed samples averaged into one analysed sample
+	};
+
+	void Configure(const Config& config)
+	{
+		cfg = config;
+		cfg.segment_length = std::max(cfg.segment_length, 8);
+		cfg.decimation = std::max(cfg.decimation, 1);
+		cfg.overlap = std::clamp(cfg.overlap, 0.0, 0.95);
+		hop = std::max<size_t>(1, (size_t)std::lround(cfg.segment_length * (1.0 - cfg.overlap)));
+		workspace.Prepare((size_t)cfg.segment_length, cfg.window);
+		acc.assign((size_t)cfg.segment_length / 2 + 1, 0.0);
+		pending.clear();
+		pending.reserve(2 * (size_t)cfg.segment_length);
+		pos = 0;
+		dec_sum = 0.0;
+		dec_count = 0;
+		segments = 0;
+	}
+
+	/// <summary>
+	/// Consumes samples, oldest first, processing every segment that becomes complete.
+	/// </summary>
+	void Push(const double* x, size_t n)
+	{
+		if (acc.empty()) return;
+		const size_t L = (size_t)cfg.segment_length;
+		for (size_t i = 0; i < n; ++i)
+		{
+			if (cfg.decimation == 1)
+			{
+				pending.push_back(x[i]);
+			}
+			else
+			{
+				dec_sum += x[i];
+				if (++dec_count < cfg.decimation) continue;
+				pending.push_back(dec_sum / cfg.decimation);
+				dec_sum = 0.0;
+				dec_count = 0;
+			}
+			if (pending.size() - pos >= L)
+			{
+				ProcessSegment(pending.data() + pos);
+				pos += hop;
+				if (pos >= L)
+				{
+					// drop consumed samples; at most one segment is moved
+					pending.erase(pending.begin(), pending.begin() + (std::ptrdiff_t)std::min(pos, pending.size()));
+					pos = 0;
+				}
+			}
+		}
+	}
+
+	size_t Segments() const { return segments; }
+	double SampleRate() const { return cfg.input_rate / cfg.decimation; }
+	const Config& GetConfig() const { return cfg; }
+
+	/// <summary>
+	/// Writes the current average as one-sided per-bin Vrms, scaled like the single-FFT spectrum
+	/// (a bin-centred sine reads its RMS amplitude). Empty if no segment has completed yet.
+	/// </summary>
+	void Result(std::vector<double>& freq, std::vector<double>& vrms) const
+	{
+		if (segments == 0)
+		{
+			freq.clear();
+			vrms.clear();
+			return;
+		}
+		const size_t L = (size_t)cfg.segment_length;
+		const size_t Nb = acc.size();
+		const double df = SampleRate() / (double)L;
+		const double sumw = workspace.WindowSum();
+		const double inv_sumw = (sumw != 0.0) ? 1.0 / sumw : 0.0;
+		const double inv_segments = 1.0 / (double)segments;
+		freq.resize(Nb);
+		vrms.resize(Nb);
+		for (size_t k = 0; k < Nb; ++k)
+		{
+			const bool single = (k == 0) || (L % 2 == 0 && k == Nb - 1);
+			const double scale = (single ? 1.0 : 2.0) * inv_sumw / std::sqrt(2.0);
+			double mag = 0.0;
+			switch (cfg.averaging)
+			{
+			case Averaging::Linear: mag = acc[k] * inv_segments; break;
+			case Averaging::RMS: mag = std::sqrt(acc[k] * inv_segments); break;
+			case Averaging::MaxHold: mag = std::sqrt(acc[k]); break;
+			}
+			freq[k] = k * df;
+			vrms[k] = mag * scale;
+		}
+	}
+
+private:
+	Config cfg;
+	size_t hop = 1;
+	SpectrumWorkspace workspace;
+	std::vector<double> acc;     // per-bin |X| sum, |X|^2 sum or |X|^2 max
+	std::vector<double> pending; // analysed-rate samples not yet fully consumed
+	size_t pos = 0;              // start of the next segment in pending
+	double dec_sum = 0.0;
+	int dec_count = 0;
+	size_t segments = 0;
+
+	void ProcessSegment(const double* x)
+	{
+		const size_t L = (size_t)cfg.segment_length;
+		double mean = 0.0;
+		for (size_t n = 0; n < L; ++n) mean += x[n];
+		mean /= (double)L;
+		const std::vector<double>& w = workspace.GetWindow();
+		double* in = workspace.In();
+		for (size_t n = 0; n < L; ++n)
+			in[n] = (x[n] - mean) * w[n];
+		// UI thread: a segment that would have to wait for the planner is dropped
+		if (!workspace.Execute()) return;
+		const fftw_complex* out = workspace.Out();
+		const size_t Nb = acc.size();
+		switch (cfg.averaging)
+		{
+		case Averaging::Linear:
+			for (size_t k = 0; k < Nb; ++k) acc[k] += std::sqrt(out[k][0] * out[k][0] + out[k][1] * out[k][1]);
+			break;
+		case Averaging::RMS:
+			for (size_t k = 0; k < Nb; ++k) acc[k] += out[k][0] * out[k][0] + out[k][1] * out[k][1];
+			break;
+		case Averaging::MaxHold:
+			for (size_t k = 0; k < Nb; ++k) acc[k] = std::max(acc[k], out[k][0] * out[k][0] + out[k][1] * out[k][1]);
+			break;
+		}
+		segments++;
+	}
+};
@@ -0,0 +1,214 @@
+#pragma once
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <mutex>
+#include "FFTPlanCache.hpp"
+
+/// <summary>
+/// Zoom FFT: the spectrum of a narrow band [centre - span/2, centre + span/2] of a real record.
+/// The record is mixed down by the centre frequency, low-passed and decimated to twice the span in
+/// one step, and only the decimated complex signal is transformed. The resolution is still one over
+/// the record length, but the FFT, its buffers and the published spectrum shrink by the
+/// decimation factor.
+/// Mixing is folded into the filter: the output at m*D is e^{-jw mD} * sum g[n] x[mD + n], where
+/// g[n] = h[n] e^{-jw n}. Each output is then a dot product of the real input with two fixed
+/// coefficient tables, and the only per-sample work is multiply-adds. h is a Blackman-windowed
+/// sinc, TapsPerDecimation taps per decimation step, cut off at half the output rate. That is
+/// flat over the span and at least ~70 dB down wherever an alias could fold into it.
+/// </summary>
+class ZoomSpectrum
+{
+public:
+	struct Config
+	{
+		double centre_hz = 1000.0;
+		double span_hz = 1000.0;
+		int window = SpectrumWorkspace::Hann;
+	};
+
+	static constexpr int TapsPerDecimation = 12;
+
+	ZoomSpectrum() = default;
+	ZoomSpectrum(const ZoomSpectrum&) = delete;
+	ZoomSpectrum& operator=(const ZoomSpectrum&) = delete;
+	~ZoomSpectrum()
+	{
+		Release();
+	}
+
+	/// <summary>
+	/// Writes the band's one-sided-equivalent per-bin Vrms (a tone reads its RMS amplitude, as in
+	/// the full-band spectrum), with ascending frequencies. Empty if the record is shorter than
+	/// the filter.
+	/// </summary>
+	void Compute(const double* x, size_t n, double input_rate, Config cfg,
+		std::vector<double>& freq, std::vector<double>& vrms)
+	{
+		freq.clear();
+		vrms.clear();
+		const double nyq = 0.5 * input_rate;
+		cfg.centre_hz = std::clamp(cfg.centre_hz, 0.0, nyq);
+		cfg.span_hz = std::clamp(cfg.span_hz, 1e-3, nyq);
+		const size_t D = Decimation(input_rate, cfg.span_hz);
+		PrepareFilter(D, cfg.centre_hz / input_rate);
+		const size_t T = taps_re.size();
+		if (n < T + 1) return;
+		const size_t Nd = (n - T) / D + 1;
+		if (!PrepareFFT(Nd, cfg.window)) return;
+
+		double mean = 0.0;
+		for (size_t i = 0; i < n; ++i) mean += x[i];
+		mean /= (double)n;
+		// filtering is linear, so the mean is removed from each output instead of from the input
+		double g_re = 0.0, g_im = 0.0;
+		for (size_t k = 0; k < T; ++k) { g_re += taps_re[k]; g_im += taps_im[k]; }
+
+		const double w_step = 2.0 * M_PI * cfg.centre_hz / input_rate * (double)D;
+		for (size_t m = 0; m < Nd; ++m)
+		{
+			const double* xm = x + m * D;
+			// four partial sums so the loop is not one long dependency chain
+			double r0 = 0.0, r1 = 0.0, r2 = 0.0, r3 = 0.0;
+			double i0 = 0.0, i1 = 0.0, i2 = 0.0, i3 = 0.0;
+			size_t k = 0;
+			for (; k + 4 <= T; k += 4)
+			{
+				r0 += taps_re[k] * xm[k];         i0 += taps_im[k] * xm[k];
+				r1 += taps_re[k + 1] * xm[k + 1]; i1 += taps_im[k + 1] * xm[k + 1];
+				r2 += taps_re[k + 2] * xm[k + 2]; i2 += taps_im[k + 2] * xm[k + 2];
+				r3 += taps_re[k + 3] * xm[k + 3]; i3 += taps_im[k + 3] * xm[k + 3];
+			}
+			for (; k < T; ++k) { r0 += taps_re[k] * xm[k]; i0 += taps_im[k] * xm[k]; }
+			const double re = (r0 + r1) + (r2 + r3) - mean * g_re;
+			const double im = (i0 + i1) + (i2 + i3) - mean * g_im;
+			// e^{-jw mD}, reduced first so the phase keeps its precision over long records
+			const double ph = -std::fmod(w_step * (double)m, 2.0 * M_PI);
+			const double c = std::cos(ph), s = std::sin(ph);
+			in[m][0] = (re * c - im * s) * window[m];
+			in[m][1] = (re * s + im * c) * window[m];
+		}
+		fftw_execute_dft(plan, in, out);
+
+		// a real tone of peak A appears once, with amplitude A/2, so scale like a one-sided bin
+		const double rate_out = input_rate / (double)D;
+		const double df = rate_out / (double)Nd;
+		const double scale = (window_sum != 0.0) ? 2.0 / (window_sum * std::sqrt(2.0)) : 0.0;
+		const double f_lo = std::max(0.0, cfg.centre_hz - 0.5 * cfg.span_hz);
+		const double f_hi = std::min(nyq, cfg.centre_hz + 0.5 * cfg.span_hz);
+		const long half = (long)(Nd / 2);
+		freq.reserve(Nd);
+		vrms.reserve(Nd);
+		for (long j = -half; j < (long)Nd - half; ++j)
+		{
+			const double f = cfg.centre_hz + j * df;
+			if (f < f_lo || f > f_hi) continue;
+			const size_t b = (size_t)(j < 0 ? j + (long)Nd : j);
+			freq.push_back(f);
+			vrms.push_back(std::sqrt(out[b][0] * out[b][0] + out[b][1] * out[b][1]) * scale);
+		}
+	}
+
+	/// <summary>
+	/// Decimation factor the given rate and span will use.
+	/// </summary>
+	static size_t Decimation(double input_rate, double span_hz)
+	{
+		return std::max<size_t>(1, (size_t)std::floor(input_rate / (2.0 * std::max(span_hz, 1e-3))));
+	}
+
+private:
+	std::vector<double> taps_re, taps_im;
+	size_t filter_d = 0;
+	double filter_f = -1.0;
+
+	size_t length = 0;
+	fftw_complex* in = nullptr;
+	fftw_complex* out = nullptr;
+	fftw_plan plan = nullptr;
+	std::vector<double> window;
+	int window_kind = -1;
+	double window_sum = 0.0;
+
+	// f: centre frequency as a fraction of the input rate
+	void PrepareFilter(size_t D, double f)
+	{
+		if (D == filter_d && f == filter_f) return;
+		filter_d = D;
+		filter_f = f;
+		const size_t T = (D == 1) ? 1 : TapsPerDecimation * D + 1;
+		taps_re.resize(T);
+		taps_im.resize(T);
+		if (T == 1)
+		{
+			taps_re[0] = 1.0;
+			taps_im[0] = 0.0;
+			return;
+		}
+		const double fc = 0.5 / (double)D; // cut-off, fraction of the input rate
+		const double mid = 0.5 * (double)(T - 1);
+		std::vector<double> h(T);
+		double sum = 0.0;
+		for (size_t k = 0; k < T; ++k)
+		{
+			const double t = (double)k - mid;
+			const double sinc = (t == 0.0) ? 2.0 * fc : std::sin(2.0 * M_PI * fc * t) / (M_PI * t);
+			const double a = 2.0 * M_PI * (double)k / (double)(T - 1);
+			h[k] = sinc * (0.42 - 0.5 * std::cos(a) + 0.08 * std::cos(2.0 * a));
+			sum += h[k];
+		}
+		for (size_t k = 0; k < T; ++k)
+		{
+			const double ph = -2.0 * M_PI * f * (double)k;
+			taps_re[k] = h[k] / sum * std::cos(ph);
+			taps_im[k] = h[k] / sum * std::sin(ph);
+		}
+	}
+
+	// Runs on the spectrum worker, so it may wait for a background plan measurement. False if no
+	// plan could be made (after FFTPlanCache::Shutdown).
+	bool PrepareFFT(size_t n, int window_type)
+	{
+		if (n != length || !plan)
+		{
+			Release();
+			std::unique_lock<std::mutex> lock = FFTPlanCache::Instance().LockPlanner(true);
+			if (!lock.owns_lock()) return false;
+			length = n;
+			in = fftw_alloc_complex(n);
+			out = fftw_alloc_complex(n);
+			plan = fftw_plan_dft_1d((int)n, in, out, FFTW_FORWARD, FFTW_ESTIMATE);
+			window_kind = -1;
+		}
+		if (window_type != window_kind)
+		{
+			window.assign(n, 1.0);
+			if (window_type == SpectrumWorkspace::Hann && n > 1)
+			{
+				const double inv = 1.0 / double(n - 1);
+				for (size_t k = 0; k < n; ++k)
+					window[k] = 0.5 * (1.0 - std::cos(2.0 * M_PI * k * inv));
+			}
+			window_sum = 0.0;
+			for (double a : window) window_sum += a;
+			window_kind = window_type;
+		}
+		return true;
+	}
+
+	void Release()
+	{
+		if (plan)
+		{
+			// at exit the planner may be left to a measurement; the plan is then simply not freed
+			std::unique_lock<std::mutex> lock = FFTPlanCache::Instance().LockPlanner(true);
+			if (lock.owns_lock()) fftw_destroy_plan(plan);
+		}
+		if (in) fftw_free(in);
+		if (out) fftw_free(out);
+		plan = nullptr;
+		in = nullptr;
+		out = nullptr;
+		length = 0;
+	}
+};
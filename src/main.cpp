@@ -1,4 +1,5 @@
 #include "App.hpp"
+#include "Headless.hpp"
 #include <stdio.h>
 
 // handle windows release gui version of the application (no console, so entry point has to be WinMain)
@@ -6,12 +7,31 @@
 #include <Windows.h>
 int main(int argc, char** argv);
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nShowCmd) {
-	main(0,0);
+	return main(__argc, __argv);
 }
 #endif
 
-int main(int, char**)
+int main(int argc, char** argv)
 {
+	if (Headless::Requested(argc, argv))
+	{
+#if !defined(__APPLE__) && defined(NDEBUG)
+		// the release build has no console of its own: write to the one it was started from,
+		// unless the output has been redirected
+		if (GetStdHandle(STD_OUTPUT_HANDLE) == NULL && AttachConsole(ATTACH_PARENT_PROCESS))
+		{
+			freopen("CONOUT$", "w", stdout);
+			freopen("CONOUT$", "w", stderr);
+		}
+#endif
+		Headless headless;
+		if (!headless.Configure(argc, argv))
+		{
+			return headless.ShowedUsage() ? 0 : 2;
+		}
+		return headless.Run();
+	}
+
 	App app;
 	app.Run();
 
@@ -1,4 +1,5 @@
 #include "util.h"
+#include "LibradorRead.hpp"
 #include <iostream>
 #include <sstream>
 #include <iomanip>
@@ -290,64 +291,6 @@ void ToggleTriggerTypeComboType(int* ComboCurrentItem)
 		*ComboCurrentItem = 2;
 	}
 }
-std::vector<double> EvalUserExpression(std::string user_text, std::vector<double> osc1, std::vector<double> osc2, std::vector<double> time, ParseStatus& parse_status)
-{
-	parse_status.success = false;
-
-	// --------------------------------------------------------------------
-	// If either osc is empty, replace it with a zero vector sized to "time"
-	// --------------------------------------------------------------------
-	std::size_t T = time.size();
-
-	if (T == 0) {
-		// If there is literally no time vector, nothing can be evaluated.
-		parse_status.success = false;
-		return {};
-	}
-
-	if (osc1.empty())
-		osc1.assign(T, 0.0);
-
-	if (osc2.empty())
-		osc2.assign(T, 0.0);
-
-	// Output vector size always matches time
-	std::vector<double> result(T, 0.0);
-
-	// --------------------------------------------------------------------
-	// Build symbol table and expression
-	// --------------------------------------------------------------------
-	exprtk::symbol_table<double> sym;
-	sym.add_vector("osc1", osc1);
-	sym.add_vector("osc2", osc2);
-	sym.add_vector("t", time);
-	sym.add_vector("result", result);
-	sym.add_constants();
-
-	std::string src = "result := (" + user_text + ");";
-
-	exprtk::expression<double> expr;
-	expr.register_symbol_table(sym);
-	exprtk::parser<double> parser;
-
-	// --------------------------------------------------------------------
-	// Compile
-	// --------------------------------------------------------------------
-	if (!parser.compile(src, expr))
-	{
-		parse_status.success = false;
-		return result;
-	}
-
-	// --------------------------------------------------------------------
-	// Evaluate
-	// --------------------------------------------------------------------
-	expr.value(); // fills "result"
-
-	parse_status.success = true;
-	return result;
-}
-
 // Drop-in helper: shows a 0..1 value as "0%..100%" and writes back scaled.
 // fmt e.g. "%.0f%%" or "%.1f%%"
 bool SliderFloatPercent(const char* label, float* v01,
@@ -392,6 +335,7 @@ bool CheckIfInSafetyMode()
 	double delay = 0;
 	int filter_mode = 0;
 	double safety_mode_data_value = -10.174999999999999;
+	std::lock_guard<std::mutex> read_lock(LibradorReadMutex());
 	std::vector<double>* data = librador_get_analog_data(channel, time_window, sample_rate_hz, delay, filter_mode);
 	if (data != nullptr)
 	{
@@ -417,6 +361,7 @@ bool CheckIfInUninitialisedMode()
 	double delay = 0;
 	int filter_mode = 0;
 
+	std::lock_guard<std::mutex> read_lock(LibradorReadMutex());
 	std::vector<double>* data =
 		librador_get_analog_data(channel, time_window, sample_rate_hz, delay, filter_mode);
 
@@ -471,17 +416,14 @@ bool Export2ColToClipboard(const std::vector<double>& x,
 	return true;
 }
 
-bool Export2ColToCsvFile(const char* basePath,
+// Writes `contents` to basePath, appending the extension if it is missing.
+static bool WriteExportFile(const char* basePath,
 	const char* fileExtension,
-	const std::vector<double>& x,
-	const std::vector<double>& y,
-	const char* xHeader,
-	const char* yHeader)
+	const std::string& contents)
 {
 	if (!basePath || !*basePath)
 		return false; // still need a valid path
 
-	// Allow empty x/y: header-only CSV is fine.
 	std::string path(basePath);
 
 	std::string ext = ".";
@@ -497,11 +439,48 @@ bool Export2ColToCsvFile(const char* basePath,
 	if (!file.is_open())
 		return false;
 
-	std::string fileStr = BuildDelimited2Col(x, y, xHeader, yHeader, ',');
-	file << fileStr;
+	file << contents;
+	return true;
+}
+
+bool Export2ColToCsvFile(const char* basePath,
+	const char* fileExtension,
+	const std::vector<double>& x,
+	const std::vector<double>& y,
+	const char* xHeader,
+	const char* yHeader)
+{
+	// Allow empty x/y: header-only CSV is fine.
+	return WriteExportFile(basePath, fileExtension, BuildDelimited2Col(x, y, xHeader, yHeader, ','));
+}
+
+std::string BuildDelimitedTable(const std::vector<std::vector<std::string>>& rows, char sep)
+{
+	std::string s;
+	for (const auto& row : rows) {
+		for (size_t i = 0; i < row.size(); ++i) {
+			if (i > 0) s += sep;
+			s += row[i];
+		}
+		s += '\n';
+	}
+	return s;
+}
+
+bool ExportTableToClipboard(const std::vector<std::vector<std::string>>& rows)
+{
+	std::string clipboardStr = BuildDelimitedTable(rows, '\t');
+	ImGui::SetClipboardText(clipboardStr.c_str());
 	return true;
 }
 
+bool ExportTableToCsvFile(const char* basePath,
+	const char* fileExtension,
+	const std::vector<std::vector<std::string>>& rows)
+{
+	return WriteExportFile(basePath, fileExtension, BuildDelimitedTable(rows, ','));
+}
+
 
 
 
@@ -28,6 +28,9 @@ namespace constants
 constexpr uint16_t DESIRED_FW_VERSION = 7;
 constexpr uint8_t DESIRED_FW_VARIANT = 2;
 
+// Number of math channels
+constexpr int MATH_CHANNELS = 4;
+
 // Theme Colours
 constexpr ImU32 PRIM_LIGHT = IM_COL32(255, 255, 255, 255); // primary light
 constexpr float SG1_ACCENT[3] = { 42. / 255, 39. / 255, 212. / 255 };
@@ -39,6 +42,9 @@ constexpr float OSC1_ACCENT[3] = { 230. / 255, 207. / 255, 2. / 255 };
 constexpr float OSC2_ACCENT[3] = { 255. / 255, 123. / 255, 250. / 255 };
 constexpr float GEN_ACCENT[3] = { 150. / 255, 150. / 255, 150. / 255 };
 constexpr float MATH_ACCENT[3] = { 0, 0.9, 0.78 };
+constexpr float MATH2_ACCENT[3] = { 90. / 255, 170. / 255, 255. / 255 };
+constexpr float MATH3_ACCENT[3] = { 160. / 255, 235. / 255, 80. / 255 };
+constexpr float MATH4_ACCENT[3] = { 190. / 255, 140. / 255, 255. / 255 };
 constexpr float PLOT_ACCENT[3] = {0., 0., 0.};
 constexpr float SPECTRUM_ANALYSER_ACCENT[3] = { 210. / 255, 68. / 255, 41. / 255 };
 constexpr float NETWORK_ANALYSER_ACCENT[3] = { 65. / 255, 194. / 255, 55. / 255 };
@@ -180,7 +186,6 @@ std::string NumToString(double num,int precision);
 int MetricFormatter(double value, char* buff, int size, void* data);
 void ToggleTriggerTypeComboChannel(int* ComboCurrentItem);
 void ToggleTriggerTypeComboType(int* ComboCurrentItem);
-std::vector<double> EvalUserExpression(std::string user_text, std::vector<double> osc1, std::vector<double> osc2, std::vector<double> time, ParseStatus& parse_status);
 bool SliderFloatPercent(const char* label, float* v01,
 	const char* fmt = "%.0f%%",
 	ImGuiSliderFlags flags = 0);
@@ -217,6 +222,15 @@ bool Export2ColToCsvFile(const char* basePath,
 	const char* xHeader,
 	const char* yHeader);
 
+// rows[0] is the header; cells are written as given
+std::string BuildDelimitedTable(const std::vector<std::vector<std::string>>& rows, char sep);
+
+bool ExportTableToClipboard(const std::vector<std::vector<std::string>>& rows);
+
+bool ExportTableToCsvFile(const char* basePath,
+	const char* fileExtension,
+	const std::vector<std::vector<std::string>>& rows);
+
 struct PlotTrace {
 	std::vector<double> x = {};
 	std::vector<double> y = {};
@@ -230,5 +244,7 @@ struct NetworkPlots {
 	std::vector<double> freq = {};
 	std::vector<double> mag = {};
 	std::vector<double> phase = {};
+	uint64_t generation = 0; // NetworkAnalyser::generation() the copy was taken at
+	int units = -1;          // NA units combo item the magnitude is in
 };
 #endif
\ No newline at end of file